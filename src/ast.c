@@ -0,0 +1,695 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Compact struct-of-arrays copy of the parse tree
+ ***********************************************************************/
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "ast.h"
+#include "comment.h"
+#include "hash.h"
+#include "lex.h"
+#include "misc.h"
+#include "node.h"
+
+/***********************************************************************
+ * appendstring : append a string to the string table
+ *
+ * Enter:   ast
+ *          s = string, which need not be 0-terminated
+ *          len = length of string
+ *          *pmax = allocated size of string table
+ *
+ * Return:  offset of string in string table
+ */
+static uint32_t
+appendstring(struct ast *ast, const char *s, size_t len, size_t *pmax)
+{
+    size_t offset = ast->stringslen;
+    /* String offsets are 32 bit to keep the ast compact. */
+    if (len >= AST_NONE - offset)
+        errorexit("too much text for ast string table");
+    if (offset + len + 1 > *pmax) {
+        while (offset + len + 1 > *pmax)
+            *pmax = *pmax ? 2 * *pmax : 4096;
+        ast->strings = memrealloc(ast->strings, *pmax);
+    }
+    memcpy(ast->strings + offset, s, len);
+    ast->strings[offset + len] = 0;
+    ast->stringslen += (uint32_t)len + 1;
+    return (uint32_t)offset;
+}
+
+/***********************************************************************
+ * addstring : add a string to the string table, sharing any identical
+ *             string already added
+ *
+ * Enter:   ast
+ *          strings = table of strings added so far
+ *          s = 0-terminated string, which must stay valid while the
+ *              table is in use
+ *          *pmax = allocated size of string table
+ *
+ * Return:  offset of string in string table
+ */
+static uint32_t
+addstring(struct ast *ast, struct hashtable *strings, const char *s,
+          size_t *pmax)
+{
+    size_t len = strlen(s);
+    void **pvalue = hashput(strings, s, len);
+    uint32_t offset;
+    if (*pvalue)
+        return (uint32_t)(size_t)*pvalue - 1;
+    offset = appendstring(ast, s, len, pmax);
+    *pvalue = (void *)(size_t)(offset + 1);
+    return offset;
+}
+
+/***********************************************************************
+ * srcoffsetornone : convert source pointer to source offset
+ *
+ * Enter:   p = pointer into input, or 0
+ *
+ * Return:  source offset, AST_NOOFFSET if p is 0
+ */
+static uint64_t
+srcoffsetornone(const char *p)
+{
+    return p ? (uint64_t)srcoffset(p) : AST_NOOFFSET;
+}
+
+/***********************************************************************
+ * addelement : add an element to the ast
+ *
+ * Enter:   ast
+ *          node = element in the parse tree
+ *          parent = index of parent element, AST_NONE for the root
+ *          lastchild = array of index of last child added so far for
+ *                      each element
+ *          strings, *pmax = as addstring
+ *
+ * Return:  index of new element
+ */
+static uint32_t
+addelement(struct ast *ast, struct node *node, uint32_t parent,
+           uint32_t *lastchild, struct hashtable *strings, size_t *pmax)
+{
+    uint32_t i = ast->count++;
+    struct node *child;
+    ast->kind[i] = ((struct element *)node)->name;
+    ast->parent[i] = parent;
+    ast->firstchild[i] = ast->nextsibling[i] = lastchild[i] = AST_NONE;
+    ast->id[i] = node->fqid ? addstring(ast, strings, node->fqid, pmax)
+            : AST_NONE;
+    /* Comment text is seldom repeated, so it is not shared. */
+    ast->comment[i] = AST_NONE;
+    if (node->comments) {
+        char *text = memcommenttext(node);
+        if (text) {
+            ast->comment[i] = appendstring(ast, text, strlen(text), pmax);
+            memfree(text);
+        }
+    }
+    ast->wsstart[i] = srcoffsetornone(node->wsstart);
+    ast->end[i] = srcoffsetornone(node->wsstart ? node->end : 0);
+    if (parent != AST_NONE) {
+        if (lastchild[parent] == AST_NONE)
+            ast->firstchild[parent] = i;
+        else
+            ast->nextsibling[lastchild[parent]] = i;
+        lastchild[parent] = i;
+    }
+    /* Add the attributes to the packed attribute table. */
+    ast->firstattr[i] = ast->attrcount;
+    for (child = node->children; child; child = child->next) {
+        if (child->type == NODE_ATTR) {
+            struct attr *attr = (void *)child;
+            struct astattr *astattr = ast->attrs + ast->attrcount++;
+            astattr->name = attr->name;
+            astattr->value = addstring(ast, strings, attr->value, pmax);
+            astattr->refstart = srcoffsetornone(child->start);
+            astattr->refend = srcoffsetornone(child->start ? child->end : 0);
+        }
+    }
+    return i;
+}
+
+/***********************************************************************
+ * buildast : build compact copy of parse tree
+ *
+ * Enter:   root = root element of parse tree
+ *
+ * Return:  new ast struct
+ *
+ * The walk is iterative, so a deep tree cannot overflow the stack.
+ */
+struct ast *
+buildast(struct node *root)
+{
+    struct ast *ast = memalloc(sizeof(struct ast));
+    struct hashtable strings = { 0, 0, 0 };
+    uint32_t count = 0, attrcount = 0, cur;
+    size_t max = 0;
+    uint32_t *lastchild;
+    struct node *node;
+    /* Count the elements and attributes so each array is allocated
+     * just once. nodewalk visits attributes as well as elements. */
+    for (node = root; node; node = nodewalk(node)) {
+        if (node->type == NODE_ELEMENT)
+            count++;
+        else if (node->type == NODE_ATTR)
+            attrcount++;
+    }
+    ast->kind = memalloc(count * sizeof(uint32_t));
+    ast->parent = memalloc(count * sizeof(uint32_t));
+    ast->firstchild = memalloc(count * sizeof(uint32_t));
+    ast->nextsibling = memalloc(count * sizeof(uint32_t));
+    ast->firstattr = memalloc((count + 1) * sizeof(uint32_t));
+    ast->id = memalloc(count * sizeof(uint32_t));
+    ast->comment = memalloc(count * sizeof(uint32_t));
+    ast->wsstart = memalloc(count * sizeof(uint64_t));
+    ast->end = memalloc(count * sizeof(uint64_t));
+    ast->attrs = memalloc((attrcount ? attrcount : 1) * sizeof(struct astattr));
+    lastchild = memalloc(count * sizeof(uint32_t));
+    /* Walk the elements in document order. */
+    node = root;
+    cur = addelement(ast, node, AST_NONE, lastchild, &strings, &max);
+    for (;;) {
+        struct node *next = nextelement(node->children);
+        if (next) {
+            /* Descend to first child element. */
+            cur = addelement(ast, next, cur, lastchild, &strings, &max);
+            node = next;
+            continue;
+        }
+        /* Go to the next sibling element, climbing as necessary. */
+        for (;;) {
+            if (node == root)
+                goto done;
+            next = nextelement(node->next);
+            if (next) {
+                cur = addelement(ast, next, ast->parent[cur], lastchild,
+                        &strings, &max);
+                node = next;
+                break;
+            }
+            node = node->parent;
+            cur = ast->parent[cur];
+        }
+    }
+done:
+    assert(ast->count == count && ast->attrcount == attrcount);
+    ast->firstattr[count] = attrcount;
+    memfree(lastchild);
+    /* Record the names of the atoms used. */
+    for (cur = 0; cur != count; cur++) {
+        if (ast->kind[cur] >= ast->natoms)
+            ast->natoms = ast->kind[cur] + 1;
+    }
+    for (cur = 0; cur != attrcount; cur++) {
+        if (ast->attrs[cur].name >= ast->natoms)
+            ast->natoms = ast->attrs[cur].name + 1;
+    }
+    ast->atomnames = memalloc((ast->natoms ? ast->natoms : 1)
+            * sizeof(uint32_t));
+    for (cur = 0; cur != ast->natoms; cur++)
+        ast->atomnames[cur] = addstring(ast, &strings, atomname(cur), &max);
+    ast->sourcelen = inputlength();
+    hashfree(&strings);
+    if (!ast->strings)
+        ast->strings = memalloc(1);
+    return ast;
+}
+
+/***********************************************************************
+ * freeast : free ast struct
+ *
+ * Enter:   ast struct
+ */
+void
+freeast(struct ast *ast)
+{
+    if (ast->map) {
+#ifdef _MSC_VER
+        memfree(ast->map);
+#else
+        munmap(ast->map, ast->maplen);
+#endif
+        memfree(ast);
+        return;
+    }
+    memfree(ast->atomnames);
+    memfree(ast->kind);
+    memfree(ast->parent);
+    memfree(ast->firstchild);
+    memfree(ast->nextsibling);
+    memfree(ast->firstattr);
+    memfree(ast->id);
+    memfree(ast->comment);
+    memfree(ast->wsstart);
+    memfree(ast->end);
+    memfree(ast->attrs);
+    memfree(ast->strings);
+    memfree(ast);
+}
+
+/***********************************************************************
+ * layout : work out where each section of the binary format goes
+ *
+ * Enter:   header = header with the counts and lengths filled in
+ *          sizes = array to store the size of each section in
+ *
+ * Return:  size of file
+ *          header->sections and sizes filled in
+ */
+static uint64_t
+layout(struct astheader *header, uint64_t *sizes)
+{
+    uint64_t offset = sizeof(struct astheader), end = 0;
+    unsigned int i;
+    sizes[AST_SECTION_ATOMNAMES] = (uint64_t)header->natoms * sizeof(uint32_t);
+    sizes[AST_SECTION_KIND] = (uint64_t)header->count * sizeof(uint32_t);
+    sizes[AST_SECTION_PARENT] = sizes[AST_SECTION_KIND];
+    sizes[AST_SECTION_FIRSTCHILD] = sizes[AST_SECTION_KIND];
+    sizes[AST_SECTION_NEXTSIBLING] = sizes[AST_SECTION_KIND];
+    sizes[AST_SECTION_FIRSTATTR] = ((uint64_t)header->count + 1)
+            * sizeof(uint32_t);
+    sizes[AST_SECTION_ID] = sizes[AST_SECTION_KIND];
+    sizes[AST_SECTION_COMMENT] = sizes[AST_SECTION_KIND];
+    sizes[AST_SECTION_WSSTART] = (uint64_t)header->count * sizeof(uint64_t);
+    sizes[AST_SECTION_END] = sizes[AST_SECTION_WSSTART];
+    sizes[AST_SECTION_ATTRS] = (uint64_t)header->attrcount
+            * sizeof(struct astattr);
+    sizes[AST_SECTION_STRINGS] = header->stringslen;
+    sizes[AST_SECTION_SOURCE] = header->sourcelen;
+    for (i = 0; i != AST_SECTION_COUNT; i++) {
+        header->sections[i] = offset;
+        end = offset + sizes[i];
+        offset = (end + 7) & ~(uint64_t)7;
+    }
+    return end;
+}
+
+/***********************************************************************
+ * writeast : write ast in binary format
+ *
+ * Enter:   ast = ast returned by buildast
+ *          handle = file to write to
+ *
+ * The source text is the input files, as read by readinput.
+ */
+void
+writeast(const struct ast *ast, FILE *handle)
+{
+    static const char zeros[8];
+    struct astheader header;
+    uint64_t sizes[AST_SECTION_COUNT], offset = 0;
+    const void *sections[AST_SECTION_COUNT];
+    unsigned int i;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, AST_MAGIC);
+    header.version = AST_VERSION;
+    header.byteorder = AST_BYTEORDER;
+    header.count = ast->count;
+    header.attrcount = ast->attrcount;
+    header.stringslen = ast->stringslen;
+    header.natoms = ast->natoms;
+    header.sourcelen = ast->sourcelen;
+    layout(&header, sizes);
+    sections[AST_SECTION_ATOMNAMES] = ast->atomnames;
+    sections[AST_SECTION_KIND] = ast->kind;
+    sections[AST_SECTION_PARENT] = ast->parent;
+    sections[AST_SECTION_FIRSTCHILD] = ast->firstchild;
+    sections[AST_SECTION_NEXTSIBLING] = ast->nextsibling;
+    sections[AST_SECTION_FIRSTATTR] = ast->firstattr;
+    sections[AST_SECTION_ID] = ast->id;
+    sections[AST_SECTION_COMMENT] = ast->comment;
+    sections[AST_SECTION_WSSTART] = ast->wsstart;
+    sections[AST_SECTION_END] = ast->end;
+    sections[AST_SECTION_ATTRS] = ast->attrs;
+    sections[AST_SECTION_STRINGS] = ast->strings;
+    sections[AST_SECTION_SOURCE] = 0;
+    if (fwrite(&header, sizeof(header), 1, handle) != 1)
+        errorexit("write error");
+    offset = sizeof(header);
+    for (i = 0; i != AST_SECTION_COUNT; i++) {
+        /* Pad to the start of the section. */
+        if (fwrite(zeros, 1, header.sections[i] - offset, handle)
+                != header.sections[i] - offset)
+        {
+            errorexit("write error");
+        }
+        if (i == AST_SECTION_SOURCE)
+            writeinput(handle);
+        else if (sizes[i] && fwrite(sections[i], 1, sizes[i], handle)
+                    != sizes[i])
+        {
+            errorexit("write error");
+        }
+        offset = header.sections[i] + sizes[i];
+    }
+    if (fflush(handle))
+        errorexit("write error");
+}
+
+/***********************************************************************
+ * isspan : test whether a source span is in range or absent
+ *
+ * Enter:   ast
+ *          start, end = source offsets of span, AST_NOOFFSET if none
+ */
+static int
+isspan(const struct ast *ast, uint64_t start, uint64_t end)
+{
+    if (start == AST_NOOFFSET)
+        return end == AST_NOOFFSET;
+    return start <= end && end <= ast->sourcelen;
+}
+
+/***********************************************************************
+ * checkmapped : check the indexes and offsets in a mapped ast
+ *
+ * Enter:   ast = ast returned by mapast, with its sections set
+ *
+ * Return:  non-zero if they are all in range
+ *
+ * Each string offset must be in the string table, whose last byte is
+ * 0, so each string ends inside it. The elements must be linked in
+ * document order: a parent before its children, each child and next
+ * sibling after the element, and a walk with astnodewalk visiting 0, 1,
+ * 2 and so on. That means a walk of a file that passes cannot loop or
+ * step outside the arrays.
+ */
+static int
+checkmapped(const struct ast *ast)
+{
+    uint32_t i, expected;
+    if (!ast->count || !ast->stringslen
+            || ast->strings[ast->stringslen - 1]
+            || ast->firstattr[0] || ast->firstattr[ast->count] != ast->attrcount
+            || ast->parent[0] != AST_NONE || ast->nextsibling[0] != AST_NONE)
+    {
+        return 0;
+    }
+    for (i = 0; i != ast->natoms; i++) {
+        if (ast->atomnames[i] >= ast->stringslen)
+            return 0;
+    }
+    for (i = 0; i != ast->count; i++) {
+        if (ast->kind[i] >= ast->natoms
+                || (i && ast->parent[i] >= i)
+                || (ast->firstchild[i] != AST_NONE
+                    && (ast->firstchild[i] <= i
+                        || ast->firstchild[i] >= ast->count
+                        || ast->parent[ast->firstchild[i]] != i))
+                || (ast->nextsibling[i] != AST_NONE
+                    && (ast->nextsibling[i] <= i
+                        || ast->nextsibling[i] >= ast->count
+                        || ast->parent[ast->nextsibling[i]]
+                            != ast->parent[i]))
+                || ast->firstattr[i] > ast->firstattr[i + 1]
+                || (ast->id[i] != AST_NONE && ast->id[i] >= ast->stringslen)
+                || (ast->comment[i] != AST_NONE
+                    && ast->comment[i] >= ast->stringslen)
+                || !isspan(ast, ast->wsstart[i], ast->end[i]))
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i != ast->attrcount; i++) {
+        const struct astattr *attr = ast->attrs + i;
+        if (attr->name >= ast->natoms || attr->value >= ast->stringslen
+                || !isspan(ast, attr->refstart, attr->refend))
+        {
+            return 0;
+        }
+    }
+    expected = 0;
+    for (i = 0; i != AST_NONE; i = astnodewalk(ast, i)) {
+        if (i != expected++)
+            return 0;
+    }
+    return expected == ast->count;
+}
+
+/***********************************************************************
+ * mapast : map a file in binary format
+ *
+ * Enter:   filename = name of file written by writeast
+ *
+ * Return:  ast, which points into the mapped file rather than being
+ *          read from it; free it with freeast
+ *
+ * The header and the section bounds are checked, and then every index
+ * and offset in the sections, so a truncated or corrupt file is an
+ * error rather than being read out of bounds.
+ */
+struct ast *
+mapast(const char *filename)
+{
+    struct ast *ast = memalloc(sizeof(struct ast));
+    struct astheader header;
+    uint64_t sizes[AST_SECTION_COUNT], len;
+    const char *base;
+#ifdef _MSC_VER
+    /* No mmap, so read the file into memory instead. */
+    FILE *handle = fopen(filename, "rb");
+    long filelen;
+    if (!handle)
+        errorexit("%s: %s", filename, strerror(errno));
+    if (fseek(handle, 0, SEEK_END) || (filelen = ftell(handle)) < 0
+            || fseek(handle, 0, SEEK_SET))
+    {
+        errorexit("%s: %s", filename, strerror(errno));
+    }
+    ast->maplen = filelen;
+    ast->map = memalloc(ast->maplen ? ast->maplen : 1);
+    if (fread(ast->map, 1, ast->maplen, handle) != ast->maplen)
+        errorexit("%s: I/O error", filename);
+    fclose(handle);
+#else
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st))
+        errorexit("%s: %s", filename, strerror(errno));
+    ast->maplen = st.st_size;
+    if (ast->maplen < sizeof(struct astheader))
+        errorexit("%s: not a widlproc binary file", filename);
+    ast->map = mmap(0, ast->maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ast->map == MAP_FAILED)
+        errorexit("%s: %s", filename, strerror(errno));
+    close(fd);
+#endif
+    base = ast->map;
+    if (ast->maplen < sizeof(struct astheader))
+        errorexit("%s: not a widlproc binary file", filename);
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, AST_MAGIC, sizeof(header.magic)))
+        errorexit("%s: not a widlproc binary file", filename);
+    if (header.byteorder != AST_BYTEORDER)
+        errorexit("%s: binary file is in the wrong byte order", filename);
+    if (header.version != AST_VERSION) {
+        errorexit("%s: binary file version %u not supported",
+                filename, header.version);
+    }
+    /* Check that the sections are where writeast puts them. The source
+     * length is checked first so that working out the layout cannot
+     * overflow; the other sizes come from 32 bit counts. */
+    if (header.sourcelen > ast->maplen)
+        errorexit("%s: binary file is corrupt", filename);
+    {
+        struct astheader expected = header;
+        len = layout(&expected, sizes);
+        if (len > ast->maplen || memcmp(&expected, &header, sizeof(header)))
+            errorexit("%s: binary file is corrupt", filename);
+    }
+    ast->count = header.count;
+    ast->attrcount = header.attrcount;
+    ast->stringslen = header.stringslen;
+    ast->natoms = header.natoms;
+    ast->sourcelen = header.sourcelen;
+    ast->atomnames = (void *)(base + header.sections[AST_SECTION_ATOMNAMES]);
+    ast->kind = (void *)(base + header.sections[AST_SECTION_KIND]);
+    ast->parent = (void *)(base + header.sections[AST_SECTION_PARENT]);
+    ast->firstchild = (void *)(base + header.sections[AST_SECTION_FIRSTCHILD]);
+    ast->nextsibling = (void *)(base
+            + header.sections[AST_SECTION_NEXTSIBLING]);
+    ast->firstattr = (void *)(base + header.sections[AST_SECTION_FIRSTATTR]);
+    ast->id = (void *)(base + header.sections[AST_SECTION_ID]);
+    ast->comment = (void *)(base + header.sections[AST_SECTION_COMMENT]);
+    ast->wsstart = (void *)(base + header.sections[AST_SECTION_WSSTART]);
+    ast->end = (void *)(base + header.sections[AST_SECTION_END]);
+    ast->attrs = (void *)(base + header.sections[AST_SECTION_ATTRS]);
+    ast->strings = (void *)(base + header.sections[AST_SECTION_STRINGS]);
+    ast->source = base + header.sections[AST_SECTION_SOURCE];
+    if (!checkmapped(ast))
+        errorexit("%s: binary file is corrupt", filename);
+    return ast;
+}
+
+/***********************************************************************
+ * astnodewalk : single step of depth last traversal of ast
+ *
+ * Enter:   ast
+ *          node = index of element
+ *
+ * Return:  index of next element in walk, AST_NONE if finished
+ *
+ * This is the equivalent of nodewalk, except that attributes are not
+ * part of the walk.
+ */
+uint32_t
+astnodewalk(const struct ast *ast, uint32_t node)
+{
+    if (ast->firstchild[node] != AST_NONE)
+        return ast->firstchild[node];
+    while (ast->nextsibling[node] == AST_NONE) {
+        node = ast->parent[node];
+        if (node == AST_NONE)
+            return AST_NONE;
+    }
+    return ast->nextsibling[node];
+}
+
+/***********************************************************************
+ * astgetattr : get value of attribute
+ *
+ * Enter:   ast
+ *          node = index of element to find attribute in
+ *          name = atom of name of attribute
+ *
+ * Return:  0 if not found, else 0-terminated string value
+ *
+ * This is the equivalent of getattr.
+ */
+const char *
+astgetattr(const struct ast *ast, uint32_t node, int name)
+{
+    uint32_t i;
+    for (i = ast->firstattr[node]; i != ast->firstattr[node + 1]; i++) {
+        if (ast->attrs[i].name == (uint32_t)name)
+            return ast->strings + ast->attrs[i].value;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * astatomname : get the name for an atom
+ *
+ * Enter:   ast
+ *          atom = atom used in the ast
+ *
+ * Return:  0-terminated name
+ *
+ * This is the equivalent of atomname, and also works in a process other
+ * than the one that wrote the ast.
+ */
+const char *
+astatomname(const struct ast *ast, uint32_t atom)
+{
+    assert(atom < ast->natoms);
+    return ast->strings + ast->atomnames[atom];
+}
+
+/***********************************************************************
+ * checkast : check that an ast matches a parse tree
+ *
+ * Enter:   ast = ast returned by mapast
+ *          root = root element of parse tree
+ *          filename = name of the mapped file, for the error message
+ *
+ * The ast is walked with astnodewalk alongside the tree's elements with
+ * nodewalk, and each element's name, attributes, id, comment text and
+ * source text are compared, so it is an error if the file was written
+ * from different input or with different options.
+ */
+void
+checkast(const struct ast *ast, struct node *root, const char *filename)
+{
+    struct node *node = root;
+    uint32_t i = 0, k = 0;
+    if (ast->sourcelen != inputlength())
+        goto mismatch;
+    for (;;) {
+        struct element *element = (void *)node;
+        const struct astattr *astattr = ast->attrs + ast->firstattr[i];
+        struct node *child;
+        char *text;
+        int same;
+        if (strcmp(astatomname(ast, ast->kind[i]), atomname(element->name)))
+            goto mismatch;
+        for (child = node->children; child; child = child->next) {
+            struct attr *attr = (void *)child;
+            const char *value;
+            if (child->type != NODE_ATTR)
+                continue;
+            value = astgetattr(ast, i, attr->name);
+            if (astattr == ast->attrs + ast->firstattr[i + 1]
+                    || strcmp(astatomname(ast, astattr->name),
+                        atomname(attr->name))
+                    || !value || strcmp(value, attr->value)
+                    || astattr->refstart != srcoffsetornone(child->start)
+                    || astattr->refend
+                        != srcoffsetornone(child->start ? child->end : 0))
+            {
+                goto mismatch;
+            }
+            astattr++;
+        }
+        if (astattr != ast->attrs + ast->firstattr[i + 1])
+            goto mismatch;
+        if (node->fqid ? ast->id[i] == AST_NONE
+                    || strcmp(ast->strings + ast->id[i], node->fqid)
+                : ast->id[i] != AST_NONE)
+        {
+            goto mismatch;
+        }
+        text = memcommenttext(node);
+        same = text ? ast->comment[i] != AST_NONE
+                    && !strcmp(ast->strings + ast->comment[i], text)
+                : ast->comment[i] == AST_NONE;
+        if (text)
+            memfree(text);
+        if (!same)
+            goto mismatch;
+        if (node->wsstart ? ast->wsstart[i] != srcoffset(node->wsstart)
+                    || ast->end[i] != srcoffset(node->end)
+                    || memcmp(ast->source + ast->wsstart[i], node->wsstart,
+                        node->end - node->wsstart)
+                : ast->wsstart[i] != AST_NOOFFSET)
+        {
+            goto mismatch;
+        }
+        /* Step both walks on to the next element. */
+        do
+            node = nodewalk(node);
+        while (node && node->type != NODE_ELEMENT);
+        i = astnodewalk(ast, i);
+        k++;
+        if (!node || i == AST_NONE)
+            break;
+    }
+    if (!node && i == AST_NONE)
+        return;
+mismatch:
+    errorexit("%s: binary file does not match the input at element %u",
+            filename, k);
+}
@@ -0,0 +1,123 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***********************************************************************/
+#ifndef ast_h
+#define ast_h
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* AST_NONE : index used for no node, no attribute or no string */
+#define AST_NONE 0xffffffffU
+/* AST_NOOFFSET : source offset used for no source text. Source offsets
+ * are 64 bit, as the input can be larger than 4GB. */
+#define AST_NOOFFSET 0xffffffffffffffffULL
+
+/* struct astattr : an attribute in the packed attribute table */
+struct astattr {
+    uint32_t name; /* atom */
+    uint32_t value; /* offset in string table */
+    /* Source offsets of the text of a scoped name that outputwidl
+     * encloses in a <ref>, else AST_NOOFFSET. */
+    uint64_t refstart;
+    uint64_t refend;
+};
+
+/* struct ast : compact copy of a parse tree
+ *
+ * Elements are numbered in document order, so the root is 0. Each
+ * per-element array has count entries, except firstattr which has
+ * count + 1 so the attributes of element i are
+ * attrs[firstattr[i]] .. attrs[firstattr[i + 1] - 1]. Source offsets
+ * count bytes from the start of the first input file, carrying on
+ * through each following file.
+ *
+ * An ast returned by mapast points into the mapped file, so it must not
+ * be changed. */
+struct ast {
+    uint32_t count; /* number of elements */
+    uint32_t attrcount; /* number of attributes */
+    uint32_t stringslen; /* bytes in string table */
+    uint32_t natoms; /* number of atoms used */
+    /* Offset in string table of the name of each atom, so a reader in
+     * another process can find the names of elements and attributes. */
+    uint32_t *atomnames;
+    uint32_t *kind; /* atom of element name */
+    uint32_t *parent;
+    uint32_t *firstchild;
+    uint32_t *nextsibling;
+    uint32_t *firstattr;
+    uint32_t *id; /* offset in string table of node->fqid, else AST_NONE */
+    /* Offset in string table of the text of the node's doc comments, as
+     * returned by memcommenttext, else AST_NONE. */
+    uint32_t *comment;
+    uint64_t *wsstart; /* source offsets of node->wsstart and node->end */
+    uint64_t *end;
+    struct astattr *attrs;
+    char *strings; /* 0-terminated strings */
+    uint64_t sourcelen; /* length of source text */
+    /* Source text that source offsets are offsets in, only for an ast
+     * returned by mapast, else 0. */
+    const char *source;
+    /* For an ast returned by mapast, the mapped file, else 0. */
+    void *map;
+    size_t maplen;
+};
+
+/* Binary format written by writeast and read by mapast
+ *
+ * The file is an astheader followed by the sections, each starting at
+ * a multiple of 8 bytes: atomnames, kind, parent, firstchild,
+ * nextsibling, firstattr, id and comment as arrays of uint32_t; wsstart
+ * and end as arrays of uint64_t; attrs as an array of struct astattr;
+ * the string table; and the source text. Numbers are in the byte order of the
+ * machine that wrote the file, and mapast rejects a file in the other
+ * byte order. AST_VERSION changes whenever the format does. */
+#define AST_MAGIC "WIDLAST"
+#define AST_VERSION 1
+#define AST_BYTEORDER 0x01020304U
+
+enum {
+    AST_SECTION_ATOMNAMES, AST_SECTION_KIND, AST_SECTION_PARENT,
+    AST_SECTION_FIRSTCHILD, AST_SECTION_NEXTSIBLING, AST_SECTION_FIRSTATTR,
+    AST_SECTION_ID, AST_SECTION_COMMENT, AST_SECTION_WSSTART, AST_SECTION_END,
+    AST_SECTION_ATTRS, AST_SECTION_STRINGS, AST_SECTION_SOURCE,
+    AST_SECTION_COUNT
+};
+
+struct astheader {
+    char magic[8]; /* AST_MAGIC, 0-terminated */
+    uint32_t version; /* AST_VERSION */
+    uint32_t byteorder; /* AST_BYTEORDER */
+    uint32_t count;
+    uint32_t attrcount;
+    uint32_t stringslen;
+    uint32_t natoms;
+    uint64_t sourcelen;
+    uint64_t sections[AST_SECTION_COUNT]; /* file offset of each section */
+};
+
+struct node;
+
+struct ast *buildast(struct node *root);
+void freeast(struct ast *ast);
+void writeast(const struct ast *ast, FILE *handle);
+struct ast *mapast(const char *filename);
+uint32_t astnodewalk(const struct ast *ast, uint32_t node);
+const char *astgetattr(const struct ast *ast, uint32_t node, int name);
+const char *astatomname(const struct ast *ast, uint32_t atom);
+void checkast(const struct ast *ast, struct node *root,
+        const char *filename);
+
+#endif /* ndef ast_h */
+
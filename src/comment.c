@@ -31,7 +31,7 @@ struct cnode {
     const struct cnodefuncs *funcs;
     const char *attrtext;
     const char *filename;
-    unsigned int linenum;
+    size_t linenum;
 };
 
 struct cnodefuncs {
@@ -56,7 +56,7 @@ struct comment {
     struct node *node;
     unsigned int type;
     const char *filename;
-    unsigned int linenum;
+    size_t linenum;
     struct cnode root;
     int back; /* Whether the comment refers back rather than forward. */
     char *text;
@@ -195,37 +195,39 @@ joininlinecomments(struct comment *comments)
 
         } else {
             /* Find sequence of adjacent // comments (adjacent lines,
-             * referring to same node) and join them. We do this in two
-             * passes, one to count the length of the comment and one
-             * to join. Note that the list is still in reverse order,
-             * so we expect the line number to decrease by 1 each time. */
-            struct comment *newcomment = 0, *comment2;
+             * referring to same node) and join them. Note that the list
+             * is still in reverse order, so we expect the line number to
+             * decrease by 1 each time, and we fill in the joined text
+             * from the end. */
+            struct comment *newcomment, *comment2;
             const char *filename = comment->filename;
-            unsigned int linenum = comment->linenum;
-            for (;;) {
-                char *wp = newcomment->text;
-                comment2 = comment;
-                do {
-                    unsigned int len = strlen(comment2->text);
-                    if (newcomment)
-                        memcpy(wp, comment2->text, len);
-                    wp += len;
-                    linenum--;
-                    comment2 = comment2->next;
-                } while (comment2 && comment2->filename == filename
-                            && comment2->linenum == linenum
-                            && comment2->node == comment->node);
-                /* Finished a pass. */
-                if (newcomment) {
-                    *wp = 0;
-                    break;
-                }
-                newcomment = memalloc(sizeof(struct comment)
-                                + wp - newcomment->text);
-                newcomment->node = comment->node;
-                newcomment->type = comment->type;
-                newcomment->filename = filename;
-                newcomment->linenum = linenum + 1;
+            size_t linenum = comment->linenum;
+            size_t len = 0;
+            comment2 = comment;
+            do {
+                len += strlen(comment2->text);
+                linenum--;
+                comment2 = comment2->next;
+            } while (comment2 && comment2->filename == filename
+                        && comment2->linenum == linenum
+                        && comment2->node == comment->node);
+            newcomment = memalloc(sizeof(struct comment));
+            newcomment->text = memalloc(len + 1);
+            newcomment->node = comment->node;
+            newcomment->type = comment->type;
+            newcomment->filename = filename;
+            newcomment->linenum = linenum + 1;
+            while (comment != comment2) {
+                struct comment *next = comment->next;
+                size_t thislen = strlen(comment->text);
+                len -= thislen;
+                memcpy(newcomment->text + len, comment->text, thislen);
+                /* The first line of the joined comment decides whether it
+                 * refers back. */
+                newcomment->back = comment->back;
+                memfree(comment->text);
+                memfree(comment);
+                comment = next;
             }
             /* Replace the scanned comment struct with newcomment in the
              * list. */
@@ -352,7 +354,7 @@ endcnode(struct cnode *cnode)
  */
 static struct cnode *
 endspecificcnode(struct cnode *cnode, const struct cnodefuncs *type,
-                 const char *filename, unsigned int linenum)
+                 const char *filename, size_t linenum)
 {
     while (cnode->funcs != type) {
         if (cnode->funcs == &root_funcs)
@@ -611,8 +613,8 @@ startpara(struct cnode *cnode, const struct cnodefuncs *type)
 struct textcnode {
     struct cnode cn;
     unsigned char *data;
-    unsigned int len;
-    unsigned int max;
+    size_t len;
+    size_t max;
 };
 
 /***********************************************************************
@@ -640,10 +642,10 @@ text_output(struct cnode *cnode, unsigned int indent)
 {
     /* We do not indent, in case this is inside a code cnode. */
     struct textcnode *textcnode = (void *)cnode;
-    unsigned int len = textcnode->len;
+    size_t len = textcnode->len;
     unsigned const char *p = textcnode->data;
     while (len) {
-        unsigned int thislen;
+        size_t thislen;
         const char *thisptr;
         thislen = p[0];
         /* (void *) cast is to avoid a warning from the MS compiler.
@@ -732,8 +734,8 @@ static const struct cnodefuncs html_funcs = {
  */
 static struct cnode *
 starthtmlcnode(struct cnode *cnode, const struct htmleldesc *htmleldesc,
-               const char *attrs, unsigned int attrslen,
-               const char *filename, unsigned int linenum)
+               const char *attrs, size_t attrslen,
+               const char *filename, size_t linenum)
 {
     struct htmlcnode *htmlcnode;
     /* First close enough elements to get to a content
@@ -828,7 +830,7 @@ static const struct cnodefuncs throw_funcs = {
  * Return:  new current cnode
  */
 static struct cnode *
-startparamcnode(struct cnode *cnode, const char *word, unsigned int wordlen,
+startparamcnode(struct cnode *cnode, const char *word, size_t wordlen,
                 int inout, const struct cnodefuncs *funcs)
 {
     struct paramcnode *paramcnode;
@@ -1085,7 +1087,7 @@ static const struct cnodefuncs def_device_cap_funcs = {
  * Return:  new current cnode
  */
 static struct cnode *
-addtext(struct cnode *cnode, const char *text, unsigned int len)
+addtext(struct cnode *cnode, const char *text, size_t len)
 {
     struct textcnode *textcnode;
     if (!len)
@@ -1099,7 +1101,7 @@ addtext(struct cnode *cnode, const char *text, unsigned int len)
     textcnode = (void *)cnode;
     do {
         unsigned char buf[1 + sizeof(void *)];
-        unsigned int thislen = len;
+        size_t thislen = len;
         if (thislen > 255)
             thislen = 255;
         /* Encode a record as a single byte length followed by a pointer. */
@@ -1180,7 +1182,7 @@ parseword(const char **pp)
  */
 static const char *
 dox_b(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-      const char *filename, unsigned int linenum, const char *cmdname)
+      const char *filename, size_t linenum, const char *cmdname)
 {
     struct cnode *cnode = *pcnode;
     const char *word = parseword(&p);
@@ -1202,7 +1204,7 @@ dox_b(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_n(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-      const char *filename, unsigned int linenum, const char *cmdname)
+      const char *filename, size_t linenum, const char *cmdname)
 {
     struct cnode *cnode = *pcnode;
     cnode = starthtmlcnode(cnode, HTMLELDESC_BR, 0, 0, filename, linenum);
@@ -1216,7 +1218,7 @@ dox_n(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_code(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-         const char *filename, unsigned int linenum, const char *cmdname)
+         const char *filename, size_t linenum, const char *cmdname)
 {
     *pcnode = startpara(*pcnode, &code_funcs);
     (*pcnode)->filename = filename;
@@ -1230,7 +1232,7 @@ dox_code(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_endcode(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-            const char *filename, unsigned int linenum, const char *cmdname)
+            const char *filename, size_t linenum, const char *cmdname)
 {
     incode = 0;
     *pcnode = endspecificcnode(*pcnode, &code_funcs, filename, linenum);
@@ -1242,7 +1244,7 @@ dox_endcode(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_param(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-          const char *filename, unsigned int linenum, const char *cmdname)
+          const char *filename, size_t linenum, const char *cmdname)
 {
     struct cnode *cnode = *pcnode;
     unsigned int inout = 0;
@@ -1286,7 +1288,7 @@ dox_param(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_para(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-         const char *filename, unsigned int linenum, const char *cmdname)
+         const char *filename, size_t linenum, const char *cmdname)
 {
     *pcnode = startpara(*pcnode, type);
     return p;
@@ -1297,7 +1299,7 @@ dox_para(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_throw(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-          const char *filename, unsigned int linenum, const char *cmdname)
+          const char *filename, size_t linenum, const char *cmdname)
 {
     struct cnode *cnode = *pcnode;
     const char *word;
@@ -1321,11 +1323,11 @@ dox_throw(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  */
 static const char *
 dox_attr(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
-          const char *filename, unsigned int linenum, const char *cmdname)
+          const char *filename, size_t linenum, const char *cmdname)
 {
   struct cnode *cnode = *pcnode;
     const char *word;
-    int len, wordlen, offset = 0;
+    size_t len, wordlen, offset = 0;
 	char *attrtext;
     /* Get the next word as the attribute value. */
     word = parseword(&p);
@@ -1354,7 +1356,7 @@ dox_attr(const char *p, struct cnode **pcnode, const struct cnodefuncs *type,
  * commands : table of Doxygen commands
  */
 struct command {
-    const char *(*func)(const char *p, struct cnode **pcnode, const struct cnodefuncs *type, const char *filename, unsigned int linenum, const char *cmdname);
+    const char *(*func)(const char *p, struct cnode **pcnode, const struct cnodefuncs *type, const char *filename, size_t linenum, const char *cmdname);
     const struct cnodefuncs *type;
     unsigned int namelen;
     const char *name;
@@ -1394,14 +1396,14 @@ static const struct command commands[] = {
  */
 static const char *
 parsehtmltag(const char *start, struct cnode **pcnode,
-             const char *filename, unsigned int *plinenum)
+             const char *filename, size_t *plinenum)
 {
     struct cnode *cnode = *pcnode;
     const char *end = start + 1, *endname = 0, *name = end;
     int ch = *end;
     int quote = 0;
     int close = 0;
-    unsigned int linenum = *plinenum;
+    size_t linenum = *plinenum;
     const struct htmleldesc *htmleldesc;
     if (ch == '/') {
         close = 1;
@@ -1494,8 +1496,10 @@ static void
 parsecomment(struct comment *comment)
 {
     struct cnode *cnode = &comment->root;
-    const char *p = comment->text + comment->back;
-    unsigned int linenum = comment->linenum - 1;
+    /* Skip the '*', '/' or '!' and the '<' of a comment that refers
+     * back. */
+    const char *p = comment->text + (comment->back ? 2 : 0);
+    size_t linenum = comment->linenum - 1;
     int ch;
     curcomment = comment;
     incode = 0;
@@ -1587,7 +1591,7 @@ checkforlineofstars:
                 /* This search could be faster if the entity names were put
                  * in a hash table or something. */
                 const char *semicolon = strchr(p, ';');
-                unsigned int len;
+                size_t len;
                 if (!semicolon)
                     locerrorexit(comment->filename, linenum, "unterminated HTML entity");
                 p++;
@@ -1807,6 +1811,52 @@ processcomments(struct node *root)
     comments = joininlinecomments(comments);
     parsecomments(comments);
     attachcomments(comments, root);
+    /* Every comment is now in some node's list. */
+    comments = 0;
+    lastidentifier = 0;
+}
+
+/***********************************************************************
+ * discardcomments : discard comments not yet processed
+ */
+void
+discardcomments(void)
+{
+    freecomments(comments);
+    comments = 0;
+    lastidentifier = 0;
+}
+
+/***********************************************************************
+ * abandoncomments : forget comments not yet processed, without freeing
+ *                   them
+ *
+ * This is for after an error in processcomments, which may have left
+ * some of them attached to parse nodes, so they are freed with those
+ * nodes instead.
+ */
+void
+abandoncomments(void)
+{
+    comments = 0;
+    lastidentifier = 0;
+}
+
+/***********************************************************************
+ * outputcomments : output the contents of the descriptive element for
+ *                  a node
+ *
+ * Enter:   node = identifier node that might have some comments
+ *          indent = indent (nesting) level
+ */
+void
+outputcomments(struct node *node, unsigned int indent)
+{
+    struct comment *comment;
+    for (comment = node->comments; comment; comment = comment->next) {
+        struct cnode *root = &comment->root;
+        (*root->funcs->output)(root, indent);
+    }
 }
 
 /***********************************************************************
@@ -1818,16 +1868,100 @@ processcomments(struct node *root)
 void
 outputdescriptive(struct node *node, unsigned int indent)
 {
-    struct comment *comment = node->comments;
-    int indescriptive = 0;
+    if (node->comments) {
+        printf("%*s<descriptive>\n", indent, "");
+        outputcomments(node, indent + 2);
+        printf("%*s</descriptive>\n", indent, "");
+    }
+}
+
+/***********************************************************************
+ * memcommenttext : get the text of the comments attached to a node
+ *
+ * Enter:   node = parse node
+ *
+ * Return:  0 if none, else allocated 0-terminated text of its comments,
+ *          as written between the comment delimiters, separated by
+ *          newlines
+ *
+ * A comment split off another one, as for \param, has no text of its
+ * own, so it is omitted.
+ */
+char *
+memcommenttext(struct node *node)
+{
+    struct comment *comment;
+    size_t len = 0;
+    char *text, *p;
+    for (comment = node->comments; comment; comment = comment->next) {
+        if (comment->text)
+            len += strlen(comment->text) + 1;
+    }
+    if (!len)
+        return 0;
+    p = text = memalloc(len);
+    for (comment = node->comments; comment; comment = comment->next) {
+        size_t thislen;
+        if (!comment->text)
+            continue;
+        thislen = strlen(comment->text);
+        if (p != text)
+            *p++ = '\n';
+        memcpy(p, comment->text, thislen);
+        p += thislen;
+    }
+    *p = 0;
+    return text;
+}
+
+/***********************************************************************
+ * movecomments : move the comments of one node to the end of another's
+ *
+ * Enter:   from = node to take comments from
+ *          to = node to give them to
+ */
+void
+movecomments(struct node *from, struct node *to)
+{
+    struct comment **pcomment = &to->comments;
+    while (*pcomment)
+        pcomment = &(*pcomment)->next;
+    *pcomment = from->comments;
+    from->comments = 0;
+}
+
+/***********************************************************************
+ * freecomments : free a list of comments
+ *
+ * Enter:   comment = first comment in list, or 0
+ *
+ * The cnodes of each comment are spliced onto the front of a list of
+ * cnodes still to free, so the walk needs no stack.
+ */
+void
+freecomments(struct comment *comment)
+{
     while (comment) {
-        struct cnode *root = &comment->root;
-        if (!indescriptive)
-            printf("%*s<descriptive>\n", indent, "");
-        indescriptive = 1;
-        (*root->funcs->output)(root, indent + 2);
-        comment = comment->next;
+        struct comment *next = comment->next;
+        struct cnode *list = comment->root.children;
+        while (list) {
+            struct cnode *cnode = list;
+            list = cnode->next;
+            if (cnode->children) {
+                struct cnode *last = cnode->children;
+                while (last->next)
+                    last = last->next;
+                last->next = list;
+                list = cnode->children;
+            }
+            if (cnode->funcs == &text_funcs && ((struct textcnode *)cnode)->data)
+                memfree(((struct textcnode *)cnode)->data);
+            memfree(cnode);
+        }
+        if (comment->text)
+            memfree(comment->text);
+        memfree(comment);
+        comment = next;
     }
-    if (indescriptive)
-        printf("%*s</descriptive>\n", indent, "");
 }
+
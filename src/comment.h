@@ -14,12 +14,19 @@
 #ifndef comment_h
 #define comment_h
 
+struct comment;
 struct tok;
 struct node;
 
 void addcomment(struct tok *tok);
 void setcommentnode(struct node *node2);
 void processcomments(struct node *root);
+void discardcomments(void);
+void abandoncomments(void);
+void outputcomments(struct node *node, unsigned int indent);
 void outputdescriptive(struct node *node, unsigned int indent);
+char *memcommenttext(struct node *node);
+void movecomments(struct node *from, struct node *to);
+void freecomments(struct comment *comment);
 
 #endif /* ndef comment_h */
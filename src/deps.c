@@ -0,0 +1,440 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Dependency graph of definitions
+ ***********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "ast.h"
+#include "deps.h"
+#include "hash.h"
+#include "json.h"
+#include "misc.h"
+#include "node.h"
+
+/* Kinds of dependency, in the order of edgekinds. */
+enum { EDGE_INHERITS, EDGE_IMPLEMENTS, EDGE_USES };
+static const char *const edgekinds[] = { "inherits", "implements", "uses" };
+
+/* struct edge : a dependency of one definition on another */
+struct edge {
+    unsigned int target; /* index of vertex depended on */
+    int kind; /* EDGE_* */
+};
+
+/* struct vertex : a definition in the dependency graph
+ *
+ * A partial definition shares the vertex of the definition of that
+ * name, so its dependencies are those of the definition. */
+struct vertex {
+    const char *name;
+    const char *kind; /* element name of the first definition of it */
+    struct edge *edges;
+    unsigned int nedges, maxedges;
+    /* Used by findcomponents: the order it was reached in (0 if not
+     * yet), the lowest such order reachable from it while its component
+     * is being found, the next edge to follow, and whether it is on the
+     * stack of vertices whose component is not yet known. */
+    unsigned int index, lowlink, next;
+    int onstack;
+};
+
+static struct hashtable symbols;
+static struct vertex *vertices;
+static unsigned int nvertices, maxvertices;
+
+/* The vertices in dependency order, and the start of each strongly
+ * connected component in it, set by findcomponents. */
+static unsigned int *order;
+static unsigned int *components;
+static unsigned int ncomponents;
+
+/***********************************************************************
+ * findvertex : find the vertex of a definition by name
+ *
+ * Enter:   name = name, which can start with ::
+ *
+ * Return:  index of vertex, -1 if the input has no definition of that
+ *          name
+ */
+static int
+findvertex(const char *name)
+{
+    size_t value;
+    if (name[0] == ':' && name[1] == ':')
+        name += 2;
+    value = (size_t)hashget(&symbols, name, strlen(name));
+    return (int)value - 1;
+}
+
+/***********************************************************************
+ * addvertex : add a definition to the graph
+ *
+ * Enter:   ast
+ *          node = index of definition element
+ *
+ * The vertex is found by name in the symbol index, and added if it is
+ * not there.
+ */
+static void
+addvertex(const struct ast *ast, uint32_t node)
+{
+    const char *name = astgetattr(ast, node, NAME_name);
+    void **pvalue;
+    if (!name)
+        return;
+    pvalue = hashput(&symbols, name, strlen(name));
+    if (*pvalue)
+        return;
+    if (nvertices == maxvertices) {
+        maxvertices = maxvertices ? 2 * maxvertices : 64;
+        vertices = memrealloc(vertices, maxvertices * sizeof(struct vertex));
+    }
+    memset(&vertices[nvertices], 0, sizeof(struct vertex));
+    vertices[nvertices].name = name;
+    vertices[nvertices].kind = astatomname(ast, ast->kind[node]);
+    *pvalue = (void *)(size_t)++nvertices;
+}
+
+/***********************************************************************
+ * addedge : add a dependency to the graph
+ *
+ * Enter:   source = index of vertex that depends
+ *          name = name of definition depended on
+ *          kind = EDGE_*
+ *
+ * A name not defined in the input, such as one from another
+ * specification, and a definition's use of itself, add nothing.
+ */
+static void
+addedge(unsigned int source, const char *name, int kind)
+{
+    struct vertex *vertex = &vertices[source];
+    int target = findvertex(name);
+    if (target < 0 || (unsigned int)target == source)
+        return;
+    if (vertex->nedges == vertex->maxedges) {
+        vertex->maxedges = vertex->maxedges ? 2 * vertex->maxedges : 4;
+        vertex->edges = memrealloc(vertex->edges,
+                vertex->maxedges * sizeof(struct edge));
+    }
+    vertex->edges[vertex->nedges].target = target;
+    vertex->edges[vertex->nedges++].kind = kind;
+}
+
+/***********************************************************************
+ * addreferences : add the dependencies of a definition
+ *
+ * Enter:   ast
+ *          definition = index of definition element
+ *          source = index of its vertex
+ *
+ * Each scoped name recorded by the parser in the definition is a
+ * dependency: a Name in an inheritance list, and a Type naming another
+ * definition, as used by a member, argument or typedef. The names in
+ * [Exposed], [Global] and [PrimaryGlobal] are globals rather than
+ * types, and the elements added by the other options repeat what is
+ * already there, so they are skipped. The walk is iterative, so a deep
+ * tree cannot overflow the stack.
+ */
+static void
+addreferences(const struct ast *ast, uint32_t definition, unsigned int source)
+{
+    uint32_t node = ast->firstchild[definition];
+    while (node != AST_NONE) {
+        int descend = 1, bit;
+        uint32_t parentkind;
+        switch (ast->kind[node]) {
+        case NAME_Type:
+            if (astgetattr(ast, node, NAME_name))
+                addedge(source, astgetattr(ast, node, NAME_name), EDGE_USES);
+            break;
+        case NAME_Name:
+            parentkind = ast->kind[ast->parent[node]];
+            if (parentkind == NAME_InterfaceInheritance
+                    || parentkind == NAME_DictionaryInheritance)
+            {
+                addedge(source, astgetattr(ast, node, NAME_name),
+                        EDGE_INHERITS);
+            }
+            break;
+        case NAME_ExtendedAttribute:
+            bit = extattrbit(astgetattr(ast, node, NAME_name));
+            descend = bit != EXTATTR_Exposed && bit != EXTATTR_Global
+                    && bit != EXTATTR_PrimaryGlobal;
+            break;
+        case NAME_FlattenedMembers:
+        case NAME_FlattenedUnion:
+        case NAME_OverloadSet:
+            descend = 0;
+            break;
+        }
+        if (descend && ast->firstchild[node] != AST_NONE) {
+            node = ast->firstchild[node];
+            continue;
+        }
+        while (ast->nextsibling[node] == AST_NONE) {
+            node = ast->parent[node];
+            if (node == definition)
+                return;
+        }
+        node = ast->nextsibling[node];
+    }
+}
+
+/***********************************************************************
+ * dedupedges : remove repeated dependencies
+ *
+ * Each vertex keeps the first dependency on each other vertex. A stamp
+ * per target vertex makes this linear in the number of edges.
+ */
+static void
+dedupedges(void)
+{
+    unsigned int *stamps = memalloc((nvertices + 1) * sizeof(unsigned int));
+    unsigned int i, j, count;
+    for (i = 0; i != nvertices; i++) {
+        struct vertex *vertex = &vertices[i];
+        count = 0;
+        for (j = 0; j != vertex->nedges; j++) {
+            unsigned int target = vertex->edges[j].target;
+            if (stamps[target] != i + 1) {
+                stamps[target] = i + 1;
+                vertex->edges[count++] = vertex->edges[j];
+            }
+        }
+        vertex->nedges = count;
+    }
+    memfree(stamps);
+}
+
+/***********************************************************************
+ * reach : give a vertex its index and put it on the stack
+ */
+static void
+reach(unsigned int v, unsigned int *pcounter, unsigned int *stack,
+      unsigned int *pnstack)
+{
+    vertices[v].index = vertices[v].lowlink = ++*pcounter;
+    vertices[v].onstack = 1;
+    stack[(*pnstack)++] = v;
+}
+
+/***********************************************************************
+ * findcomponents : find the strongly connected components and the
+ *                  dependency order
+ *
+ * This is Tarjan's algorithm, which is linear in the number of vertices
+ * and edges. It finishes a component only once each component it
+ * depends on is finished, so listing them as they finish gives the
+ * definitions in dependency order: each definition after those it
+ * depends on, apart from within a cycle. The recursion is kept in an
+ * array, so a long chain of dependencies cannot overflow the stack.
+ */
+static void
+findcomponents(void)
+{
+    unsigned int *calls = memalloc((nvertices + 1) * sizeof(unsigned int));
+    unsigned int *stack = memalloc((nvertices + 1) * sizeof(unsigned int));
+    unsigned int ncalls, nstack = 0, norder = 0, counter = 0, root;
+    order = memalloc((nvertices + 1) * sizeof(unsigned int));
+    components = memalloc((nvertices + 1) * sizeof(unsigned int));
+    ncomponents = 0;
+    for (root = 0; root != nvertices; root++) {
+        if (vertices[root].index)
+            continue;
+        reach(root, &counter, stack, &nstack);
+        calls[0] = root;
+        ncalls = 1;
+        while (ncalls) {
+            unsigned int v = calls[ncalls - 1], w;
+            struct vertex *vertex = &vertices[v];
+            if (vertex->next != vertex->nedges) {
+                w = vertex->edges[vertex->next++].target;
+                if (!vertices[w].index) {
+                    reach(w, &counter, stack, &nstack);
+                    calls[ncalls++] = w;
+                } else if (vertices[w].onstack
+                        && vertices[w].index < vertex->lowlink)
+                {
+                    vertex->lowlink = vertices[w].index;
+                }
+                continue;
+            }
+            if (--ncalls && vertex->lowlink < vertices[calls[ncalls - 1]].lowlink)
+                vertices[calls[ncalls - 1]].lowlink = vertex->lowlink;
+            if (vertex->lowlink != vertex->index)
+                continue;
+            /* v is the first vertex reached in its component, so the
+             * component is v and those above it on the stack. */
+            components[ncomponents++] = norder;
+            do {
+                w = stack[--nstack];
+                vertices[w].onstack = 0;
+                order[norder++] = w;
+            } while (w != v);
+        }
+    }
+    components[ncomponents] = norder;
+    memfree(stack);
+    memfree(calls);
+}
+
+/***********************************************************************
+ * printjsonstring : output a quoted and escaped JSON string
+ */
+static void
+printjsonstring(const char *s)
+{
+    char *quoted = memjsonstring(s, strlen(s));
+    fputs(quoted, stdout);
+    memfree(quoted);
+}
+
+/***********************************************************************
+ * outputjson : output the graph as JSON
+ *
+ * The definitions are in document order, each with its dependencies.
+ * Then come the names in dependency order, and the strongly connected
+ * components of more than one definition, which are the cycles.
+ */
+static void
+outputjson(void)
+{
+    unsigned int i, j;
+    const char *sep = "";
+    printf("{\n  \"definitions\": [");
+    for (i = 0; i != nvertices; i++) {
+        const struct vertex *vertex = &vertices[i];
+        printf("%s\n    { \"name\": ", i ? "," : "");
+        printjsonstring(vertex->name);
+        printf(", \"kind\": \"%s\", \"dependencies\": [", vertex->kind);
+        for (j = 0; j != vertex->nedges; j++) {
+            printf("%s\n        { \"name\": ", j ? "," : "");
+            printjsonstring(vertices[vertex->edges[j].target].name);
+            printf(", \"kind\": \"%s\" }", edgekinds[vertex->edges[j].kind]);
+        }
+        printf(vertex->nedges ? "\n      ] }" : "] }");
+    }
+    printf("%s],\n  \"order\": [", nvertices ? "\n  " : "");
+    for (i = 0; i != nvertices; i++) {
+        printf(i ? ", " : "");
+        printjsonstring(vertices[order[i]].name);
+    }
+    printf("],\n  \"components\": [");
+    for (i = 0; i != ncomponents; i++) {
+        if (components[i + 1] - components[i] < 2)
+            continue;
+        printf("%s\n    [", sep);
+        sep = ",";
+        for (j = components[i]; j != components[i + 1]; j++) {
+            printf(j != components[i] ? ", " : "");
+            printjsonstring(vertices[order[j]].name);
+        }
+        printf("]");
+    }
+    printf("%s]\n}\n", *sep ? "\n  " : "");
+}
+
+/***********************************************************************
+ * outputdot : output the graph in Graphviz dot format
+ *
+ * Each definition is a node, given in dependency order, and each
+ * dependency an edge labelled with its kind. Each strongly connected
+ * component of more than one definition is a cluster.
+ */
+static void
+outputdot(void)
+{
+    unsigned int i, j;
+    printf("digraph deps {\n");
+    for (i = 0; i != ncomponents; i++) {
+        int cluster = components[i + 1] - components[i] > 1;
+        if (cluster)
+            printf("  subgraph cluster_%u {\n    label=\"cycle\";\n", i);
+        for (j = components[i]; j != components[i + 1]; j++) {
+            const struct vertex *vertex = &vertices[order[j]];
+            printf("%*s\"%s\" [shape=box, label=\"%s %s\"];\n",
+                    cluster ? 4 : 2, "", vertex->name, vertex->kind,
+                    vertex->name);
+        }
+        if (cluster)
+            printf("  }\n");
+    }
+    for (i = 0; i != nvertices; i++) {
+        const struct vertex *vertex = &vertices[i];
+        for (j = 0; j != vertex->nedges; j++) {
+            printf("  \"%s\" -> \"%s\" [label=\"%s\"];\n", vertex->name,
+                    vertices[vertex->edges[j].target].name,
+                    edgekinds[vertex->edges[j].kind]);
+        }
+    }
+    printf("}\n");
+}
+
+/***********************************************************************
+ * outputdeps : output the dependency graph of the definitions
+ *
+ * Enter:   ast = compact copy of parse tree
+ *          dot = non-zero for Graphviz dot format, else JSON
+ *
+ * This reads only the ast, so the caller can free the parse tree
+ * first. Each definition is indexed by name first, so each reference is
+ * then one hash lookup, and the whole graph, its strongly connected
+ * components and the dependency order take time linear in the size of
+ * the input. An implements statement is a dependency of the interface
+ * that implements on the interface implemented.
+ */
+void
+outputdeps(const struct ast *ast, int dot)
+{
+    uint32_t node;
+    unsigned int i;
+    for (node = ast->firstchild[0]; node != AST_NONE;
+            node = ast->nextsibling[node])
+    {
+        if (ast->kind[node] != NAME_Implements)
+            addvertex(ast, node);
+    }
+    for (node = ast->firstchild[0]; node != AST_NONE;
+            node = ast->nextsibling[node])
+    {
+        const char *name;
+        int source;
+        if (ast->kind[node] == NAME_Implements) {
+            source = findvertex(astgetattr(ast, node, NAME_name1));
+            if (source >= 0) {
+                addedge(source, astgetattr(ast, node, NAME_name2),
+                        EDGE_IMPLEMENTS);
+            }
+        } else if ((name = astgetattr(ast, node, NAME_name)))
+            addreferences(ast, node, findvertex(name));
+    }
+    dedupedges();
+    findcomponents();
+    if (dot)
+        outputdot();
+    else
+        outputjson();
+    for (i = 0; i != nvertices; i++) {
+        if (vertices[i].edges)
+            memfree(vertices[i].edges);
+    }
+    if (vertices)
+        memfree(vertices);
+    memfree(order);
+    memfree(components);
+    hashfree(&symbols);
+    vertices = 0;
+    nvertices = maxvertices = 0;
+}
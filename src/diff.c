@@ -0,0 +1,487 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Structural diff of two sets of Web IDL
+ ***********************************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+#include "comment.h"
+#include "diff.h"
+#include "hash.h"
+#include "lex.h"
+#include "misc.h"
+#include "node.h"
+#include "parse.h"
+#include "type.h"
+
+/* struct match : a child element of the old tree, in the list of those
+ * with the same key, to be matched with one of the new tree */
+struct match {
+    struct match *next;
+    struct node *node;
+    char *key;
+};
+
+/***********************************************************************
+ * hashbytes : add bytes to a hash
+ *
+ * Enter:   hash = hash so far
+ *          s = bytes
+ *          len = number of bytes
+ *
+ * Return:  new hash
+ *
+ * This is 64-bit FNV-1a.
+ */
+static unsigned long long
+hashbytes(unsigned long long hash, const void *s, size_t len)
+{
+    const unsigned char *p = s;
+    while (len--) {
+        hash ^= *p++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/***********************************************************************
+ * numericvalue : get the evaluated value of an element if it is a number
+ *
+ * Enter:   node = element
+ *
+ * Return:  its constvalue, 0 if it has none or it is not a number
+ */
+static const struct constvalue *
+numericvalue(struct node *node)
+{
+    const struct constvalue *value = ((struct element *)node)->constvalue;
+    if (value && (value->kind == VALUE_INTEGER
+            || value->kind == VALUE_UNSIGNED || value->kind == VALUE_FLOAT))
+    {
+        return value;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * isvalueattr : test whether an attribute gives the text of a number
+ *               that numericvalue compares instead
+ */
+static int
+isvalueattr(struct node *element, struct node *attr)
+{
+    int name = ((struct attr *)attr)->name;
+    return (name == NAME_value || name == NAME_normalized)
+            && numericvalue(element);
+}
+
+/***********************************************************************
+ * samevalue : test whether two elements have the same numeric value
+ *
+ * Enter:   old = element in old tree
+ *          new = element in new tree
+ *
+ * Return:  non-zero if both have numeric values and they are the same
+ */
+static int
+samevalue(struct node *old, struct node *new)
+{
+    const struct constvalue *oldvalue = numericvalue(old);
+    const struct constvalue *newvalue = numericvalue(new);
+    return oldvalue && newvalue && oldvalue->kind == newvalue->kind
+            && !memcmp(&oldvalue->u, &newvalue->u, sizeof(oldvalue->u));
+}
+
+/***********************************************************************
+ * sethashes : set the hash of each element
+ *
+ * Enter:   root = root of parse tree
+ *
+ * An element's hash covers its name, its attributes and the hashes of
+ * its child elements in order, so two elements have the same hash
+ * when their subtrees are the same, not counting comments and source
+ * text. A number is hashed by its evaluated value rather than its text,
+ * so writing it differently, such as in hex, is not a change. The
+ * elements are found in document order and then hashed in reverse
+ * order, so each is hashed after its children.
+ */
+void
+sethashes(struct node *root)
+{
+    struct node *node, **nodes = 0;
+    size_t count = 0, max = 0;
+    for (node = root; node; node = nodewalk(node)) {
+        if (node->type != NODE_ELEMENT)
+            continue;
+        if (count == max) {
+            max = max ? 2 * max : 64;
+            nodes = memrealloc(nodes, max * sizeof(struct node *));
+        }
+        nodes[count++] = node;
+    }
+    while (count) {
+        struct element *element = (void *)nodes[--count];
+        const struct constvalue *value = numericvalue(&element->n);
+        const char *name = atomname(element->name);
+        unsigned long long hash = hashbytes(0xcbf29ce484222325ULL, name,
+                strlen(name) + 1);
+        struct node *child;
+        if (value) {
+            hash = hashbytes(hash, &value->kind, sizeof(value->kind));
+            hash = hashbytes(hash, &value->u, sizeof(value->u));
+        }
+        for (child = element->n.children; child; child = child->next) {
+            if (child->type == NODE_ATTR) {
+                struct attr *attr = (void *)child;
+                if (isvalueattr(&element->n, child))
+                    continue;
+                name = atomname(attr->name);
+                hash = hashbytes(hash, "@", 1);
+                hash = hashbytes(hash, name, strlen(name) + 1);
+                hash = hashbytes(hash, attr->value, strlen(attr->value) + 1);
+            } else {
+                unsigned long long childhash = ((struct element *)child)->hash;
+                hash = hashbytes(hash, &childhash, sizeof(childhash));
+            }
+        }
+        element->hash = hash;
+    }
+    if (nodes)
+        memfree(nodes);
+}
+
+/***********************************************************************
+ * comparenames : compare two filenames, for qsort
+ */
+static int
+comparenames(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/***********************************************************************
+ * listinputs : list the input files of one side of the diff
+ *
+ * Enter:   name = name of a file, or of a directory whose .widl files
+ *                 are the input
+ *
+ * Return:  allocated 0-terminated array of filenames, sorted for a
+ *          directory
+ */
+static char **
+listinputs(const char *name)
+{
+    char **names = 0;
+    size_t count = 0;
+    struct stat st;
+    if (stat(name, &st))
+        errorexit("%s: %s", name, strerror(errno));
+    if (!(st.st_mode & S_IFDIR)) {
+        names = memalloc(2 * sizeof(char *));
+        names[0] = memprintf("%s", name);
+        return names;
+    }
+    {
+#ifdef _MSC_VER
+        char *pattern = memprintf("%s\\*.widl", name);
+        struct _finddata_t data;
+        intptr_t handle = _findfirst(pattern, &data);
+        memfree(pattern);
+        if (handle != -1) {
+            do {
+                names = memrealloc(names, (count + 2) * sizeof(char *));
+                names[count++] = memprintf("%s\\%s", name, data.name);
+            } while (!_findnext(handle, &data));
+            _findclose(handle);
+        }
+#else
+        DIR *dir = opendir(name);
+        struct dirent *entry;
+        if (!dir)
+            errorexit("%s: %s", name, strerror(errno));
+        while ((entry = readdir(dir))) {
+            size_t len = strlen(entry->d_name);
+            if (len > 5 && !strcmp(entry->d_name + len - 5, ".widl")) {
+                names = memrealloc(names, (count + 2) * sizeof(char *));
+                names[count++] = memprintf("%s/%s", name, entry->d_name);
+            }
+        }
+        closedir(dir);
+#endif
+    }
+    if (!count)
+        errorexit("%s: no .widl files", name);
+    qsort(names, count, sizeof(char *), comparenames);
+    names[count] = 0;
+    return names;
+}
+
+/***********************************************************************
+ * parseside : parse one side of the diff
+ *
+ * Enter:   name = name of file or directory
+ *
+ * Return:  root of parse tree, with hashes set
+ *
+ * The input buffers and filenames are not freed, as the tree and the
+ * lexer point into them.
+ */
+static struct node *
+parseside(const char *name)
+{
+    struct node *root;
+    readinput((const char *const *)listinputs(name));
+    root = parse();
+    settypeforms(root);
+    discardcomments();
+    sethashes(root);
+    return root;
+}
+
+/***********************************************************************
+ * label : make the label of an element in the report
+ *
+ * Enter:   node = element
+ *
+ * Return:  allocated label, which is also its key for matching
+ *
+ * The label is the name, for an element that has one, the quoted value
+ * for an enum value, the source text for an extended attribute, so a
+ * change of its arguments shows as one removed and one added, and
+ * otherwise empty.
+ */
+static char *
+label(struct node *node)
+{
+    struct element *element = (void *)node;
+    const char *name = getattr(node, NAME_name);
+    if (element->name == NAME_ExtendedAttribute && node->wsstart) {
+        const char *start = node->wsstart, *end = node->end;
+        while (start != end && (*start == ' ' || *start == '\t'
+                || *start == '\r' || *start == '\n'))
+        {
+            start++;
+        }
+        return memprintf("[%.*s]", (int)(end - start), start);
+    }
+    if (name)
+        return memprintf("%s", name);
+    if (element->name == NAME_EnumValue)
+        return memprintf("\"%s\"", getattr(node, NAME_stringvalue));
+    if (element->name == NAME_Implements) {
+        return memprintf("%s implements %s", getattr(node, NAME_name1),
+                getattr(node, NAME_name2));
+    }
+    return memprintf("%s", "");
+}
+
+/***********************************************************************
+ * report : output a line of the report for an element
+ *
+ * Enter:   depth = nesting depth
+ *          op = '+' for added, '-' for removed, '~' for changed
+ *          node = element
+ *
+ * A type is shown as its Web IDL, and anything else as its label.
+ */
+static void
+report(unsigned int depth, int op, struct node *node)
+{
+    struct element *element = (void *)node;
+    char *s = element->name == NAME_Type
+            ? memprintf("%s", element->typeform->key) : label(node);
+    printf("%*s%c %s%s%s\n", 2 * depth, "", op, atomname(element->name),
+            *s ? " " : "", s);
+    memfree(s);
+}
+
+static void diffelements(struct node *old, struct node *new,
+        unsigned int depth);
+
+/***********************************************************************
+ * diffattrs : report the differences between two elements' attributes
+ *
+ * Enter:   old = element in old tree
+ *          new = element in new tree
+ *          depth = nesting depth for report lines
+ *
+ * An element has few attributes, so they are just compared in pairs.
+ * The text of numbers with the same value is not compared.
+ */
+static void
+diffattrs(struct node *old, struct node *new, unsigned int depth)
+{
+    int same = samevalue(old, new);
+    struct node *child;
+    for (child = old->children; child; child = child->next) {
+        struct attr *attr = (void *)child;
+        const char *value;
+        if (child->type != NODE_ATTR || (same && isvalueattr(old, child)))
+            continue;
+        value = getattr(new, attr->name);
+        if (!value) {
+            printf("%*s- @%s=%s\n", 2 * depth, "", atomname(attr->name),
+                    attr->value);
+        } else if (strcmp(value, attr->value)) {
+            printf("%*s~ @%s: %s -> %s\n", 2 * depth, "",
+                    atomname(attr->name), attr->value, value);
+        }
+    }
+    for (child = new->children; child; child = child->next) {
+        struct attr *attr = (void *)child;
+        if (child->type == NODE_ATTR && !(same && isvalueattr(new, child))
+                && !getattr(old, attr->name))
+        {
+            printf("%*s+ @%s=%s\n", 2 * depth, "", atomname(attr->name),
+                    attr->value);
+        }
+    }
+}
+
+/***********************************************************************
+ * diffchildren : report the differences between two elements' children
+ *
+ * Enter:   old = element in old tree
+ *          new = element in new tree
+ *          depth = nesting depth for report lines
+ *
+ * Children are matched by element name and label, through a hash table
+ * of the old children, with children that share a key (such as the
+ * overloads of an operation) matched in order. A matched pair with the
+ * same hash is skipped without looking inside it.
+ */
+static void
+diffchildren(struct node *old, struct node *new, unsigned int depth)
+{
+    struct hashtable table = { 0 };
+    struct match *matches = 0, *match;
+    struct node *child;
+    size_t count = 0, i;
+    for (child = nextelement(old->children); child;
+            child = nextelement(child->next))
+    {
+        count++;
+    }
+    if (count)
+        matches = memalloc(count * sizeof(struct match));
+    /* Index the old children, each key's list in order. */
+    for (child = nextelement(old->children), i = 0; child;
+            child = nextelement(child->next), i++)
+    {
+        char *s = label(child);
+        struct match **plast;
+        match = matches + i;
+        match->node = child;
+        match->key = memprintf("%s %s",
+                atomname(((struct element *)child)->name), s);
+        memfree(s);
+        plast = (struct match **)hashput(&table, match->key,
+                strlen(match->key));
+        while (*plast)
+            plast = &(*plast)->next;
+        *plast = match;
+    }
+    /* Match each new child. */
+    for (child = nextelement(new->children); child;
+            child = nextelement(child->next))
+    {
+        char *s = label(child);
+        char *key = memprintf("%s %s",
+                atomname(((struct element *)child)->name), s);
+        memfree(s);
+        match = hashget(&table, key, strlen(key));
+        if (!match)
+            report(depth, '+', child);
+        else {
+            if (match->next)
+                *hashput(&table, key, strlen(key)) = match->next;
+            else
+                hashremove(&table, key, strlen(key));
+            diffelements(match->node, child, depth);
+            match->node = 0;
+        }
+        memfree(key);
+    }
+    /* Report the unmatched old children, in order. */
+    for (i = 0; i != count; i++) {
+        if (matches[i].node)
+            report(depth, '-', matches[i].node);
+        memfree(matches[i].key);
+    }
+    if (matches)
+        memfree(matches);
+    hashfree(&table);
+}
+
+/***********************************************************************
+ * diffelements : report the differences between two matched elements
+ *
+ * Enter:   old = element in old tree
+ *          new = element in new tree
+ *          depth = nesting depth for report lines
+ *
+ * Nothing is reported if the hashes are the same. A changed type is
+ * reported as its old and new Web IDL; anything else changed is
+ * reported as a line for the element then its changed attributes and
+ * children.
+ */
+static void
+diffelements(struct node *old, struct node *new, unsigned int depth)
+{
+    struct element *oldelement = (void *)old, *newelement = (void *)new;
+    if (oldelement->hash == newelement->hash)
+        return;
+    if (oldelement->name == NAME_Type
+            && oldelement->typeform != newelement->typeform)
+    {
+        printf("%*s~ Type %s -> %s\n", 2 * depth, "",
+                oldelement->typeform->key, newelement->typeform->key);
+        return;
+    }
+    report(depth, '~', new);
+    diffattrs(old, new, depth + 1);
+    diffchildren(old, new, depth + 1);
+}
+
+/***********************************************************************
+ * diffinputs : report the differences between two sets of Web IDL
+ *
+ * Enter:   oldname = old file, or directory of .widl files
+ *          newname = new file, or directory of .widl files
+ *
+ * Each side is parsed as a whole. The report lists the definitions
+ * added, removed and changed, and for each changed one, the members,
+ * types, extended attributes and attributes added, removed and
+ * changed, as lines starting '+', '-' and '~', indented by depth.
+ * Nothing is output if there are no differences.
+ */
+void
+diffinputs(const char *oldname, const char *newname)
+{
+    struct node *oldroot = parseside(oldname);
+    struct node *newroot = parseside(newname);
+    if (((struct element *)oldroot)->hash != ((struct element *)newroot)->hash) {
+        printf("--- %s\n+++ %s\n", oldname, newname);
+        diffchildren(oldroot, newroot, 0);
+    }
+    freenode(oldroot);
+    freenode(newroot);
+}
@@ -0,0 +1,374 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Exposure of interfaces and members in globals
+ ***********************************************************************/
+#include <string.h>
+#include "exposure.h"
+#include "hash.h"
+#include "misc.h"
+#include "node.h"
+
+/* Most globals that an exposure bitset can hold. */
+#define MAXGLOBALS 64
+
+/* struct globalname : a name used in [Exposed], with the globals that
+ * have it. Several globals can share a name, such as Worker. */
+struct globalname {
+    unsigned long long bits;
+};
+
+/* The global names, and the name of each global in bit order: the
+ * interface with [Global] or [PrimaryGlobal], or, for a global name used
+ * in [Exposed] that no interface in the input has, that name. */
+static struct hashtable names;
+static const char *globals[MAXGLOBALS];
+static unsigned int nglobals;
+
+/* The global name to keep only what is exposed in, set by
+ * setexposedglobal, or 0. */
+static const char *exposedglobal;
+
+/***********************************************************************
+ * setexposedglobal : set the global name that computeexposure keeps
+ *                    only what is exposed in
+ *
+ * Enter:   name = global name
+ */
+void
+setexposedglobal(const char *name)
+{
+    exposedglobal = name;
+}
+
+/***********************************************************************
+ * newglobal : give a global the next bit
+ *
+ * Enter:   name = name of global, which must last as long as the tree
+ *
+ * Return:  exposure bitset with just that global's bit set
+ */
+static unsigned long long
+newglobal(const char *name)
+{
+    if (nglobals == MAXGLOBALS)
+        errorexit("more than %u globals", MAXGLOBALS);
+    globals[nglobals] = name;
+    return 1ULL << nglobals++;
+}
+
+/***********************************************************************
+ * addname : add globals to those that have a global name
+ *
+ * Enter:   name = global name, which must last as long as the tree
+ *          bits = exposure bitset of the globals
+ */
+static void
+addname(const char *name, unsigned long long bits)
+{
+    struct globalname **pname = (struct globalname **)hashput(&names, name,
+            strlen(name));
+    if (!*pname)
+        *pname = memalloc(sizeof(struct globalname));
+    (*pname)->bits |= bits;
+}
+
+/***********************************************************************
+ * namebits : get the globals that have a global name
+ *
+ * Enter:   name = global name, which must last as long as the tree
+ *
+ * Return:  exposure bitset
+ *
+ * A name that no global has yet is taken to be a global from another
+ * specification, and given a bit of its own.
+ */
+static unsigned long long
+namebits(const char *name)
+{
+    struct globalname *globalname = hashget(&names, name, strlen(name));
+    unsigned long long bits;
+    if (globalname)
+        return globalname->bits;
+    bits = newglobal(name);
+    addname(name, bits);
+    return bits;
+}
+
+/***********************************************************************
+ * namelistbits : get the globals named by [Exposed]
+ *
+ * Enter:   attr = ExtendedAttribute element
+ *
+ * Return:  exposure bitset of the globals with the names it gives
+ */
+static unsigned long long
+namelistbits(struct node *attr)
+{
+    unsigned long long bits = 0;
+    struct node *list = nextelement(attr->children), *name;
+    if (!list)
+        return 0;
+    for (name = nextelement(list->children); name;
+            name = nextelement(name->next))
+    {
+        bits |= namebits(getattr(name, NAME_name));
+    }
+    return bits;
+}
+
+/***********************************************************************
+ * exposurebits : get the exposure of a definition or member
+ *
+ * Enter:   node = interface, partial interface or member element
+ *          outer = exposure of what it is in, or the default exposure,
+ *                  used if it has no [Exposed]
+ *          limit = non-zero to limit what it gives in [Exposed] to outer,
+ *                  as for a member or partial interface, which cannot be
+ *                  exposed where its interface is not
+ *
+ * Return:  exposure bitset
+ */
+static unsigned long long
+exposurebits(struct node *node, unsigned long long outer, int limit)
+{
+    struct node *attr = getextattr(node, EXTATTR_Exposed);
+    unsigned long long bits;
+    if (!attr)
+        return outer;
+    bits = namelistbits(attr);
+    return limit ? bits & outer : bits;
+}
+
+/***********************************************************************
+ * exposurenames : make the text of an exposure bitset
+ *
+ * Enter:   bits = exposure bitset
+ *
+ * Return:  allocated space separated names of the globals, in bit order
+ */
+static char *
+exposurenames(unsigned long long bits)
+{
+    size_t len = 0;
+    unsigned int i;
+    char *s, *p;
+    for (i = 0; i != nglobals; i++) {
+        if (bits & 1ULL << i)
+            len += strlen(globals[i]) + 1;
+    }
+    p = s = memalloc(len + 1);
+    for (i = 0; i != nglobals; i++) {
+        if (bits & 1ULL << i) {
+            if (p != s)
+                *p++ = ' ';
+            strcpy(p, globals[i]);
+            p += strlen(p);
+        }
+    }
+    return s;
+}
+
+/***********************************************************************
+ * setexposure : record the exposure of an element
+ *
+ * Enter:   node = interface or member element
+ *          bits = exposure bitset
+ */
+static void
+setexposure(struct node *node, unsigned long long bits)
+{
+    ((struct element *)node)->exposure = bits;
+    addnode(node, newallocattr(NAME_exposure, exposurenames(bits)));
+}
+
+/***********************************************************************
+ * isexposable : test whether a definition has an exposure
+ *
+ * Callback interfaces are left out, as they are used only as types.
+ */
+static int
+isexposable(struct node *node)
+{
+    return ((struct element *)node)->name == NAME_Interface
+            && !getattr(node, NAME_callback);
+}
+
+/***********************************************************************
+ * ismember : test whether a child element of an interface is a member
+ */
+static int
+ismember(struct node *node)
+{
+    switch (((struct element *)node)->name) {
+    case NAME_Const:
+    case NAME_Attribute:
+    case NAME_Operation:
+    case NAME_Stringifier:
+    case NAME_Serializer:
+    case NAME_Iterable:
+    case NAME_MapLike:
+        return 1;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * removeunexposed : remove the children of a node not exposed in any
+ *                   of some globals
+ *
+ * Enter:   parent = Definitions or Interface element
+ *          bits = exposure bitset of the globals
+ *          test = function to test whether a child has an exposure
+ */
+static void
+removeunexposed(struct node *parent, unsigned long long bits,
+                int (*test)(struct node *))
+{
+    struct node **pchild = &parent->children, *child, *last = 0;
+    while ((child = *pchild)) {
+        if (child->type == NODE_ELEMENT && test(child)
+                && !(((struct element *)child)->exposure & bits))
+        {
+            *pchild = child->next;
+            freenode(child);
+            continue;
+        }
+        last = child;
+        pchild = &child->next;
+    }
+    parent->lastchild = last;
+}
+
+/***********************************************************************
+ * addglobal : give a global interface its bit and its names
+ *
+ * Enter:   node = interface element
+ *          attr = its [Global] or [PrimaryGlobal] ExtendedAttribute
+ *
+ * Return:  exposure bitset of the global
+ *
+ * Its names are those given to [Global] or [PrimaryGlobal], or its own
+ * name if none are given. Its own name is added anyway, so that it can
+ * be asked for by name.
+ */
+static unsigned long long
+addglobal(struct node *node, struct node *attr)
+{
+    const char *name = getattr(node, NAME_name);
+    unsigned long long bit = newglobal(name);
+    struct node *list = nextelement(attr->children), *child;
+    addname(name, bit);
+    if (list) {
+        for (child = nextelement(list->children); child;
+                child = nextelement(child->next))
+        {
+            addname(getattr(child, NAME_name), bit);
+        }
+    }
+    return bit;
+}
+
+/***********************************************************************
+ * computeexposure : work out where each interface and member is exposed
+ *
+ * Enter:   root = root of parse tree
+ *
+ * Each interface with [Global] or [PrimaryGlobal] is a global, and is
+ * given a bit, so where something is exposed is a bitset of globals.
+ * Each interface and member gets that bitset, and an exposure attribute
+ * naming the globals. An interface with no [Exposed] is exposed in the
+ * primary global (that with [PrimaryGlobal], or Window if there is
+ * none); a partial interface with no [Exposed] is exposed where its
+ * interface is; and a member with no [Exposed] is exposed where the
+ * interface or partial interface it is in is. If setexposedglobal was
+ * called, then the interfaces and members not exposed in any global
+ * with that name are removed, which is a bit test on each.
+ */
+void
+computeexposure(struct node *root)
+{
+    struct hashtable interfaces = { 0, 0, 0 };
+    unsigned long long primary = 0;
+    struct node *node, *child;
+    unsigned int i;
+    /* Give the globals their bits first, in document order. */
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        struct node *attr;
+        if (!isexposable(node))
+            continue;
+        if ((attr = getextattr(node, EXTATTR_Global)))
+            addglobal(node, attr);
+        else if ((attr = getextattr(node, EXTATTR_PrimaryGlobal)))
+            primary |= addglobal(node, attr);
+    }
+    if (!primary)
+        primary = namebits("Window");
+    /* Work out each interface, then its partial interfaces and members,
+     * which need it. */
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *name;
+        void **pvalue;
+        if (!isexposable(node) || getattr(node, NAME_partial))
+            continue;
+        setexposure(node, exposurebits(node, primary, 0));
+        name = getattr(node, NAME_name);
+        pvalue = hashput(&interfaces, name, strlen(name));
+        if (!*pvalue)
+            *pvalue = node;
+    }
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        unsigned long long bits;
+        if (!isexposable(node))
+            continue;
+        if (getattr(node, NAME_partial)) {
+            const char *name = getattr(node, NAME_name);
+            struct node *target = hashget(&interfaces, name, strlen(name));
+            bits = target ? ((struct element *)target)->exposure : primary;
+            setexposure(node, exposurebits(node, bits, 1));
+        }
+        bits = ((struct element *)node)->exposure;
+        for (child = nextelement(node->children); child;
+                child = nextelement(child->next))
+        {
+            if (ismember(child))
+                setexposure(child, exposurebits(child, bits, 1));
+        }
+    }
+    hashfree(&interfaces);
+    if (exposedglobal) {
+        struct globalname *globalname = hashget(&names, exposedglobal,
+                strlen(exposedglobal));
+        if (!globalname)
+            errorexit("no global %s in the input", exposedglobal);
+        removeunexposed(root, globalname->bits, isexposable);
+        for (node = nextelement(root->children); node;
+                node = nextelement(node->next))
+        {
+            if (isexposable(node))
+                removeunexposed(node, globalname->bits, ismember);
+        }
+    }
+    for (i = 0; i != names.max; i++) {
+        if (names.entries[i].key)
+            memfree(names.entries[i].value);
+    }
+    hashfree(&names);
+    nglobals = 0;
+}
@@ -0,0 +1,182 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * String keyed hash table (open addressing, linear probing)
+ ***********************************************************************/
+#include <string.h>
+#include "hash.h"
+#include "misc.h"
+
+/***********************************************************************
+ * hashstring : hash a string (FNV-1a)
+ *
+ * Enter:   s = string
+ *          len = length of string
+ *
+ * Return:  hash value
+ */
+unsigned int
+hashstring(const char *s, size_t len)
+{
+    unsigned int hash = 2166136261U;
+    while (len--) {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/***********************************************************************
+ * findentry : find the entry for a key, or the unused entry where it
+ *             would go
+ *
+ * Enter:   table = hash table, with at least one unused entry
+ *          key, len = key and its length
+ *          hash = hash value of key
+ *
+ * Return:  entry
+ */
+static struct hashentry *
+findentry(const struct hashtable *table, const char *key, size_t len,
+          unsigned int hash)
+{
+    unsigned int i = hash & (table->max - 1);
+    for (;;) {
+        struct hashentry *entry = table->entries + i;
+        if (!entry->key)
+            return entry;
+        if (entry->hash == hash && entry->len == len
+                && !memcmp(entry->key, key, len))
+        {
+            return entry;
+        }
+        i = (i + 1) & (table->max - 1);
+    }
+}
+
+/***********************************************************************
+ * hashget : look up a key
+ *
+ * Enter:   table = hash table
+ *          key, len = key and its length
+ *
+ * Return:  0 if not found, else value stored for the key
+ */
+void *
+hashget(const struct hashtable *table, const char *key, size_t len)
+{
+    if (!table->count)
+        return 0;
+    return findentry(table, key, len, hashstring(key, len))->value;
+}
+
+/***********************************************************************
+ * hashput : find or add a key
+ *
+ * Enter:   table = hash table
+ *          key, len = key and its length
+ *
+ * Return:  pointer to the value stored for the key, which is 0 if the
+ *          key has just been added
+ *
+ * The returned pointer is valid only until the next call to hashput.
+ */
+void **
+hashput(struct hashtable *table, const char *key, size_t len)
+{
+    unsigned int hash = hashstring(key, len);
+    struct hashentry *entry;
+    if (4 * (table->count + 1) > 3 * table->max) {
+        /* Grow the table, keeping it no more than 3/4 full. */
+        struct hashtable newtable;
+        unsigned int i;
+        newtable.count = table->count;
+        newtable.max = table->max ? 2 * table->max : 16;
+        newtable.entries = memalloc(newtable.max * sizeof(struct hashentry));
+        for (i = 0; i != table->max; i++) {
+            struct hashentry *old = table->entries + i;
+            if (old->key)
+                *findentry(&newtable, old->key, old->len, old->hash) = *old;
+        }
+        if (table->entries)
+            memfree(table->entries);
+        *table = newtable;
+    }
+    entry = findentry(table, key, len, hash);
+    if (!entry->key) {
+        entry->key = key;
+        entry->len = len;
+        entry->hash = hash;
+        table->count++;
+    }
+    return &entry->value;
+}
+
+/***********************************************************************
+ * hashremove : remove a key
+ *
+ * Enter:   table = hash table
+ *          key, len = key and its length
+ *
+ * Return:  0 if not found, else value that was stored for the key
+ *
+ * Entries after the removed one in its probe sequence are shifted back,
+ * so no deleted marker is needed and lookups stay as short as if the
+ * key had never been added.
+ */
+void *
+hashremove(struct hashtable *table, const char *key, size_t len)
+{
+    unsigned int mask = table->max - 1, i, j;
+    struct hashentry *entry;
+    void *value;
+    if (!table->count)
+        return 0;
+    entry = findentry(table, key, len, hashstring(key, len));
+    if (!entry->key)
+        return 0;
+    value = entry->value;
+    i = j = entry - table->entries;
+    for (;;) {
+        unsigned int home;
+        j = (j + 1) & mask;
+        if (!table->entries[j].key)
+            break;
+        /* The entry at j can fill the hole at i unless its home slot
+         * lies cyclically in (i, j]. */
+        home = table->entries[j].hash & mask;
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            table->entries[i] = table->entries[j];
+            i = j;
+        }
+    }
+    table->entries[i].key = 0;
+    table->entries[i].value = 0;
+    table->count--;
+    return value;
+}
+
+/***********************************************************************
+ * hashfree : free the memory used by a hash table, leaving it empty
+ *
+ * Enter:   table = hash table
+ */
+void
+hashfree(struct hashtable *table)
+{
+    if (table->entries)
+        memfree(table->entries);
+    table->count = table->max = 0;
+    table->entries = 0;
+}
+
@@ -0,0 +1,43 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***********************************************************************/
+#ifndef hash_h
+#define hash_h
+#include <stddef.h>
+
+/* struct hashtable : hash table mapping strings to pointers
+ *
+ * A zero-initialised struct hashtable is an empty table. Keys are not
+ * copied, so they must live at least as long as the table. An entry
+ * with a 0 key is unused. */
+struct hashentry {
+    const char *key;
+    size_t len;
+    unsigned int hash;
+    void *value;
+};
+
+struct hashtable {
+    unsigned int count;
+    unsigned int max; /* number of entries, 0 or a power of 2 */
+    struct hashentry *entries;
+};
+
+unsigned int hashstring(const char *s, size_t len);
+void *hashget(const struct hashtable *table, const char *key, size_t len);
+void **hashput(struct hashtable *table, const char *key, size_t len);
+void *hashremove(struct hashtable *table, const char *key, size_t len);
+void hashfree(struct hashtable *table);
+
+#endif /* ndef hash_h */
+
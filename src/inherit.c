@@ -0,0 +1,316 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Flattening of inherited and implemented members
+ ***********************************************************************/
+#include <string.h>
+#include "hash.h"
+#include "inherit.h"
+#include "misc.h"
+#include "node.h"
+
+/* struct flat : an interface or dictionary being flattened
+ *
+ * The contributors of a definition are the definitions whose members it
+ * has, in order: those of each definition it inherits from, then
+ * itself, then those of each interface it implements, each appearing
+ * only once. They are worked out once for each definition, and reused
+ * by each definition that inherits from or implements it. */
+struct flat {
+    const char *name;
+    int kind; /* NAME_Interface or NAME_Dictionary */
+    struct node *primary; /* the definition that is not partial, or 0 */
+    /* The definition and any partial definitions, in document order. */
+    struct node **nodes;
+    unsigned int nnodes, maxnodes;
+    /* The interfaces that this one implements, in document order. */
+    struct flat **mixins;
+    unsigned int nmixins, maxmixins;
+    /* The contributors, set by flatten. */
+    struct flat **contributors;
+    unsigned int ncontributors;
+    int state; /* 0 not started, 1 being flattened, 2 done */
+    unsigned int stamp; /* used by flatten to spot duplicates */
+};
+
+static struct hashtable flats;
+static unsigned int stamp;
+
+/***********************************************************************
+ * kindname : get the Web IDL keyword for an interface or dictionary
+ */
+static const char *
+kindname(int kind)
+{
+    return kind == NAME_Dictionary ? "dictionary" : "interface";
+}
+
+/***********************************************************************
+ * findflat : find the flat struct for a name used in a definition
+ *
+ * Enter:   name = name of definition
+ *          kind = NAME_Interface or NAME_Dictionary
+ *
+ * Return:  flat struct, 0 if there is no definition of that name and
+ *          kind
+ */
+static struct flat *
+findflat(const char *name, int kind)
+{
+    struct flat *flat = hashget(&flats, name, strlen(name));
+    return flat && flat->kind == kind ? flat : 0;
+}
+
+/***********************************************************************
+ * addcontributors : append a definition's contributors to a list
+ *
+ * Enter:   list = list being built, with room for them
+ *          pcount = where the length of the list is kept
+ *          flat = definition whose contributors to add
+ *
+ * Those already in the list, marked with the current stamp, are
+ * skipped.
+ */
+static void
+addcontributors(struct flat **list, unsigned int *pcount,
+                const struct flat *flat)
+{
+    unsigned int i;
+    for (i = 0; i != flat->ncontributors; i++) {
+        struct flat *contributor = flat->contributors[i];
+        if (contributor->stamp != stamp) {
+            contributor->stamp = stamp;
+            list[(*pcount)++] = contributor;
+        }
+    }
+}
+
+/***********************************************************************
+ * flatten : work out the contributors of a definition
+ *
+ * Enter:   flat = definition
+ *
+ * This recurses to the definitions it inherits from and implements
+ * first, so each definition is flattened once however many others
+ * share it. Meeting a definition that is still being flattened means
+ * that it inherits from or implements itself.
+ */
+static void
+flatten(struct flat *flat)
+{
+    struct flat **parents = 0;
+    unsigned int nparents = 0, max = 1, i;
+    if (flat->state == 2)
+        return;
+    if (flat->state == 1) {
+        nodeerrorexit(flat->primary ? flat->primary : flat->nodes[0],
+                "%s %s inherits from or implements itself",
+                kindname(flat->kind), flat->name);
+    }
+    flat->state = 1;
+    /* Find and flatten what it inherits from. */
+    for (i = 0; i != flat->nnodes; i++) {
+        struct node *child;
+        for (child = nextelement(flat->nodes[i]->children); child;
+                child = nextelement(child->next))
+        {
+            int name = ((struct element *)child)->name;
+            struct node *child2;
+            if (name != NAME_InterfaceInheritance
+                    && name != NAME_DictionaryInheritance)
+            {
+                continue;
+            }
+            for (child2 = nextelement(child->children); child2;
+                    child2 = nextelement(child2->next))
+            {
+                struct flat *parent = findflat(getattr(child2, NAME_name),
+                        flat->kind);
+                if (!parent)
+                    continue;
+                flatten(parent);
+                parents = memrealloc(parents,
+                        (nparents + 1) * sizeof(struct flat *));
+                parents[nparents++] = parent;
+                max += parent->ncontributors;
+            }
+        }
+    }
+    for (i = 0; i != flat->nmixins; i++) {
+        flatten(flat->mixins[i]);
+        max += flat->mixins[i]->ncontributors;
+    }
+    /* Put the contributors together. */
+    flat->contributors = memalloc(max * sizeof(struct flat *));
+    stamp++;
+    for (i = 0; i != nparents; i++)
+        addcontributors(flat->contributors, &flat->ncontributors, parents[i]);
+    if (flat->stamp != stamp) {
+        flat->stamp = stamp;
+        flat->contributors[flat->ncontributors++] = flat;
+    }
+    for (i = 0; i != flat->nmixins; i++) {
+        addcontributors(flat->contributors, &flat->ncontributors,
+                flat->mixins[i]);
+    }
+    if (parents)
+        memfree(parents);
+    flat->state = 2;
+}
+
+/***********************************************************************
+ * ismember : test whether a child element of a definition is a member
+ */
+static int
+ismember(struct node *node)
+{
+    switch (((struct element *)node)->name) {
+    case NAME_ExtendedAttributeList:
+    case NAME_InterfaceInheritance:
+    case NAME_DictionaryInheritance:
+    case NAME_FlattenedMembers:
+        return 0;
+    }
+    return 1;
+}
+
+/***********************************************************************
+ * flattenedmembers : make the FlattenedMembers element for a definition
+ *
+ * Enter:   flat = definition, already flattened
+ *
+ * Return:  new FlattenedMembers element
+ *
+ * It has a Member element for each member of each contributor, in the
+ * order of the contributors and then of the members within each. Its
+ * attributes point at the names in the tree rather than copying them.
+ */
+static struct node *
+flattenedmembers(const struct flat *flat)
+{
+    struct node *node = newelement(NAME_FlattenedMembers);
+    unsigned int i, j;
+    for (i = 0; i != flat->ncontributors; i++) {
+        const struct flat *contributor = flat->contributors[i];
+        for (j = 0; j != contributor->nnodes; j++) {
+            struct node *child;
+            for (child = nextelement(contributor->nodes[j]->children); child;
+                    child = nextelement(child->next))
+            {
+                struct node *member;
+                const char *name;
+                if (!ismember(child))
+                    continue;
+                member = newelement(NAME_Member);
+                addnode(member, newattr(NAME_definition, contributor->name));
+                addnode(member, newattr(NAME_kind,
+                        atomname(((struct element *)child)->name)));
+                name = getattr(child, NAME_name);
+                if (name)
+                    addnode(member, newattr(NAME_name, name));
+                addnode(node, member);
+            }
+        }
+    }
+    return node;
+}
+
+/***********************************************************************
+ * flattendefinitions : add the flattened member list of each interface
+ *                      and dictionary
+ *
+ * Enter:   root = root of parse tree
+ *
+ * Each interface and dictionary gets a FlattenedMembers element listing
+ * all its members, including those it inherits and, for an interface,
+ * those of the interfaces it implements. An interface or dictionary
+ * that is not in the input, such as one from another specification,
+ * adds no members. Inheriting from or implementing itself is an error.
+ */
+void
+flattendefinitions(struct node *root)
+{
+    struct flat **list = 0;
+    unsigned int count = 0, max = 0, i;
+    struct node *node;
+    /* Index the definitions, with their partial definitions. */
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        int kind = ((struct element *)node)->name;
+        const char *name;
+        struct flat **pflat;
+        if (kind != NAME_Interface && kind != NAME_Dictionary)
+            continue;
+        name = getattr(node, NAME_name);
+        pflat = (struct flat **)hashput(&flats, name, strlen(name));
+        if (!*pflat) {
+            *pflat = memalloc(sizeof(struct flat));
+            (*pflat)->name = name;
+            (*pflat)->kind = kind;
+            if (count == max) {
+                max = max ? 2 * max : 64;
+                list = memrealloc(list, max * sizeof(struct flat *));
+            }
+            list[count++] = *pflat;
+        } else if ((*pflat)->kind != kind) {
+            nodeerrorexit(node, "%s %s has the same name as %s %s",
+                    kindname(kind), name, kindname((*pflat)->kind), name);
+        }
+        if ((*pflat)->nnodes == (*pflat)->maxnodes) {
+            (*pflat)->maxnodes = (*pflat)->maxnodes
+                    ? 2 * (*pflat)->maxnodes : 4;
+            (*pflat)->nodes = memrealloc((*pflat)->nodes,
+                    (*pflat)->maxnodes * sizeof(struct node *));
+        }
+        (*pflat)->nodes[(*pflat)->nnodes++] = node;
+        if (!getattr(node, NAME_partial) && !(*pflat)->primary)
+            (*pflat)->primary = node;
+    }
+    /* Record what each interface implements. */
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        struct flat *flat, *mixin;
+        if (((struct element *)node)->name != NAME_Implements)
+            continue;
+        flat = findflat(getattr(node, NAME_name1), NAME_Interface);
+        mixin = findflat(getattr(node, NAME_name2), NAME_Interface);
+        if (!flat || !mixin)
+            continue;
+        if (flat->nmixins == flat->maxmixins) {
+            flat->maxmixins = flat->maxmixins ? 2 * flat->maxmixins : 4;
+            flat->mixins = memrealloc(flat->mixins,
+                    flat->maxmixins * sizeof(struct flat *));
+        }
+        flat->mixins[flat->nmixins++] = mixin;
+    }
+    /* Flatten each one, and add its FlattenedMembers element. */
+    for (i = 0; i != count; i++)
+        flatten(list[i]);
+    for (i = 0; i != count; i++) {
+        if (list[i]->primary)
+            addnode(list[i]->primary, flattenedmembers(list[i]));
+    }
+    for (i = 0; i != count; i++) {
+        struct flat *flat = list[i];
+        memfree(flat->nodes);
+        if (flat->mixins)
+            memfree(flat->mixins);
+        memfree(flat->contributors);
+        memfree(flat);
+    }
+    if (list)
+        memfree(list);
+    hashfree(&flats);
+}
@@ -0,0 +1,402 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * JSON parsing and string escaping
+ ***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "misc.h"
+
+/* Deepest nesting of arrays and objects that parsejson accepts. */
+#define MAXDEPTH 256
+
+/* The text being parsed, and whether a syntax error has been found. */
+static const char *jsonpos, *jsonend;
+static int jsonerror;
+
+static struct json *parsevalue(unsigned int depth);
+
+/***********************************************************************
+ * skipspace : skip JSON whitespace
+ *
+ * Return:  next character, or 0 at the end of the text
+ */
+static int
+skipspace(void)
+{
+    while (jsonpos != jsonend && (*jsonpos == ' ' || *jsonpos == '\t'
+            || *jsonpos == '\r' || *jsonpos == '\n'))
+    {
+        jsonpos++;
+    }
+    return jsonpos != jsonend ? *jsonpos : 0;
+}
+
+/***********************************************************************
+ * hex4 : parse the four hex digits of a \u escape
+ *
+ * Return:  value, or -1 if not four hex digits
+ */
+static long
+hex4(void)
+{
+    long value = 0;
+    int i;
+    if (jsonend - jsonpos < 4)
+        return -1;
+    for (i = 0; i != 4; i++) {
+        int ch = *jsonpos++;
+        value <<= 4;
+        if ((unsigned)(ch - '0') < 10)
+            value |= ch - '0';
+        else if ((unsigned)((ch | 0x20) - 'a') < 6)
+            value |= (ch | 0x20) - 'a' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+/***********************************************************************
+ * parsestring : parse a JSON string
+ *
+ * Enter:   jsonpos points at the opening quote
+ *          plen = where to store the length of the unescaped text
+ *
+ * Return:  allocated unescaped text with a 0 after it, 0 if error
+ *
+ * The unescaped text is never longer than the escaped text, so it is
+ * built in a buffer of that size, found by scanning for the closing
+ * quote first.
+ */
+static char *
+parsestring(size_t *plen)
+{
+    const char *start = ++jsonpos;
+    char *buf, *q;
+    while (jsonpos != jsonend && *jsonpos != '"') {
+        if (*jsonpos == '\\' && jsonpos + 1 != jsonend)
+            jsonpos++;
+        jsonpos++;
+    }
+    if (jsonpos == jsonend)
+        return 0;
+    q = buf = memalloc(jsonpos - start + 1);
+    jsonpos = start;
+    while (*jsonpos != '"') {
+        unsigned long ch = (unsigned char)*jsonpos++;
+        if (ch < 0x20)
+            goto error;
+        if (ch != '\\') {
+            *q++ = ch;
+            continue;
+        }
+        switch (ch = *jsonpos++) {
+        case '"': case '\\': case '/':
+            break;
+        case 'b': ch = '\b'; break;
+        case 'f': ch = '\f'; break;
+        case 'n': ch = '\n'; break;
+        case 'r': ch = '\r'; break;
+        case 't': ch = '\t'; break;
+        case 'u':
+            {
+                long value = hex4();
+                if (value < 0)
+                    goto error;
+                ch = value;
+                /* Join a surrogate pair. */
+                if (ch >= 0xd800 && ch < 0xdc00 && jsonend - jsonpos >= 6
+                        && jsonpos[0] == '\\' && jsonpos[1] == 'u')
+                {
+                    const char *save = jsonpos;
+                    jsonpos += 2;
+                    value = hex4();
+                    if (value >= 0xdc00 && value < 0xe000)
+                        ch = 0x10000 + ((ch - 0xd800) << 10) + (value - 0xdc00);
+                    else
+                        jsonpos = save;
+                }
+            }
+            /* Encode as UTF-8. */
+            if (ch >= 0x80) {
+                if (ch < 0x800)
+                    *q++ = 0xc0 | ch >> 6;
+                else {
+                    if (ch < 0x10000)
+                        *q++ = 0xe0 | ch >> 12;
+                    else {
+                        *q++ = 0xf0 | ch >> 18;
+                        *q++ = 0x80 | (ch >> 12 & 0x3f);
+                    }
+                    *q++ = 0x80 | (ch >> 6 & 0x3f);
+                }
+                ch = 0x80 | (ch & 0x3f);
+            }
+            break;
+        default:
+            goto error;
+        }
+        *q++ = ch;
+    }
+    jsonpos++;
+    *q = 0;
+    *plen = q - buf;
+    return buf;
+error:
+    memfree(buf);
+    return 0;
+}
+
+/***********************************************************************
+ * parsechildren : parse the members of an object or elements of an array
+ *
+ * Enter:   json = object or array, with jsonpos just past its '{' or '['
+ *          depth = nesting depth of json
+ */
+static void
+parsechildren(struct json *json, unsigned int depth)
+{
+    int close = json->type == JSON_OBJECT ? '}' : ']';
+    struct json **plast = &json->children;
+    if (skipspace() == close) {
+        jsonpos++;
+        return;
+    }
+    for (;;) {
+        char *key = 0;
+        size_t len;
+        struct json *child;
+        if (json->type == JSON_OBJECT) {
+            if (skipspace() != '"' || !(key = parsestring(&len)))
+                break;
+            if (skipspace() != ':') {
+                memfree(key);
+                break;
+            }
+            jsonpos++;
+        }
+        child = parsevalue(depth + 1);
+        if (!child) {
+            if (key)
+                memfree(key);
+            break;
+        }
+        child->key = key;
+        *plast = child;
+        plast = &child->next;
+        if (skipspace() == ',') {
+            jsonpos++;
+            continue;
+        }
+        if (skipspace() == close) {
+            jsonpos++;
+            return;
+        }
+        break;
+    }
+    jsonerror = 1;
+}
+
+/***********************************************************************
+ * parsevalue : parse a JSON value
+ *
+ * Enter:   depth = nesting depth of the value
+ *
+ * Return:  new json struct, 0 if error
+ */
+static struct json *
+parsevalue(unsigned int depth)
+{
+    struct json *json;
+    int ch = skipspace();
+    if (depth > MAXDEPTH)
+        return 0;
+    json = memalloc(sizeof(struct json));
+    switch (ch) {
+    case '{':
+    case '[':
+        jsonpos++;
+        json->type = ch == '{' ? JSON_OBJECT : JSON_ARRAY;
+        parsechildren(json, depth);
+        if (jsonerror) {
+            freejson(json);
+            return 0;
+        }
+        return json;
+    case '"':
+        json->type = JSON_STRING;
+        json->string = parsestring(&json->len);
+        if (json->string)
+            return json;
+        break;
+    case 't':
+    case 'f':
+    case 'n':
+        {
+            static const char *const words[] = { "null", "false", "true" };
+            int type;
+            for (type = JSON_NULL; type <= JSON_TRUE; type++) {
+                size_t len = strlen(words[type]);
+                if ((size_t)(jsonend - jsonpos) >= len
+                        && !memcmp(jsonpos, words[type], len))
+                {
+                    jsonpos += len;
+                    json->type = type;
+                    return json;
+                }
+            }
+        }
+        break;
+    default:
+        if (ch == '-' || (unsigned)(ch - '0') < 10) {
+            /* strtod needs a terminated string; a number is short, so
+             * copy it into a buffer. */
+            char buf[64];
+            size_t len = 0;
+            char *numend;
+            while (jsonpos + len != jsonend && len != sizeof(buf) - 1
+                    && strchr("+-.0123456789eE", jsonpos[len]))
+            {
+                len++;
+            }
+            memcpy(buf, jsonpos, len);
+            buf[len] = 0;
+            json->type = JSON_NUMBER;
+            json->number = strtod(buf, &numend);
+            if (numend == buf + len) {
+                jsonpos += len;
+                return json;
+            }
+        }
+        break;
+    }
+    memfree(json);
+    return 0;
+}
+
+/***********************************************************************
+ * parsejson : parse JSON text
+ *
+ * Enter:   s = text
+ *          len = length of text
+ *
+ * Return:  new json struct, 0 if the text is not valid JSON
+ */
+struct json *
+parsejson(const char *s, size_t len)
+{
+    struct json *json;
+    jsonpos = s;
+    jsonend = s + len;
+    jsonerror = 0;
+    json = parsevalue(0);
+    if (json && skipspace()) {
+        freejson(json);
+        json = 0;
+    }
+    return json;
+}
+
+/***********************************************************************
+ * freejson : free a json struct and everything in it
+ *
+ * Enter:   json = json struct, or 0
+ */
+void
+freejson(struct json *json)
+{
+    while (json) {
+        struct json *next = json->next;
+        freejson(json->children);
+        if (json->key)
+            memfree(json->key);
+        if (json->string)
+            memfree(json->string);
+        memfree(json);
+        json = next;
+    }
+}
+
+/***********************************************************************
+ * jsonmember : find a member of a JSON object
+ *
+ * Enter:   json = json struct, or 0
+ *          key = member name
+ *
+ * Return:  member's value, 0 if json is not an object or has no such
+ *          member
+ */
+struct json *
+jsonmember(const struct json *json, const char *key)
+{
+    struct json *child;
+    if (!json || json->type != JSON_OBJECT)
+        return 0;
+    for (child = json->children; child; child = child->next) {
+        if (!strcmp(child->key, key))
+            return child;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * memjsonstring : make a quoted and escaped JSON string
+ *
+ * Enter:   s = text
+ *          len = length of text
+ *
+ * Return:  allocated JSON string, with a 0 after it
+ */
+char *
+memjsonstring(const char *s, size_t len)
+{
+    /* Each byte takes at most 6 bytes escaped. */
+    char *buf = memalloc(6 * len + 3), *q = buf;
+    const char *end = s + len;
+    *q++ = '"';
+    while (s != end) {
+        int ch = (unsigned char)*s++;
+        switch (ch) {
+        case '"':
+        case '\\':
+            *q++ = '\\';
+            *q++ = ch;
+            break;
+        case '\n':
+            *q++ = '\\';
+            *q++ = 'n';
+            break;
+        case '\r':
+            *q++ = '\\';
+            *q++ = 'r';
+            break;
+        case '\t':
+            *q++ = '\\';
+            *q++ = 't';
+            break;
+        default:
+            if (ch < 0x20) {
+                sprintf(q, "\\u%04x", ch);
+                q += 6;
+            } else
+                *q++ = ch;
+            break;
+        }
+    }
+    *q++ = '"';
+    *q = 0;
+    return memrealloc(buf, q - buf + 1);
+}
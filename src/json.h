@@ -0,0 +1,39 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***********************************************************************/
+#ifndef json_h
+#define json_h
+#include <stddef.h>
+
+/* struct json : a parsed JSON value
+ *
+ * The members of an object and the elements of an array are the
+ * children list, in order. */
+enum { JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING,
+       JSON_ARRAY, JSON_OBJECT };
+struct json {
+    int type;
+    struct json *next; /* next in the parent's children list */
+    char *key; /* member name, if in an object */
+    char *string; /* JSON_STRING text, unescaped, with a 0 after it */
+    size_t len; /* length of string */
+    double number; /* JSON_NUMBER value */
+    struct json *children;
+};
+
+struct json *parsejson(const char *s, size_t len);
+void freejson(struct json *json);
+struct json *jsonmember(const struct json *json, const char *key);
+char *memjsonstring(const char *s, size_t len);
+
+#endif /* ndef json_h */
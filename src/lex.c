@@ -14,24 +14,139 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "lex.h"
 #include "misc.h"
 #include "node.h"
 #include "process.h"
 
+/* struct span : a range of source text */
+struct span {
+    const char *start, *end;
+};
+
+/* struct run : a piece of source text, containing no newline except
+ * at its end, put in the source built by buildsource, and the
+ * character offset in that source where it starts */
+struct run {
+    const char *start, *end;
+    size_t offset;
+};
+
 struct file {
     struct file *next;
     const char *filename;
     char *buf;
     const char *pos, *end;
-    unsigned int linenum;
+    size_t linenum;
+    size_t startlinenum; /* line number of the start of buf */
+    size_t offset; /* source offset of buf, as returned by srcoffset */
+    /* Spans of the comments in the file, in order, recorded as they are
+     * lexed. An inline comment's span excludes its newline. */
+    struct span *comments;
+    size_t ncomments, maxcomments;
+    /* Escaped source text of the file built by buildsource, and its
+     * runs in order. sourceend is the character offset just past the
+     * file's text. */
+    char *source;
+    size_t sourcelen, sourcemax, sourceend;
+    struct run *runs;
+    size_t nruns, maxruns;
 };
 
 const char keywords[] = KEYWORDS;
 
 static struct file *file, *firstfile;
+/* If set by lexinput, the only file to lex. */
+static struct file *lastfile;
+/* The files in order of buffer address, for findfile. */
+static struct file **files;
+static unsigned int nfiles;
 static struct tok tok;
+/* Set when lexing reaches the end of the input, or an unterminated
+ * comment or string runs into it. */
+static int reachedend;
+/* Non-zero once buildsource has been called, and the number of
+ * characters in the source built so far. */
+static int sourcebuilt;
+static size_t sourcechars;
+
+/***********************************************************************
+ * comparefiles : compare two files by buffer address, for qsort
+ */
+static int
+comparefiles(const void *a, const void *b)
+{
+    const struct file *file1 = *(struct file *const *)a;
+    const struct file *file2 = *(struct file *const *)b;
+    if (file1->buf < file2->buf)
+        return -1;
+    return file1->buf > file2->buf;
+}
+
+/***********************************************************************
+ * readfile : read a file into memory
+ *
+ * Enter:   filename = name of file, "-" for stdin
+ *          *plen = where to store length
+ *
+ * Return:  allocated buffer, with a 0 after the file's contents
+ */
+static char *
+readfile(const char *filename, size_t *plen)
+{
+    char *buf = 0;
+    size_t len = 0, thislen;
+    int isstdin = !strcmp(filename, "-");
+    FILE *handle;
+    if (isstdin) {
+        handle = stdin;
+        filename = "<stdin>";
+    } else {
+        handle = fopen(filename, "rb");
+        if (!handle)
+            errorexit("%s: %s", filename, strerror(errno));
+    }
+    for (;;) {
+        /* Double the buffer each time it fills. */
+        thislen = len ? len : 4096;
+        buf = memrealloc(buf, len + thislen + 1);
+        thislen = fread(buf + len, 1, thislen, handle);
+        if (!thislen)
+            break;
+        len += thislen;
+    }
+    if (ferror(handle))
+        errorexit("%s: I/O error", filename);
+    if (!isstdin)
+        fclose(handle);
+    buf[len] = 0;
+    *plen = len;
+    return memrealloc(buf, len + 1);
+}
+
+/***********************************************************************
+ * indexfiles : set the source offset of each file, and index the files
+ *              by buffer address for findfile
+ */
+static void
+indexfiles(void)
+{
+    struct file *file;
+    size_t offset = 0;
+    nfiles = 0;
+    for (file = firstfile; file; file = file->next) {
+        file->offset = offset;
+        offset += file->end - file->buf;
+        nfiles++;
+    }
+    files = memrealloc(files, (nfiles ? nfiles : 1) * sizeof(struct file *));
+    nfiles = 0;
+    for (file = firstfile; file; file = file->next)
+        files[nfiles++] = file;
+    qsort(files, nfiles, sizeof(struct file *), comparefiles);
+}
 
 /***********************************************************************
  * readinput : read all input files into memory
@@ -41,50 +156,382 @@ static struct tok tok;
 void
 readinput(const char *const *argv)
 {
-    struct file **pfile = &file;
+    struct file **pfile = &firstfile;
     for (;;) {
         struct file *file;
         const char *filename = *argv++;
-        char *buf = 0;
-        int len = 0, thislen, isstdin;
-        FILE *handle;
+        size_t len;
+        char *buf;
         if (!filename)
             break;
-        /* Read the file. */
-        isstdin = !strcmp(filename, "-");
-        if (isstdin) {
-            handle = stdin;
-            filename = "<stdin>";
-        } else {
-            handle = fopen(filename, "rb");
-            if (!handle)
-                errorexit("%s: %s", filename, strerror(errno));
-        }
-        for (;;) {
-            thislen = len ? len * 2 : 4096;
-            buf = memrealloc(buf, len + thislen + 1);
-            thislen = fread(buf + len, 1, thislen, handle);
-            if (!thislen)
-                break;
-            len += thislen;
-        }
-        if (ferror(handle))
-            errorexit("%s: I/O error", filename);
-        if (!isstdin)
-            fclose(handle);
-        buf[len] = 0;
-        buf = memrealloc(buf, len + 1);
+        buf = readfile(filename, &len);
         /* Create the file struct for it. */
         file = memalloc(sizeof(struct file));
         *pfile = file;
         pfile = &file->next;
-        file->filename = filename;
+        file->filename = strcmp(filename, "-") ? filename : "<stdin>";
         file->pos = file->buf = buf;
         file->end = buf + len;
-        file->linenum = 1;
+        file->linenum = file->startlinenum = 1;
     }
     *pfile = 0;
-    firstfile = file;
+    indexfiles();
+    file = firstfile;
+}
+
+/***********************************************************************
+ * inputfile : find the file struct for an input file
+ *
+ * Enter:   index = index of input file in the array passed to readinput
+ *
+ * Return:  file struct
+ */
+static struct file *
+inputfile(unsigned int index)
+{
+    struct file *file = firstfile;
+    while (index--)
+        file = file->next;
+    return file;
+}
+
+/***********************************************************************
+ * reloadinput : read an input file into memory again
+ *
+ * Enter:   index = index of input file in the array passed to readinput
+ *
+ * The file's previous text is freed, so nothing must still point into
+ * it. If reading fails, the previous text is kept.
+ */
+void
+reloadinput(unsigned int index)
+{
+    struct file *file = inputfile(index);
+    size_t len;
+    char *buf = readfile(file->filename, &len);
+    memfree(file->buf);
+    file->pos = file->buf = buf;
+    file->end = buf + len;
+    file->linenum = file->startlinenum = 1;
+    file->ncomments = 0;
+    indexfiles();
+}
+
+/***********************************************************************
+ * lexinput : set the lexer to lex just one input file
+ *
+ * Enter:   index = index of input file in the array passed to readinput
+ *
+ * The next call to lex returns the file's first token, and lex returns
+ * TOK_EOF at the end of the file rather than going on to the next one.
+ */
+void
+lexinput(unsigned int index)
+{
+    file = lastfile = inputfile(index);
+    file->pos = file->buf;
+    file->linenum = 1;
+    file->ncomments = 0;
+}
+
+/***********************************************************************
+ * lexbuffer : set the lexer to lex text already in memory
+ *
+ * Enter:   filename = name to give in error messages
+ *          buf = text, with a 0 after it, which must stay in place
+ *                while the parse tree made from it is in use
+ *          len = length of text
+ *          linenum = line number of the start of the text
+ *
+ * The next call to lex returns the text's first token, and lex returns
+ * TOK_EOF at its end. This replaces any input from readinput.
+ */
+void
+lexbuffer(const char *filename, const char *buf, size_t len, size_t linenum)
+{
+    static struct file bufferfile;
+    bufferfile.filename = filename;
+    bufferfile.pos = bufferfile.buf = (char *)buf;
+    bufferfile.end = buf + len;
+    bufferfile.linenum = bufferfile.startlinenum = linenum;
+    bufferfile.ncomments = 0;
+    files = memrealloc(files, sizeof(struct file *));
+    files[0] = &bufferfile;
+    nfiles = 1;
+    file = firstfile = lastfile = &bufferfile;
+    reachedend = 0;
+}
+
+/***********************************************************************
+ * lexreachedend : test whether lexing has reached the end of the input
+ *
+ * Return:  non-zero if lex has returned TOK_EOF, or an unterminated
+ *          comment or string has run to the end of the input, since
+ *          the last call to lexbuffer
+ *
+ * This tells whether an error might go away with more text after the
+ * input.
+ */
+int
+lexreachedend(void)
+{
+    return reachedend;
+}
+
+/***********************************************************************
+ * findfile : find the file that a pointer into the input is in
+ *
+ * Enter:   p = pointer into the buffer of one of the input files,
+ *              which may be its end pointer
+ *
+ * Return:  file struct
+ */
+static struct file *
+findfile(const char *p)
+{
+    unsigned int lo = 0, hi = nfiles;
+    /* Find the last file whose buffer starts at or before p. */
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (files[mid]->buf <= p)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    assert(nfiles && p >= files[lo]->buf && p <= files[lo]->end);
+    return files[lo];
+}
+
+/***********************************************************************
+ * addcommentspan : record the span of a comment in the current file
+ *
+ * Enter:   start = start of comment
+ *          end = end of comment
+ */
+static void
+addcommentspan(const char *start, const char *end)
+{
+    struct span *span;
+    if (file->ncomments == file->maxcomments) {
+        file->maxcomments = file->maxcomments ? 2 * file->maxcomments : 64;
+        file->comments = memrealloc(file->comments,
+                file->maxcomments * sizeof(struct span));
+    }
+    span = file->comments + file->ncomments++;
+    span->start = start;
+    span->end = end;
+}
+
+/***********************************************************************
+ * Streamed input
+ *
+ * With openstream, the input is read a unit at a time, each unit being
+ * a single top-level definition, so memory use does not grow with the
+ * size of the input. A unit is lexed in place in streambuf, with its
+ * following character saved and replaced by the terminating 0.
+ */
+static struct file streamfile;
+static const char *const *streamnames;
+static FILE *streamhandle;
+static char *streambuf;
+static size_t streamlen, streammax, unitlen;
+static int streameof, unitsaved;
+
+/***********************************************************************
+ * streamfill : make sure a character of the stream is in streambuf
+ *
+ * Enter:   i = index in streambuf
+ *
+ * Return:  non-zero if streambuf[i] is available, 0 if the end of the
+ *          file comes first
+ */
+static int
+streamfill(size_t i)
+{
+    while (streamlen <= i && !streameof) {
+        size_t thislen;
+        if (streammax - streamlen < 4096) {
+            streammax = streammax ? 2 * streammax : 65536;
+            streambuf = memrealloc(streambuf, streammax);
+        }
+        /* Read a little at a time, so a unit from a pipe can be
+         * processed without waiting for the pipe to fill a big buffer. */
+        thislen = fread(streambuf + streamlen, 1, 4095, streamhandle);
+        if (!thislen) {
+            if (ferror(streamhandle))
+                errorexit("%s: I/O error", streamfile.filename);
+            streameof = 1;
+        }
+        streamlen += thislen;
+    }
+    return streamlen > i;
+}
+
+/***********************************************************************
+ * skipcomment : skip a comment in the stream
+ *
+ * Enter:   i = index in streambuf of the character after the initial '/'
+ *
+ * Return:  index just past the comment, or just past the '/' if it is
+ *          not the start of a comment
+ *
+ * An unterminated comment runs to the end of the file, for the lexer
+ * to report.
+ */
+static size_t
+skipcomment(size_t i)
+{
+    if (!streamfill(i))
+        return i;
+    if (streambuf[i] == '/') {
+        while (streamfill(i) && streambuf[i++] != '\n')
+            ;
+    } else if (streambuf[i] == '*') {
+        i++;
+        while (streamfill(i + 1)
+                && (streambuf[i] != '*' || streambuf[i + 1] != '/'))
+        {
+            i++;
+        }
+        i = streamfill(i + 1) ? i + 2 : streamlen;
+    }
+    return i;
+}
+
+/***********************************************************************
+ * scanunit : find the end of the next unit of streamed input
+ *
+ * Return:  length of unit, 0 if at end of file
+ *
+ * A unit ends at a ';' outside any braces, comment or string. Any back
+ * referencing doxygen comment on the rest of that line, and the newline,
+ * are included, so that the comment stays with its definition.
+ */
+static size_t
+scanunit(void)
+{
+    unsigned int depth = 0;
+    size_t i = 0;
+    while (streamfill(i)) {
+        switch (streambuf[i++]) {
+        case '"':
+            while (streamfill(i) && streambuf[i++] != '"')
+                ;
+            break;
+        case '/':
+            i = skipcomment(i);
+            break;
+        case '{':
+            depth++;
+            break;
+        case '}':
+            if (depth)
+                depth--;
+            break;
+        case ';':
+            if (depth)
+                break;
+            while (streamfill(i) && (streambuf[i] == ' '
+                    || streambuf[i] == '\t' || streambuf[i] == '\r'))
+            {
+                i++;
+            }
+            if (streamfill(i + 3) && streambuf[i] == '/'
+                    && (streambuf[i + 1] == '/' || streambuf[i + 1] == '*')
+                    && (streambuf[i + 2] == streambuf[i + 1]
+                        || streambuf[i + 2] == '!')
+                    && streambuf[i + 3] == '<')
+            {
+                i = skipcomment(i + 1);
+                while (streamfill(i) && (streambuf[i] == ' '
+                        || streambuf[i] == '\t' || streambuf[i] == '\r'))
+                {
+                    i++;
+                }
+            }
+            if (i && streambuf[i - 1] != '\n' && streamfill(i)
+                    && streambuf[i] == '\n')
+            {
+                i++;
+            }
+            return i;
+        }
+    }
+    return streamlen;
+}
+
+/***********************************************************************
+ * openstream : start reading input files a unit at a time
+ *
+ * Enter:   argv = 0-terminated array of filenames
+ *
+ * Call nextunit to read each unit.
+ */
+void
+openstream(const char *const *argv)
+{
+    streamnames = argv;
+    files = memrealloc(files, sizeof(struct file *));
+    files[0] = &streamfile;
+    nfiles = 1;
+}
+
+/***********************************************************************
+ * nextunit : release the current unit of streamed input and read the
+ *            next one
+ *
+ * Return:  0 if no more input, else non-zero with the lexer set up to
+ *          return the tokens of the unit, then TOK_EOF
+ */
+int
+nextunit(void)
+{
+    size_t len;
+    /* Release the previous unit. */
+    if (unitlen) {
+        streambuf[unitlen] = unitsaved;
+        streamlen -= unitlen;
+        memmove(streambuf, streambuf + unitlen, streamlen);
+        streamfile.offset += unitlen;
+        unitlen = 0;
+    }
+    for (;;) {
+        if (!streamhandle) {
+            const char *filename = *streamnames;
+            if (!filename)
+                return 0;
+            streamnames++;
+            if (!strcmp(filename, "-")) {
+                streamhandle = stdin;
+                filename = "<stdin>";
+            } else {
+                streamhandle = fopen(filename, "rb");
+                if (!streamhandle)
+                    errorexit("%s: %s", filename, strerror(errno));
+            }
+            streamfile.filename = filename;
+            streamfile.linenum = 1;
+            streameof = 0;
+        }
+        len = scanunit();
+        if (len)
+            break;
+        /* End of this file. */
+        if (streamhandle != stdin)
+            fclose(streamhandle);
+        streamhandle = 0;
+    }
+    /* There is always room for the terminating 0, as streamfill leaves
+     * a byte spare. */
+    unitlen = len;
+    unitsaved = streambuf[len];
+    streambuf[len] = 0;
+    streamfile.pos = streamfile.buf = streambuf;
+    streamfile.end = streambuf + len;
+    streamfile.startlinenum = streamfile.linenum;
+    streamfile.ncomments = 0;
+    file = firstfile = &streamfile;
+    return 1;
 }
 
 /***********************************************************************
@@ -114,20 +561,25 @@ lexblockcomment(const char *start)
     tok.linenum = file->linenum;
     for (;;) {
         int ch = *++p;
-        if (!ch)
+        if (!ch) {
+            reachedend = 1;
             lexerrorexit("unterminated block comment");
+        }
         if (ch != '*') {
             if (ch == '\n')
                 file->linenum++;
             continue;
         }
         ch = p[1];
-        if (!ch)
+        if (!ch) {
+            reachedend = 1;
             lexerrorexit("unterminated block comment");
+        }
         if (ch == '/')
             break;
     }
     p += 2;
+    addcommentspan(start, p);
     file->pos = p;
     tok.type = TOK_BLOCKCOMMENT;
     tok.start = start + 2;
@@ -152,6 +604,7 @@ lexinlinecomment(const char *start)
         if (!ch || ch == '\n')
             break;
     }
+    addcommentspan(start, p);
     p++;
     file->pos = p;
     tok.type = TOK_INLINECOMMENT;
@@ -294,8 +747,10 @@ lexstring(const char *start)
         const char *p = start + 1;
         int ch = *p;
         for (;;) {
-            if (!ch)
+            if (!ch) {
+                reachedend = 1;
                 lexerrorexit("unterminated string");
+            }
             if (ch == '"') {
                 tok.type = TOK_STRING;
                 tok.start = start + 1;
@@ -369,6 +824,7 @@ lex(void)
     int ch;
     for (;;) {
         if (!file) {
+            reachedend = 1;
             tok.type = TOK_EOF;
             tok.start = "end of file";
             tok.len = strlen(tok.start);
@@ -395,7 +851,7 @@ lex(void)
             break;
         if (p != file->end)
             lexerrorexit("\\0 byte not allowed");
-        file = file->next;
+        file = file == lastfile ? 0 : file->next;
     }
     /* See if we have a comment. */
     tok.start = p;
@@ -442,29 +898,360 @@ done:
 }
 
 /***********************************************************************
- * outputwidl : output literal Web IDL input that node was parsed from
+ * srcoffset : convert pointer into input to source offset
  *
- * Enter:   node = parse node to output literal Web IDL for
+ * Enter:   p = pointer into the buffer of one of the input files
+ *
+ * Return:  offset of p from the start of the first input file, counting
+ *          the whole of each earlier file
+ */
+size_t
+srcoffset(const char *p)
+{
+    struct file *file = findfile(p);
+    return file->offset + (p - file->buf);
+}
+
+/***********************************************************************
+ * inputlength : get the total length of the input files
+ *
+ * Return:  number of bytes, the source offset just past the last file
+ */
+size_t
+inputlength(void)
+{
+    const struct file *file = firstfile;
+    size_t len = 0;
+    while (file) {
+        len = file->offset + (file->end - file->buf);
+        file = file->next;
+    }
+    return len;
+}
+
+/***********************************************************************
+ * writeinput : write the input files
+ *
+ * Enter:   handle = file to write to
+ *
+ * The files are written one after another, so a source offset is an
+ * offset in what is written.
  */
 void
-outputwidl(struct node *node)
+writeinput(FILE *handle)
+{
+    const struct file *file;
+    for (file = firstfile; file; file = file->next) {
+        size_t len = file->end - file->buf;
+        if (len != fwrite(file->buf, 1, len, handle))
+            errorexit("write error");
+    }
+}
+
+/***********************************************************************
+ * firstcommentspan : find the first comment span at or after a point
+ *
+ * Enter:   file = file struct
+ *          p = pointer into the file's buffer
+ *
+ * Return:  first span in file->comments whose start is not before p,
+ *          or file->comments + file->ncomments if none
+ */
+static const struct span *
+firstcommentspan(const struct file *file, const char *p)
+{
+    size_t lo = 0, hi = file->ncomments;
+    while (lo != hi) {
+        size_t mid = (lo + hi) / 2;
+        if (file->comments[mid].start < p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return file->comments + lo;
+}
+
+/***********************************************************************
+ * srclocation : find the filename and line number of a point in the
+ *               input
+ *
+ * Enter:   p = pointer into the buffer of one of the input files, such
+ *              as a node's wsstart
+ *          pfilename = where to store the filename
+ *          plinenum = where to store the line number
+ *
+ * Whitespace and comments at p are skipped first, so a node's wsstart
+ * gives the line that its Web IDL starts on. Lines are counted from the
+ * start of the file, so this is for error messages.
+ */
+void
+srclocation(const char *p, const char **pfilename, size_t *plinenum)
+{
+    const struct file *file = findfile(p);
+    const struct span *span = firstcommentspan(file, p);
+    const struct span *spanend = file->comments + file->ncomments;
+    size_t linenum = file->startlinenum;
+    const char *s;
+    for (;;) {
+        while (p != file->end && (*p == ' ' || *p == '\t' || *p == '\r'
+                || *p == '\n'))
+        {
+            p++;
+        }
+        while (span != spanend && span->start < p)
+            span++;
+        if (span == spanend || span->start != p)
+            break;
+        p = span->end;
+    }
+    for (s = file->buf; s != p; s++)
+        linenum += *s == '\n';
+    *pfilename = file->filename;
+    *plinenum = linenum;
+}
+
+/***********************************************************************
+ * textchars : count the characters in escaped text
+ *
+ * Enter:   s = 0-terminated text as returned by memprinttext
+ *
+ * Return:  number of characters an xml parser sees, each escape
+ *          counting as one
+ */
+static size_t
+textchars(const char *s)
+{
+    size_t count = 0;
+    int ch;
+    while ((ch = *s++)) {
+        if (ch == '&') {
+            while (*s && *s++ != ';')
+                ;
+            count++;
+        } else if ((ch & 0xc0) != 0x80)
+            count++;
+    }
+    return count;
+}
+
+/***********************************************************************
+ * appendsource : append escaped text or markup to a file's built source
+ *
+ * Enter:   file = file struct
+ *          s = 0-terminated text
+ */
+static void
+appendsource(struct file *file, const char *s)
+{
+    size_t len = strlen(s);
+    if (file->sourcelen + len + 1 > file->sourcemax) {
+        while (file->sourcelen + len + 1 > file->sourcemax)
+            file->sourcemax = file->sourcemax ? 2 * file->sourcemax : 4096;
+        file->source = memrealloc(file->source, file->sourcemax);
+    }
+    memcpy(file->source + file->sourcelen, s, len + 1);
+    file->sourcelen += len;
+}
+
+/***********************************************************************
+ * widltext : output or build a piece of literal Web IDL
+ *
+ * Enter:   file = file the text is in
+ *          start, end = text
+ *          build = non-zero to add it to the source being built by
+ *                  buildsource, rather than output it
+ *
+ * Built text is split into runs at newlines, so that webidloffset only
+ * has to count characters within a line.
+ */
+static void
+widltext(struct file *file, const char *start, const char *end, int build)
+{
+    if (!build) {
+        printtext(start, end - start, 1);
+        return;
+    }
+    while (start != end) {
+        const char *p = memchr(start, '\n', end - start);
+        struct run *run;
+        char *text;
+        p = p ? p + 1 : end;
+        if (file->nruns == file->maxruns) {
+            file->maxruns = file->maxruns ? 2 * file->maxruns : 256;
+            file->runs = memrealloc(file->runs,
+                    file->maxruns * sizeof(struct run));
+        }
+        run = file->runs + file->nruns++;
+        run->start = start;
+        run->end = p;
+        run->offset = sourcechars;
+        text = memprinttext(start, p - start, 1);
+        sourcechars += textchars(text);
+        appendsource(file, text);
+        memfree(text);
+        start = p;
+    }
+}
+
+/***********************************************************************
+ * widlmarkup : output or build markup in literal Web IDL
+ *
+ * Enter:   file = file the Web IDL is in
+ *          s = 0-terminated markup
+ *          build = as widltext
+ */
+static void
+widlmarkup(struct file *file, const char *s, int build)
+{
+    if (build)
+        appendsource(file, s);
+    else
+        fputs(s, stdout);
+}
+
+/* The nodes with start set in the tree being output, in text order,
+ * when sortrefs finds that the tree walk does not give them in that
+ * order, and whether any nodes have been moved so that it might not. */
+static struct node **refs;
+static size_t nrefs, maxrefs;
+static int nodesmoved;
+
+/***********************************************************************
+ * subtreewalk : single step of depth last traversal of a subtree
+ *
+ * Enter:   node = node in the subtree
+ *          root = root of the subtree
+ *
+ * Return:  next node in walk, 0 if finished
+ *
+ * This is nodewalk, except that it stops at the end of the subtree
+ * rather than carrying on through the rest of the tree. That stops
+ * outputting the text of every node being quadratic in the number of
+ * definitions.
+ */
+static struct node *
+subtreewalk(struct node *node, struct node *root)
+{
+    if (node->children)
+        return node->children;
+    while (node != root) {
+        if (node->next)
+            return node->next;
+        node = node->parent;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * comparerefs : compare two nodes by the position of their start in the
+ *               input, for qsort
+ */
+static int
+comparerefs(const void *a, const void *b)
+{
+    size_t offseta = srcoffset((*(struct node *const *)a)->start);
+    size_t offsetb = srcoffset((*(struct node *const *)b)->start);
+    return offseta < offsetb ? -1 : offseta > offsetb;
+}
+
+/***********************************************************************
+ * sortrefs : put the nodes with start set in a tree into text order
+ *
+ * Enter:   root = root of tree
+ *
+ * Return:  non-zero if refs is now those nodes in text order, 0 if the
+ *          tree walk already finds them in text order
+ *
+ * They can be out of order once setnodesmoved has been called, as by
+ * mergepartials when it moves the members of a partial definition into
+ * the definition it extends.
+ */
+static int
+sortrefs(struct node *root)
+{
+    struct node *node;
+    size_t lastoffset = 0, i, j;
+    int sorted = 1;
+    nrefs = 0;
+    for (node = root; node; node = subtreewalk(node, root)) {
+        size_t offset;
+        if (!node->start)
+            continue;
+        if (nrefs == maxrefs) {
+            maxrefs = maxrefs ? 2 * maxrefs : 64;
+            refs = memrealloc(refs, maxrefs * sizeof(struct node *));
+        }
+        refs[nrefs++] = node;
+        offset = srcoffset(node->start);
+        if (nrefs > 1 && offset <= lastoffset)
+            sorted = 0;
+        lastoffset = offset;
+    }
+    if (sorted)
+        return 0;
+    qsort(refs, nrefs, sizeof(struct node *), comparerefs);
+    /* A copied node has the same start as its original; keep one. */
+    for (i = j = 0; i != nrefs; i++) {
+        if (!j || refs[i]->start != refs[j - 1]->start)
+            refs[j++] = refs[i];
+    }
+    nrefs = j;
+    return 1;
+}
+
+/***********************************************************************
+ * nextref : find the next node with start set
+ *
+ * Enter:   node = current node
+ *          root = root of tree being output
+ *          sorted = whether to take nodes from refs, as set by sortrefs
+ *          pindex = where the index of the next node in refs is kept
+ *
+ * Return:  next node with start set, 0 if none
+ */
+static struct node *
+nextref(struct node *node, struct node *root, int sorted, size_t *pindex)
+{
+    if (sorted)
+        return *pindex != nrefs ? refs[(*pindex)++] : 0;
+    do
+        node = subtreewalk(node, root);
+    while (node && !node->start);
+    return node;
+}
+
+/***********************************************************************
+ * outputwidlspan : output or build literal Web IDL input that node was
+ *                  parsed from
+ *
+ * Enter:   node = parse node to output literal Web IDL for
+ *          build = as widltext
+ *
+ * Comments are omitted using the comment spans recorded by the lexer,
+ * so the text between comments is output without being scanned.
+ */
+static void
+outputwidlspan(struct node *node, int build)
 {
     const char *start = node->wsstart, *end = node->end;
+    struct node *root = node;
     /* Find the file that start is in. */
-    struct file *file = firstfile;
-    while (start < file->buf || start >= file->end) {
-        file = file->next;
-        assert(file);
-    }
+    struct file *file = findfile(start);
+    /* Only the root of the whole tree can have had nodes moved out of
+     * text order within it. */
+    int sorted = nodesmoved && !root->parent && sortrefs(root);
+    size_t refindex = 0;
     /* Find the (current or) next node that has node->start set. Any such
      * node needs to be put inside a <ref> element. */
-    while (node && !node->start)
-        node = nodewalk(node);
+    if (sorted || !node->start)
+        node = nextref(node, root, sorted, &refindex);
     /* Output until we get to the end. This has to cope with the text
      * spanning multiple input files. */
     for (;;) {
         int final = end >= file->buf && end <= file->end;
         const char *thisend = final ? end : file->end;
+        const struct span *span = firstcommentspan(file, start);
+        const struct span *spanend = file->comments + file->ncomments;
         /* Output the Web IDL, omitting comments. */
         while (start != end) {
             const char *p, *p2, *comment, *endcomment;
@@ -472,59 +1259,33 @@ outputwidl(struct node *node)
             if (node && start == node->start) {
                 /* We are on the start of the present node in the tree
                  * walk. Put it in a <ref>. */
-                fputs("<ref>", stdout);
-                printtext(node->start, node->end - node->start, 1);
-                fputs("</ref>", stdout);
+                widlmarkup(file, "<ref>", build);
+                widltext(file, node->start, node->end, build);
+                widlmarkup(file, "</ref>", build);
                 start = node->end;
                 /* Skip to the next node with node->start set if any. */
-                do
-                    node = nodewalk(node);
-                while (node && !node->start);
+                node = nextref(node, root, sorted, &refindex);
                 continue;
             }
             p2 = thisend;
             if (node && node->start >= file->buf && node->start < p2 && start < node->start) // TODO: there are cases when start is actually greater than node->start???
                 p2 = node->start;
-            p = memchr(start, '/', p2 - start);
-            if (!p) {
-                printtext(start, p2 - start, 1);
+            while (span != spanend && span->start < start)
+                span++;
+            if (span == spanend || span->start >= p2) {
+                /* No comment before p2. */
+                widltext(file, start, p2, build);
                 if (p2 != thisend) {
                     start = p2;
                     continue;
                 }
                 break;
             }
-            /* See if we're at the start of a comment. If so find the end. */
-            comment = 0;
-            if (p + 1 != thisend) {
-                switch (p[1]) {
-                case '*':
-                    /* Block comment. */
-                    comment = p;
-                    p++;
-                    do 
-                        p = memchr(p + 1, '*', thisend - p - 1);
-                    while (p[1] != '/');
-                    endcomment = p + 2;
-                    break;
-                case '/':
-                    /* Inline comment. */
-                    comment = p;
-                    p = memchr(p, '\n', thisend - p);
-                    if (!p)
-                        p = thisend;
-                    endcomment = p;
-                    break;
-                }
-            }
-            if (!comment) {
-                /* Not at start of comment. */
-                p++;
-                printtext(start, p - start, 1);
-                start = p;
-                assert(start <= end);
-                continue;
-            }
+            comment = span->start;
+            endcomment = span->end;
+            if (endcomment > thisend)
+                endcomment = thisend;
+            span++;
             /* If the comment has only whitespace before it on the line,
              * eat that up. */
             p = comment;
@@ -542,11 +1303,13 @@ outputwidl(struct node *node)
                     p++;
                 endcomment = p;
             }
-            printtext(start, comment - start, 1);
+            widltext(file, start, comment, build);
             start = endcomment;
             if (start > thisend)
                 start = thisend;
         }
+        if (build)
+            file->sourceend = sourcechars;
         if (final)
             break;
         file = file->next;
@@ -554,3 +1317,119 @@ outputwidl(struct node *node)
         start = file->buf;
     }
 }
+
+/***********************************************************************
+ * setnodesmoved : note that nodes have been moved out of text order
+ *
+ * After this, outputwidl for the root of the tree sorts the nodes that
+ * go in a <ref> into text order, rather than relying on the tree walk
+ * to find them in that order.
+ */
+void
+setnodesmoved(void)
+{
+    nodesmoved = 1;
+}
+
+/***********************************************************************
+ * outputwidl : output literal Web IDL input that node was parsed from
+ *
+ * Enter:   node = parse node to output literal Web IDL for
+ */
+void
+outputwidl(struct node *node)
+{
+    outputwidlspan(node, 0);
+}
+
+/***********************************************************************
+ * buildsource : build the literal Web IDL of the whole input once
+ *
+ * Enter:   root = root of parse tree
+ *
+ * After this, outputsource outputs the source of each file, and
+ * webidloffsets gives the offsets of a node's Web IDL in it.
+ */
+void
+buildsource(struct node *root)
+{
+    sourcebuilt = 1;
+    sourcechars = 0;
+    outputwidlspan(root, 1);
+}
+
+/***********************************************************************
+ * outputsource : output the source built by buildsource
+ *
+ * Enter:   indent
+ *
+ * Each file's source is output in a <source> element. Nothing is output
+ * if buildsource has not been called.
+ */
+void
+outputsource(unsigned int indent)
+{
+    struct file *file;
+    if (!sourcebuilt)
+        return;
+    for (file = firstfile; file; file = file->next) {
+        printf("%*s<source file=\"", indent, "");
+        printtext(file->filename, strlen(file->filename), 1);
+        printf("\">%s</source>\n", file->source ? file->source : "");
+    }
+}
+
+/***********************************************************************
+ * webidloffset : convert pointer into input to offset in built source
+ *
+ * Enter:   p = pointer into the buffer of one of the input files
+ *
+ * Return:  character offset in the concatenated text of the <source>
+ *          elements; a pointer into omitted text such as a comment
+ *          gives the offset of the next text that was not omitted
+ */
+static size_t
+webidloffset(const char *p)
+{
+    struct file *file = findfile(p);
+    size_t lo = 0, hi = file->nruns;
+    const struct run *run;
+    size_t offset;
+    char *text;
+    /* Find the first run that ends after p. */
+    while (lo != hi) {
+        size_t mid = (lo + hi) / 2;
+        if (file->runs[mid].end <= p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == file->nruns)
+        return file->sourceend;
+    run = file->runs + lo;
+    if (p <= run->start)
+        return run->offset;
+    text = memprinttext(run->start, p - run->start, 1);
+    offset = run->offset + textchars(text);
+    memfree(text);
+    return offset;
+}
+
+/***********************************************************************
+ * webidloffsets : get offsets of node's literal Web IDL in built source
+ *
+ * Enter:   node = parse node with wsstart and end set
+ *          pstart, pend = where to store start and end offsets
+ *
+ * Return:  non-zero if buildsource has been called and the offsets have
+ *          been stored, else 0
+ */
+int
+webidloffsets(struct node *node, size_t *pstart, size_t *pend)
+{
+    if (!sourcebuilt)
+        return 0;
+    *pstart = webidloffset(node->wsstart);
+    *pend = webidloffset(node->end);
+    return 1;
+}
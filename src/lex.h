@@ -14,6 +14,8 @@
  ***********************************************************************/
 #ifndef lex_h
 #define lex_h
+#include <stddef.h>
+#include <stdio.h>
 
 // starting from "attribute" are the list of names allowed as arguments identifier
 #define KEYWORDS \
@@ -160,10 +162,10 @@ enum toktype {
 struct tok {
     enum toktype type;
     const char *filename;
-    unsigned int linenum;
+    size_t linenum;
     const char *prestart;
     const char *start;
-    unsigned int len;
+    size_t len;
 };
 
 extern const char *filename;
@@ -172,7 +174,21 @@ extern const char keywords[];
 struct node;
 
 void readinput(const char *const *argv);
+void reloadinput(unsigned int index);
+void lexinput(unsigned int index);
+void lexbuffer(const char *filename, const char *buf, size_t len, size_t linenum);
+int lexreachedend(void);
+void openstream(const char *const *argv);
+int nextunit(void);
 struct tok *lex(void);
+size_t srcoffset(const char *p);
+void srclocation(const char *p, const char **pfilename, size_t *plinenum);
+size_t inputlength(void);
+void writeinput(FILE *handle);
+void setnodesmoved(void);
 void outputwidl(struct node *node);
+void buildsource(struct node *root);
+void outputsource(unsigned int indent);
+int webidloffsets(struct node *node, size_t *pstart, size_t *pend);
 
 #endif /* ndef lex_h */
@@ -0,0 +1,1158 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Language Server Protocol mode
+ ***********************************************************************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "comment.h"
+#include "hash.h"
+#include "json.h"
+#include "lex.h"
+#include "lsp.h"
+#include "misc.h"
+#include "node.h"
+#include "parse.h"
+#include "os.h"
+
+#ifdef _MSC_VER
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/* struct unit : a piece of a document that is parsed on its own
+ *
+ * A document's text is split into units, each normally holding one
+ * top-level definition with the whitespace and comments that follow it
+ * on its last line. An edit reparses only the units it touches. Each
+ * unit has its own copy of its text, as its parse tree points into it;
+ * the document's text is the units' texts in order. */
+struct unit {
+    struct document *doc;
+    char *text; /* with a 0 after it */
+    size_t len;
+    size_t nlines; /* number of newlines in text */
+    size_t start; /* offset in the document text, set by layoutunits */
+    size_t line; /* line number of start of text, set by layoutunits */
+    struct node *root; /* Definitions element, 0 if there was an error */
+    char *error; /* error message if there was an error */
+    size_t errorline; /* line of error, relative to line */
+    int cutshort; /* whether the error was at the end of the text */
+    struct name *names; /* index entries for the unit's names */
+};
+
+/* struct document : an open document */
+struct document {
+    struct document *next;
+    char *uri;
+    char *text; /* with a 0 after it */
+    size_t len, max;
+    struct unit **units;
+    size_t nunits, maxunits;
+};
+
+/* struct name : an entry in the name index
+ *
+ * The index maps an identifier to the list of its definitions and
+ * references in all open documents. The hash table holds the first in
+ * the list, and is keyed by its name. */
+struct name {
+    struct name *prev, *next; /* in the list for the identifier */
+    struct name *unitnext; /* in the list for the unit */
+    struct unit *unit;
+    char *name;
+    size_t len;
+    size_t start, end; /* offsets of the name's span in the unit text */
+    int isdef; /* non-zero for a definition, 0 for a reference */
+};
+
+static struct document *documents;
+static struct hashtable nameindex;
+
+/* The message being built to send. */
+static struct {
+    char *buf;
+    size_t len, max;
+} message;
+
+/***********************************************************************
+ * addtext : append text to the message being built
+ *
+ * Enter:   s = text
+ *          len = length of text
+ */
+static void
+addtext(const char *s, size_t len)
+{
+    if (message.len + len > message.max) {
+        while (message.len + len > message.max)
+            message.max = message.max ? 2 * message.max : 1024;
+        message.buf = memrealloc(message.buf, message.max);
+    }
+    memcpy(message.buf + message.len, s, len);
+    message.len += len;
+}
+
+/***********************************************************************
+ * addf : append printf formatted text to the message being built
+ */
+static void
+addf(const char *format, ...)
+{
+    va_list ap;
+    char *s;
+    va_start(ap, format);
+    s = vmemprintf(format, ap);
+    va_end(ap);
+    addtext(s, strlen(s));
+    memfree(s);
+}
+
+/***********************************************************************
+ * addstring : append a JSON string to the message being built
+ *
+ * Enter:   s = text
+ *          len = length of text
+ */
+static void
+addstring(const char *s, size_t len)
+{
+    char *json = memjsonstring(s, len);
+    addtext(json, strlen(json));
+    memfree(json);
+}
+
+/***********************************************************************
+ * sendmessage : send the message that has been built
+ */
+static void
+sendmessage(void)
+{
+    printf("Content-Length: %llu\r\n\r\n", (unsigned long long)message.len);
+    if (message.len != fwrite(message.buf, 1, message.len, stdout)
+            || fflush(stdout))
+    {
+        errorexit("write error");
+    }
+    message.len = 0;
+}
+
+/***********************************************************************
+ * startresponse : start building the response to a request
+ *
+ * Enter:   id = id member of the request
+ *          member = "result" or "error"
+ *
+ * The caller appends the result or error and the closing brace.
+ */
+static void
+startresponse(const struct json *id, const char *member)
+{
+    addf("{\"jsonrpc\":\"2.0\",\"id\":");
+    if (id->type == JSON_STRING)
+        addstring(id->string, id->len);
+    else if (id->type == JSON_NUMBER)
+        addf("%.17g", id->number);
+    else
+        addf("null");
+    addf(",\"%s\":", member);
+}
+
+/***********************************************************************
+ * readmessage : read a message from the client
+ *
+ * Return:  parsed message, 0 at end of input
+ *
+ * A message that is not valid JSON is skipped.
+ */
+static struct json *
+readmessage(void)
+{
+    for (;;) {
+        char line[256], *buf;
+        unsigned long long len = 0;
+        int gotlen = 0;
+        struct json *json;
+        /* Read the header lines up to the blank line. */
+        for (;;) {
+            if (!fgets(line, sizeof(line), stdin))
+                return 0;
+            if (!strcmp(line, "\r\n") || !strcmp(line, "\n"))
+                break;
+            if (!strncmp(line, "Content-Length:", 15)) {
+                len = strtoull(line + 15, 0, 10);
+                gotlen = 1;
+            }
+        }
+        if (!gotlen)
+            errorexit("lsp: message without Content-Length");
+        buf = memalloc(len + 1);
+        if (fread(buf, 1, len, stdin) != len) {
+            memfree(buf);
+            return 0;
+        }
+        json = parsejson(buf, len);
+        memfree(buf);
+        if (json)
+            return json;
+    }
+}
+
+/***********************************************************************
+ * jsonnumber : get the value of a number member of a JSON object
+ *
+ * Enter:   json = json struct, or 0
+ *          key = member name
+ *
+ * Return:  value, 0 if no such number member
+ */
+static size_t
+jsonnumber(const struct json *json, const char *key)
+{
+    json = jsonmember(json, key);
+    return json && json->type == JSON_NUMBER && json->number > 0
+            ? (size_t)json->number : 0;
+}
+
+/***********************************************************************
+ * isidchar : test for a character that can be in an identifier
+ */
+static int
+isidchar(int ch)
+{
+    ch = (unsigned char)ch;
+    return ch == '_' || (unsigned)(ch - '0') < 10
+            || (unsigned)((ch & ~0x20) - 'A') <= 'Z' - 'A';
+}
+
+/***********************************************************************
+ * advancechars : step through a line by a number of UTF-16 code units
+ *
+ * Enter:   p = position in text
+ *          end = end of text
+ *          n = number of UTF-16 code units to step, as LSP counts
+ *              characters
+ *
+ * Return:  new position, no further than the end of the line
+ */
+static const char *
+advancechars(const char *p, const char *end, size_t n)
+{
+    while (p != end && *p != '\n') {
+        int ch = (unsigned char)*p;
+        if ((ch & 0xc0) != 0x80) {
+            size_t units = ch >= 0xf0 ? 2 : 1;
+            if (n < units)
+                break;
+            n -= units;
+        }
+        p++;
+    }
+    return p;
+}
+
+/***********************************************************************
+ * countchars : count the UTF-16 code units in some text
+ *
+ * Enter:   p = start of text
+ *          end = end of text
+ *
+ * Return:  number of UTF-16 code units
+ */
+static size_t
+countchars(const char *p, const char *end)
+{
+    size_t n = 0;
+    while (p != end) {
+        int ch = (unsigned char)*p++;
+        if ((ch & 0xc0) != 0x80)
+            n += ch >= 0xf0 ? 2 : 1;
+    }
+    return n;
+}
+
+/***********************************************************************
+ * countlines : count the newlines in some text
+ *
+ * Enter:   p = start of text
+ *          len = length of text
+ *
+ * Return:  number of newlines
+ */
+static size_t
+countlines(const char *p, size_t len)
+{
+    const char *end = p + len;
+    size_t n = 0;
+    while ((p = memchr(p, '\n', end - p))) {
+        p++;
+        n++;
+    }
+    return n;
+}
+
+/***********************************************************************
+ * positionoffset : convert an LSP position to an offset in a document
+ *
+ * Enter:   doc = document
+ *          position = LSP position object
+ *
+ * Return:  offset in document text
+ */
+static size_t
+positionoffset(const struct document *doc, const struct json *position)
+{
+    size_t line = jsonnumber(position, "line");
+    const char *p = doc->text, *end = p + doc->len;
+    while (line--) {
+        p = memchr(p, '\n', end - p);
+        if (!p)
+            return doc->len;
+        p++;
+    }
+    return advancechars(p, end, jsonnumber(position, "character"))
+            - doc->text;
+}
+
+/***********************************************************************
+ * addposition : append the LSP position of a point in a unit to the
+ *               message being built
+ *
+ * Enter:   unit = unit
+ *          offset = offset in unit text
+ */
+static void
+addposition(const struct unit *unit, size_t offset)
+{
+    const char *text = unit->text, *p = text + offset, *q, *linestart = 0;
+    size_t line = unit->line - 1, character;
+    for (q = text; q != p; q++) {
+        if (*q == '\n') {
+            line++;
+            linestart = q + 1;
+        }
+    }
+    if (linestart)
+        character = countchars(linestart, p);
+    else {
+        /* The line starts before the unit. */
+        const char *doctext = unit->doc->text;
+        q = doctext + unit->start;
+        while (q != doctext && q[-1] != '\n')
+            q--;
+        character = countchars(q, doctext + unit->start)
+                + countchars(text, p);
+    }
+    addf("{\"line\":%llu,\"character\":%llu}", (unsigned long long)line,
+            (unsigned long long)character);
+}
+
+/***********************************************************************
+ * addlocation : append an LSP location to the message being built
+ *
+ * Enter:   unit = unit the location is in
+ *          start, end = offsets of its span in the unit text
+ */
+static void
+addlocation(const struct unit *unit, size_t start, size_t end)
+{
+    const char *uri = unit->doc->uri;
+    addf("{\"uri\":");
+    addstring(uri, strlen(uri));
+    addf(",\"range\":{\"start\":");
+    addposition(unit, start);
+    addf(",\"end\":");
+    addposition(unit, end);
+    addf("}}");
+}
+
+/***********************************************************************
+ * addname : add an entry to the name index
+ *
+ * Enter:   unit = unit the name is in
+ *          s = the name's text in the unit
+ *          len = length of name
+ *          isdef = non-zero for a definition, 0 for a reference
+ *
+ * Return:  new entry, with its span set to the name's text
+ */
+static struct name *
+addname(struct unit *unit, const char *s, size_t len, int isdef)
+{
+    struct name *name = memalloc(sizeof(struct name)), *head;
+    void **pvalue;
+    name->unit = unit;
+    name->name = memprintf("%.*s", (int)len, s);
+    name->len = len;
+    name->start = s - unit->text;
+    name->end = name->start + len;
+    name->isdef = isdef;
+    pvalue = hashput(&nameindex, name->name, len);
+    head = *pvalue;
+    if (head) {
+        /* Add it after the head, so the key stays the same. */
+        name->prev = head;
+        name->next = head->next;
+        if (head->next)
+            head->next->prev = name;
+        head->next = name;
+    } else
+        *pvalue = name;
+    name->unitnext = unit->names;
+    unit->names = name;
+    return name;
+}
+
+/***********************************************************************
+ * removename : remove an entry from the name index and free it
+ *
+ * Enter:   name = entry
+ */
+static void
+removename(struct name *name)
+{
+    if (name->prev) {
+        name->prev->next = name->next;
+        if (name->next)
+            name->next->prev = name->prev;
+    } else {
+        /* It is the head, so its name is the key; rekey to the next. */
+        hashremove(&nameindex, name->name, name->len);
+        if (name->next) {
+            name->next->prev = 0;
+            *hashput(&nameindex, name->next->name, name->len) = name->next;
+        }
+    }
+    memfree(name->name);
+    memfree(name);
+}
+
+/***********************************************************************
+ * finddefname : find where a definition's name is in its text
+ *
+ * Enter:   node = definition element
+ *          id = its name
+ *
+ * Return:  pointer to the name in the definition's text, or to the
+ *          start of the definition if not found
+ *
+ * The name is the first whole identifier in the definition matching
+ * it, not counting any extended attribute list.
+ */
+static const char *
+finddefname(struct node *node, const char *id)
+{
+    const char *p = node->wsstart, *end = node->end;
+    size_t len = strlen(id);
+    unsigned int depth = 0;
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    if (p != end && *p == '[') {
+        /* Skip the extended attribute list. */
+        do {
+            depth += *p == '[';
+            depth -= *p == ']';
+            p++;
+        } while (depth && p != end);
+    }
+    for (; (size_t)(end - p) >= len; p++) {
+        if (!memcmp(p, id, len)
+                && (p == node->wsstart || !isidchar(p[-1]))
+                && !isidchar(p[len]))
+        {
+            return p;
+        }
+    }
+    p = node->wsstart;
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
+}
+
+/***********************************************************************
+ * indexunit : add a unit's definitions and references to the name index
+ *
+ * Enter:   unit = unit, successfully parsed
+ *
+ * A definition is a named top-level definition. A reference is a
+ * scoped name that outputwidl would put in a <ref>.
+ */
+static void
+indexunit(struct unit *unit)
+{
+    struct node *node;
+    for (node = nextelement(unit->root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *id = getattr(node, NAME_name);
+        if (id && node->wsstart)
+            addname(unit, finddefname(node, id), strlen(id), 1);
+    }
+    for (node = unit->root; node; node = nodewalk(node)) {
+        if (node->start && node->end)
+            addname(unit, node->start, node->end - node->start, 0);
+    }
+}
+
+/***********************************************************************
+ * newunit : make a unit and parse it
+ *
+ * Enter:   doc = document
+ *          text = allocated text, with a 0 after it, which becomes owned
+ *                 by the unit
+ *          len = length of text
+ *          line = line number of start of text
+ *
+ * Return:  new unit
+ *
+ * A parse error is recorded in the unit, rather than exiting.
+ */
+static struct unit *
+newunit(struct document *doc, char *text, size_t len, size_t line)
+{
+    struct unit *unit = memalloc(sizeof(struct unit));
+    jmp_buf jmp;
+    unit->doc = doc;
+    unit->text = text;
+    unit->len = len;
+    unit->nlines = countlines(text, len);
+    unit->line = line;
+    if (setjmp(jmp)) {
+        /* If the error was in the parse, free the nodes it made and the
+         * comments it saw; otherwise the comments may be attached to
+         * the tree, so they are freed with it. */
+        size_t linenum;
+        const char *error = lasterror(&linenum);
+        seterrorjmp(0);
+        if (unit->root) {
+            abandoncomments();
+            freenode(unit->root);
+            unit->root = 0;
+        } else {
+            freenodelog();
+            discardcomments();
+        }
+        unit->error = memprintf("%s", error);
+        unit->errorline = linenum > line ? linenum - line : 0;
+        unit->cutshort = lexreachedend();
+        return unit;
+    }
+    seterrorjmp(&jmp);
+    lexbuffer(doc->uri, text, len, line);
+    startnodelog();
+    unit->root = parse();
+    endnodelog();
+    processcomments(unit->root);
+    seterrorjmp(0);
+    indexunit(unit);
+    return unit;
+}
+
+/***********************************************************************
+ * freeunit : free a unit, removing it from the name index
+ *
+ * Enter:   unit = unit
+ */
+static void
+freeunit(struct unit *unit)
+{
+    while (unit->names) {
+        struct name *name = unit->names;
+        unit->names = name->unitnext;
+        removename(name);
+    }
+    if (unit->root)
+        freenode(unit->root);
+    if (unit->error)
+        memfree(unit->error);
+    memfree(unit->text);
+    memfree(unit);
+}
+
+/***********************************************************************
+ * unitbreak : find where a unit ends between two definitions
+ *
+ * Enter:   node = definition
+ *          next = next definition
+ *
+ * Return:  pointer to just after the newline ending node's last line,
+ *          or to the start of next if next starts on that line
+ *
+ * Only whitespace and comments come between the two definitions, so
+ * any comment on the rest of the first one's last line stays with it.
+ */
+static const char *
+unitbreak(const struct node *node, const struct node *next)
+{
+    const char *p = node->end, *limit = next->wsstart;
+    while (p != limit) {
+        switch (*p) {
+        case ' ':
+        case '\t':
+        case '\r':
+            p++;
+            continue;
+        case '\n':
+            return p + 1;
+        case '/':
+            if (p[1] == '/') {
+                while (p != limit && *p != '\n')
+                    p++;
+                continue;
+            }
+            if (p[1] == '*') {
+                p += 2;
+                while (p != limit && (p[0] != '*' || p[1] != '/'))
+                    p++;
+                if (p != limit)
+                    p += 2;
+                continue;
+            }
+            break;
+        }
+        break;
+    }
+    return limit;
+}
+
+/***********************************************************************
+ * layoutunits : set the offset and line number of each unit of a
+ *               document
+ *
+ * Enter:   doc = document
+ */
+static void
+layoutunits(struct document *doc)
+{
+    size_t i, start = 0, line = 1;
+    for (i = 0; i != doc->nunits; i++) {
+        struct unit *unit = doc->units[i];
+        unit->start = start;
+        unit->line = line;
+        start += unit->len;
+        line += unit->nlines;
+    }
+}
+
+/***********************************************************************
+ * replaceunits : replace some of a document's units with new text
+ *
+ * Enter:   doc = document, with its units laid out
+ *          first = index of first unit to replace
+ *          count = number of units to replace
+ *          text = allocated new text for them, with a 0 after it, which
+ *                 becomes owned by the document
+ *          len = length of text
+ *
+ * The text is parsed as a whole, then split at the ends of the
+ * definitions found, with each part parsed again as a unit of its own.
+ * If there is an error, the text stays as a single unit. If the error
+ * is at the end of the text, as with an unterminated comment, more of
+ * the units after it are taken in and the text parsed again, doubling
+ * how many each time, so the result is the same as parsing the whole
+ * document.
+ */
+static void
+replaceunits(struct document *doc, size_t first, size_t count,
+             char *text, size_t len)
+{
+    size_t line = first != doc->nunits ? doc->units[first]->line
+            : first ? doc->units[first - 1]->line
+                    + doc->units[first - 1]->nlines : 1;
+    struct unit **units = 0, *unit = 0;
+    size_t nunits = 0, more = 1, i;
+    while (len) {
+        size_t extra, extralen = 0;
+        char *newtext;
+        unit = newunit(doc, text, len, line);
+        if (!unit->cutshort || first + count == doc->nunits)
+            break;
+        extra = doc->nunits - first - count;
+        if (extra > more)
+            extra = more;
+        more *= 2;
+        for (i = first + count; i != first + count + extra; i++)
+            extralen += doc->units[i]->len;
+        newtext = memalloc(len + extralen + 1);
+        memcpy(newtext, text, len);
+        for (i = first + count; i != first + count + extra; i++) {
+            memcpy(newtext + len, doc->units[i]->text, doc->units[i]->len);
+            len += doc->units[i]->len;
+        }
+        count += extra;
+        freeunit(unit);
+        text = newtext;
+    }
+    for (i = first; i != first + count; i++)
+        freeunit(doc->units[i]);
+    if (unit) {
+        struct node *node;
+        for (node = unit->root ? nextelement(unit->root->children) : 0;
+                node; node = nextelement(node->next))
+        {
+            nunits++;
+        }
+        if (nunits <= 1) {
+            units = memalloc(sizeof(struct unit *));
+            units[0] = unit;
+            nunits = 1;
+        } else {
+            /* More than one definition, so split it. */
+            const char *start = text;
+            units = memalloc(nunits * sizeof(struct unit *));
+            nunits = 0;
+            for (node = nextelement(unit->root->children); node;
+                    node = nextelement(node->next))
+            {
+                struct node *next = nextelement(node->next);
+                const char *end = next ? unitbreak(node, next) : text + len;
+                size_t partlen = end - start;
+                units[nunits] = newunit(doc,
+                        memprintf("%.*s", (int)partlen, start), partlen, line);
+                line += units[nunits++]->nlines;
+                start = end;
+            }
+            freeunit(unit);
+        }
+    } else
+        memfree(text);
+    /* Put the new units in place of the old ones. */
+    if (doc->nunits - count + nunits > doc->maxunits) {
+        while (doc->nunits - count + nunits > doc->maxunits)
+            doc->maxunits = doc->maxunits ? 2 * doc->maxunits : 16;
+        doc->units = memrealloc(doc->units,
+                doc->maxunits * sizeof(struct unit *));
+    }
+    memmove(doc->units + first + nunits, doc->units + first + count,
+            (doc->nunits - first - count) * sizeof(struct unit *));
+    if (nunits)
+        memcpy(doc->units + first, units, nunits * sizeof(struct unit *));
+    doc->nunits += nunits - count;
+    if (units)
+        memfree(units);
+    layoutunits(doc);
+}
+
+/***********************************************************************
+ * unitat : find the unit containing an offset in a document
+ *
+ * Enter:   doc = document, with at least one unit
+ *          offset = offset in document text
+ *
+ * Return:  index of unit, the last one if offset is at the end
+ */
+static size_t
+unitat(const struct document *doc, size_t offset)
+{
+    size_t lo = 0, hi = doc->nunits;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (doc->units[mid]->start <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/***********************************************************************
+ * editdocument : replace part of a document's text, and reparse the
+ *                units the edit touches
+ *
+ * Enter:   doc = document
+ *          start = offset of start of text to replace
+ *          end = offset of end of text to replace
+ *          s = new text
+ *          len = length of new text
+ *
+ * An edit at the start of a unit also reparses the unit before, as the
+ * new text may continue that unit's definition.
+ */
+static void
+editdocument(struct document *doc, size_t start, size_t end,
+             const char *s, size_t len)
+{
+    size_t first = 0, count = 0, regionstart = 0, regionend = 0;
+    size_t newlen = doc->len - (end - start) + len, regionlen;
+    char *region;
+    if (doc->nunits) {
+        size_t last;
+        first = unitat(doc, start);
+        if (first && start == doc->units[first]->start)
+            first--;
+        last = unitat(doc, end);
+        count = last - first + 1;
+        regionstart = doc->units[first]->start;
+        regionend = doc->units[last]->start + doc->units[last]->len;
+    }
+    /* Build the new text of the units being replaced. */
+    regionlen = regionend - regionstart - (end - start) + len;
+    region = memalloc(regionlen + 1);
+    memcpy(region, doc->text + regionstart, start - regionstart);
+    memcpy(region + start - regionstart, s, len);
+    memcpy(region + start - regionstart + len, doc->text + end,
+            regionend - end);
+    /* Edit the document text. */
+    if (newlen + 1 > doc->max) {
+        while (newlen + 1 > doc->max)
+            doc->max = doc->max ? 2 * doc->max : 4096;
+        doc->text = memrealloc(doc->text, doc->max);
+    }
+    memmove(doc->text + start + len, doc->text + end, doc->len - end + 1);
+    memcpy(doc->text + start, s, len);
+    doc->len = newlen;
+    replaceunits(doc, first, count, region, regionlen);
+}
+
+/***********************************************************************
+ * finddocument : find an open document
+ *
+ * Enter:   params = params of a textDocument request or notification
+ *
+ * Return:  document, 0 if not open
+ */
+static struct document *
+finddocument(const struct json *params)
+{
+    const struct json *uri = jsonmember(jsonmember(params, "textDocument"),
+            "uri");
+    struct document *doc;
+    if (!uri || uri->type != JSON_STRING)
+        return 0;
+    for (doc = documents; doc; doc = doc->next) {
+        if (!strcmp(doc->uri, uri->string))
+            return doc;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * closedocument : free a document and remove it from the open list
+ *
+ * Enter:   doc = document
+ */
+static void
+closedocument(struct document *doc)
+{
+    struct document **pdoc = &documents;
+    while (*pdoc != doc)
+        pdoc = &(*pdoc)->next;
+    *pdoc = doc->next;
+    while (doc->nunits)
+        freeunit(doc->units[--doc->nunits]);
+    if (doc->units)
+        memfree(doc->units);
+    if (doc->text)
+        memfree(doc->text);
+    memfree(doc->uri);
+    memfree(doc);
+}
+
+/***********************************************************************
+ * publishdiagnostics : send the errors in a document
+ *
+ * Enter:   doc = document
+ *          uri = document's uri
+ *
+ * Each error is reported for the whole of its line, as the error
+ * messages give only a line number.
+ */
+static void
+publishdiagnostics(const struct document *doc, const char *uri)
+{
+    size_t i;
+    int comma = 0;
+    addf("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+            "\"params\":{\"uri\":");
+    addstring(uri, strlen(uri));
+    addf(",\"diagnostics\":[");
+    for (i = 0; doc && i != doc->nunits; i++) {
+        const struct unit *unit = doc->units[i];
+        unsigned long long line = unit->line - 1 + unit->errorline;
+        if (!unit->error)
+            continue;
+        addf("%s{\"range\":{\"start\":{\"line\":%llu,\"character\":0},"
+                "\"end\":{\"line\":%llu,\"character\":0}},"
+                "\"severity\":1,\"source\":\"widlproc\",\"message\":",
+                comma ? "," : "", line, line + 1);
+        addstring(unit->error, strlen(unit->error));
+        addf("}");
+        comma = 1;
+    }
+    addf("]}}");
+    sendmessage();
+}
+
+/***********************************************************************
+ * findidentifier : find the identifier at a position in a document
+ *
+ * Enter:   params = params of a textDocument/definition or
+ *                   textDocument/references request
+ *          plen = where to store the length of the identifier
+ *
+ * Return:  the identifier in the document text, 0 if none
+ */
+static const char *
+findidentifier(const struct json *params, size_t *plen)
+{
+    struct document *doc = finddocument(params);
+    size_t start, end;
+    if (!doc)
+        return 0;
+    start = end = positionoffset(doc, jsonmember(params, "position"));
+    while (start && isidchar(doc->text[start - 1]))
+        start--;
+    while (end != doc->len && isidchar(doc->text[end]))
+        end++;
+    if (start == end)
+        return 0;
+    *plen = end - start;
+    return doc->text + start;
+}
+
+/***********************************************************************
+ * findname : find the name index entries for the identifier at a
+ *            position in a document
+ *
+ * Enter:   params = params of a textDocument/references request
+ *
+ * Return:  first entry for the identifier, 0 if none
+ */
+static struct name *
+findname(const struct json *params)
+{
+    size_t len;
+    const char *id = findidentifier(params, &len);
+    return id ? hashget(&nameindex, id, len) : 0;
+}
+
+/***********************************************************************
+ * findunit : find the unit whose parse tree a node is in
+ *
+ * Enter:   node = node in the tree of a unit
+ *
+ * Return:  unit, 0 if none
+ */
+static struct unit *
+findunit(struct node *node)
+{
+    struct document *doc;
+    size_t i;
+    while (node->parent)
+        node = node->parent;
+    for (doc = documents; doc; doc = doc->next) {
+        for (i = 0; i != doc->nunits; i++) {
+            if (doc->units[i]->root == node)
+                return doc->units[i];
+        }
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * adddefinitions : append an array of the locations of the definitions
+ *                  of the identifier at a position in a document
+ *
+ * Enter:   params = params of a textDocument/definition request
+ *
+ * The definitions are found in the symbol table by the fully qualified
+ * id of a top-level definition with that name, so there is one for each
+ * partial definition as well as for the definition itself, in each open
+ * document.
+ */
+static void
+adddefinitions(const struct json *params)
+{
+    size_t len;
+    const char *id = findidentifier(params, &len);
+    char *fqid;
+    struct node *node;
+    int comma = 0;
+    addf("[");
+    if (!id) {
+        addf("]");
+        return;
+    }
+    fqid = memprintf("::%.*s", (int)len, id);
+    for (node = findsymbol(fqid); node; node = node->nextsymbol) {
+        struct unit *unit = findunit(node);
+        const char *p;
+        if (!unit || !node->wsstart)
+            continue;
+        p = finddefname(node, node->id);
+        if (comma)
+            addf(",");
+        addlocation(unit, p - unit->text, p - unit->text + len);
+        comma = 1;
+    }
+    memfree(fqid);
+    addf("]");
+}
+
+/***********************************************************************
+ * addlocations : append an array of the locations of some names to the
+ *                message being built
+ *
+ * Enter:   name = first index entry for an identifier, or 0
+ *          defs = whether to include definitions
+ *          refs = whether to include references
+ */
+static void
+addlocations(const struct name *name, int defs, int refs)
+{
+    int comma = 0;
+    addf("[");
+    for (; name; name = name->next) {
+        if (name->isdef ? defs : refs) {
+            if (comma)
+                addf(",");
+            addlocation(name->unit, name->start, name->end);
+            comma = 1;
+        }
+    }
+    addf("]");
+}
+
+/***********************************************************************
+ * didopen, didchange, didclose : handle document notifications
+ *
+ * Enter:   params = params of notification
+ */
+static void
+didopen(const struct json *params)
+{
+    const struct json *textdoc = jsonmember(params, "textDocument");
+    const struct json *uri = jsonmember(textdoc, "uri");
+    const struct json *text = jsonmember(textdoc, "text");
+    struct document *doc;
+    if (!uri || uri->type != JSON_STRING || !text
+            || text->type != JSON_STRING)
+    {
+        return;
+    }
+    doc = finddocument(params);
+    if (doc)
+        closedocument(doc);
+    doc = memalloc(sizeof(struct document));
+    doc->uri = memprintf("%s", uri->string);
+    doc->next = documents;
+    documents = doc;
+    doc->max = text->len + 1;
+    doc->text = memalloc(doc->max);
+    editdocument(doc, 0, 0, text->string, text->len);
+    publishdiagnostics(doc, doc->uri);
+}
+
+static void
+didchange(const struct json *params)
+{
+    struct document *doc = finddocument(params);
+    const struct json *change;
+    if (!doc)
+        return;
+    change = jsonmember(params, "contentChanges");
+    for (change = change ? change->children : 0; change;
+            change = change->next)
+    {
+        const struct json *range = jsonmember(change, "range");
+        const struct json *text = jsonmember(change, "text");
+        size_t start = 0, end = doc->len;
+        if (!text || text->type != JSON_STRING)
+            continue;
+        if (range) {
+            start = positionoffset(doc, jsonmember(range, "start"));
+            end = positionoffset(doc, jsonmember(range, "end"));
+            if (end < start)
+                end = start;
+        }
+        editdocument(doc, start, end, text->string, text->len);
+    }
+    publishdiagnostics(doc, doc->uri);
+}
+
+static void
+didclose(const struct json *params)
+{
+    struct document *doc = finddocument(params);
+    if (doc) {
+        /* Clear its diagnostics. */
+        publishdiagnostics(0, doc->uri);
+        closedocument(doc);
+    }
+}
+
+/***********************************************************************
+ * lspserver : run as a language server on stdin and stdout
+ *
+ * This does not return. It exits when told to by the client, or at the
+ * end of the input.
+ */
+void
+lspserver(void)
+{
+    struct json *request;
+    int shutdown = 0;
+#ifdef _MSC_VER
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    while ((request = readmessage())) {
+        const struct json *method = jsonmember(request, "method");
+        const struct json *id = jsonmember(request, "id");
+        const struct json *params = jsonmember(request, "params");
+        const char *name = method && method->type == JSON_STRING
+                ? method->string : "";
+        if (!strcmp(name, "initialize")) {
+            startresponse(id, "result");
+            addf("{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,"
+                    "\"change\":2},\"definitionProvider\":true,"
+                    "\"referencesProvider\":true},"
+                    "\"serverInfo\":{\"name\":\"widlproc\"}}}");
+            sendmessage();
+        } else if (!strcmp(name, "shutdown")) {
+            shutdown = 1;
+            startresponse(id, "result");
+            addf("null}");
+            sendmessage();
+        } else if (!strcmp(name, "exit"))
+            exit(!shutdown);
+        else if (!strcmp(name, "textDocument/didOpen"))
+            didopen(params);
+        else if (!strcmp(name, "textDocument/didChange"))
+            didchange(params);
+        else if (!strcmp(name, "textDocument/didClose"))
+            didclose(params);
+        else if (!strcmp(name, "textDocument/definition")) {
+            startresponse(id, "result");
+            adddefinitions(params);
+            addf("}");
+            sendmessage();
+        } else if (!strcmp(name, "textDocument/references")) {
+            const struct json *include = jsonmember(jsonmember(params,
+                    "context"), "includeDeclaration");
+            startresponse(id, "result");
+            addlocations(findname(params),
+                    include && include->type == JSON_TRUE, 1);
+            addf("}");
+            sendmessage();
+        } else if (id) {
+            startresponse(id, "error");
+            addf("{\"code\":-32601,\"message\":\"method not found\"}}");
+            sendmessage();
+        }
+        freejson(request);
+    }
+    exit(1);
+}
@@ -12,21 +12,64 @@
  * limitations under the License.
  ***********************************************************************/
 #include <string.h>
+#include "diff.h"
+#include "exposure.h"
+#include "lsp.h"
 #include "misc.h"
 #include "process.h"
+#include "watch.h"
 
 static const char nodtdopt[] = "-no-dtd-ref";
+static const char webidloffsetsopt[] = "-webidl-offsets";
+static const char streamopt[] = "-stream";
+static const char formatopt[] = "-format=";
+static const char mergeopt[] = "-merge-partials";
+static const char flattenopt[] = "-flatten";
+static const char resolveopt[] = "-resolve-typedefs";
+static const char unionsopt[] = "-flatten-unions";
+static const char overloadsopt[] = "-overloads";
+static const char exposureopt[] = "-exposure";
+static const char exposedopt[] = "-exposed=";
+static const char extattrsopt[] = "-extattr-index";
+static const char depsopt[] = "-deps=";
+static const char checkbinaryopt[] = "-check-binary=";
+static const char watchopt[] = "-watch=";
+static const char lspopt[] = "-lsp";
+static const char diffopt[] = "-diff";
 const char *progname;
 
+/* The options setting each PROCESS_WHOLETREE flag, for the message when
+ * one is used with -stream or -watch. */
+static const struct {
+    unsigned int flag;
+    const char *opt;
+} wholetreeopts[] = {
+    { PROCESS_MERGEPARTIALS, mergeopt },
+    { PROCESS_FLATTEN, flattenopt },
+    { PROCESS_RESOLVETYPEDEFS, resolveopt },
+    { PROCESS_FLATTENUNIONS, unionsopt },
+    { PROCESS_OVERLOADS, overloadsopt },
+    { PROCESS_EXPOSURE, "-exposure or -exposed=" },
+    { PROCESS_EXTATTRS, extattrsopt },
+    { PROCESS_DEPS, depsopt },
+};
+
 /***********************************************************************
  * options : process command line options
  *
  * Enter:   argv
+ *          pflags = where to store PROCESS_* flags
+ *          pwatch = where to store output filename for watch mode, 0 if
+ *                   not watching
+ *          pcheck = where to store binary file to check, 0 if none
+ *          plsp = where to store whether to run as a language server
+ *          pdiff = where to store whether to diff two sets of files
  *
  * Return:  argv stepped to point to first non-option argument
  */
 static const char *const *
-options(int argc, const char *const *argv)
+options(int argc, const char *const *argv, unsigned int *pflags,
+        const char **pwatch, const char **pcheck, int *plsp, int *pdiff)
 {
     /* Set progname for error messages etc. */
     {
@@ -43,8 +86,119 @@ options(int argc, const char *const *argv)
         if (base)
             progname = base + 1;
     }
-    return (argc > 1 && strncmp(argv[1], nodtdopt, sizeof nodtdopt) == 0)
-          ? argv + 2 : argv + 1;
+    *pflags = PROCESS_DTDREF;
+    *pwatch = 0;
+    *pcheck = 0;
+    *plsp = 0;
+    *pdiff = 0;
+    for (argv++; *argv && **argv == '-' && (*argv)[1]; argv++) {
+        /* Accept --option as well as -option. */
+        const char *opt = *argv + ((*argv)[1] == '-');
+        if (!strcmp(opt, nodtdopt))
+            *pflags &= ~PROCESS_DTDREF;
+        else if (!strcmp(opt, webidloffsetsopt))
+            *pflags |= PROCESS_WEBIDLOFFSETS;
+        else if (!strcmp(opt, streamopt))
+            *pflags |= PROCESS_STREAM;
+        else if (!strcmp(opt, mergeopt))
+            *pflags |= PROCESS_MERGEPARTIALS;
+        else if (!strcmp(opt, flattenopt))
+            *pflags |= PROCESS_FLATTEN;
+        else if (!strcmp(opt, resolveopt))
+            *pflags |= PROCESS_RESOLVETYPEDEFS;
+        else if (!strcmp(opt, unionsopt))
+            *pflags |= PROCESS_FLATTENUNIONS;
+        else if (!strcmp(opt, overloadsopt))
+            *pflags |= PROCESS_OVERLOADS;
+        else if (!strcmp(opt, exposureopt))
+            *pflags |= PROCESS_EXPOSURE;
+        else if (!strncmp(opt, exposedopt, sizeof(exposedopt) - 1)) {
+            const char *global = opt + sizeof(exposedopt) - 1;
+            if (!*global)
+                errorexit("%s needs a global name", exposedopt);
+            setexposedglobal(global);
+            *pflags |= PROCESS_EXPOSURE;
+        }
+        else if (!strcmp(opt, extattrsopt))
+            *pflags |= PROCESS_EXTATTRS;
+        else if (!strncmp(opt, depsopt, sizeof(depsopt) - 1)) {
+            const char *format = opt + sizeof(depsopt) - 1;
+            if (!strcmp(format, "json"))
+                *pflags = (*pflags | PROCESS_DEPS) & ~PROCESS_DEPSDOT;
+            else if (!strcmp(format, "dot"))
+                *pflags |= PROCESS_DEPS | PROCESS_DEPSDOT;
+            else
+                errorexit("unknown dependency format %s", format);
+        }
+        else if (!strncmp(opt, formatopt, sizeof(formatopt) - 1)) {
+            const char *format = opt + sizeof(formatopt) - 1;
+            *pflags &= ~(PROCESS_BINARY | PROCESS_EVENTS);
+            if (!strcmp(format, "binary"))
+                *pflags |= PROCESS_BINARY;
+            else if (!strcmp(format, "events"))
+                *pflags |= PROCESS_EVENTS;
+            else if (strcmp(format, "xml"))
+                errorexit("unknown format %s", format);
+        } else if (!strncmp(opt, checkbinaryopt, sizeof(checkbinaryopt) - 1)) {
+            *pcheck = opt + sizeof(checkbinaryopt) - 1;
+            if (!**pcheck)
+                errorexit("%s needs a filename", checkbinaryopt);
+        } else if (!strncmp(opt, watchopt, sizeof(watchopt) - 1)) {
+            *pwatch = opt + sizeof(watchopt) - 1;
+            if (!**pwatch)
+                errorexit("%s needs an output filename", watchopt);
+        } else if (!strcmp(opt, lspopt))
+            *plsp = 1;
+        else if (!strcmp(opt, diffopt))
+            *pdiff = 1;
+        else
+            errorexit("unknown option %s", *argv);
+    }
+    if ((*pflags & PROCESS_STREAM) && (*pflags & PROCESS_WEBIDLOFFSETS))
+        errorexit("%s cannot be used with %s", streamopt, webidloffsetsopt);
+    if ((*pflags & (PROCESS_BINARY | PROCESS_EVENTS))
+            && (*pflags & (PROCESS_STREAM | PROCESS_WEBIDLOFFSETS)))
+    {
+        errorexit("%s%s cannot be used with %s or %s", formatopt,
+                *pflags & PROCESS_BINARY ? "binary" : "events", streamopt,
+                webidloffsetsopt);
+    }
+    if (*pwatch && (*pflags & (PROCESS_STREAM | PROCESS_WEBIDLOFFSETS
+            | PROCESS_BINARY | PROCESS_EVENTS)))
+    {
+        errorexit("%s cannot be used with %s, %s or %sbinary|events",
+                watchopt, streamopt, webidloffsetsopt, formatopt);
+    }
+    if ((*pflags & PROCESS_WHOLETREE)
+            && ((*pflags & (PROCESS_STREAM | PROCESS_EVENTS)) || *pwatch))
+    {
+        unsigned int i;
+        for (i = 0; !(*pflags & wholetreeopts[i].flag); i++)
+            ;
+        errorexit("%s cannot be used with %s", wholetreeopts[i].opt,
+                *pwatch ? watchopt : *pflags & PROCESS_STREAM ? streamopt
+                : "-format=events");
+    }
+    if ((*pflags & PROCESS_DEPS) && (*pflags & PROCESS_BINARY))
+        errorexit("%s cannot be used with %sbinary", depsopt, formatopt);
+    if (*pcheck && (*pwatch || (*pflags & (PROCESS_STREAM
+            | PROCESS_WEBIDLOFFSETS | PROCESS_BINARY | PROCESS_EVENTS
+            | PROCESS_DEPS))))
+    {
+        errorexit("%s cannot be used with %s, %s, %sbinary|events, %s or %s",
+                checkbinaryopt, streamopt, webidloffsetsopt, formatopt,
+                depsopt, watchopt);
+    }
+    if (*plsp && (*argv || *pwatch || *pcheck || (*pflags & ~PROCESS_DTDREF)))
+        errorexit("%s takes no files and no other options", lspopt);
+    if (*pdiff && (!argv[0] || !argv[1] || argv[2] || *pwatch || *pcheck
+            || *plsp
+            || (*pflags & ~PROCESS_DTDREF)))
+    {
+        errorexit("%s takes two files or directories and no other options",
+                diffopt);
+    }
+    return argv;
 }
 
 /***********************************************************************
@@ -54,10 +208,35 @@ int
 main(int argc, char **argv)
 {
     const char *const *parg;
-    parg = options(argc, (const char *const *)argv);
+    const char *watch, *check;
+    unsigned int flags;
+    int lsp, diff;
+    parg = options(argc, (const char *const *)argv, &flags, &watch, &check,
+            &lsp, &diff);
+    if (lsp)
+        lspserver();
+    if (diff) {
+        diffinputs(parg[0], parg[1]);
+        return 0;
+    }
     if (!*parg)
-        errorexit("usage: %s [-no-dtd-ref] <interface>.widl ...", progname);
-    processfiles(parg, parg == (const char *const *)argv + 1);
+        errorexit("usage: %s [-no-dtd-ref] [-webidl-offsets | -stream]"
+                " [-format=xml|binary|events]\n"
+                "       [-merge-partials] [-flatten] [-resolve-typedefs]"
+                " [-flatten-unions]\n"
+                "       [-overloads] [-exposure | -exposed=<global>]"
+                " [-extattr-index]\n"
+                "       [-deps=json|dot] [-check-binary=<file>]"
+                " [-watch=<output>]\n"
+                "       <interface>.widl ...\n"
+                "       %s -lsp\n"
+                "       %s -diff <old> <new>", progname, progname, progname);
+    if (check) {
+        checkbinary(parg, check, flags);
+        return 0;
+    }
+    if (watch)
+        watchfiles(parg, watch, flags);
+    processfiles(parg, flags);
     return 0;
 }
-
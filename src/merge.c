@@ -0,0 +1,252 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Merging of partial interfaces and dictionaries
+ ***********************************************************************/
+#include <string.h>
+#include "comment.h"
+#include "hash.h"
+#include "lex.h"
+#include "merge.h"
+#include "misc.h"
+#include "node.h"
+
+/***********************************************************************
+ * ismergeable : test whether a definition is an interface or dictionary
+ *
+ * Enter:   node = definition element
+ *
+ * Return:  non-zero if a partial definition of its kind can be merged
+ */
+static int
+ismergeable(struct node *node)
+{
+    int name = ((struct element *)node)->name;
+    return name == NAME_Interface || name == NAME_Dictionary;
+}
+
+/***********************************************************************
+ * kindname : get the Web IDL keyword for an interface or dictionary
+ */
+static const char *
+kindname(struct node *node)
+{
+    return ((struct element *)node)->name == NAME_Dictionary
+            ? "dictionary" : "interface";
+}
+
+/***********************************************************************
+ * findextattr : find an extended attribute in a list by name
+ *
+ * Enter:   list = ExtendedAttributeList element
+ *          name = name to find
+ *
+ * Return:  ExtendedAttribute element, 0 if none
+ */
+static struct node *
+findextattr(struct node *list, const char *name)
+{
+    struct node *attr;
+    for (attr = nextelement(list->children); attr;
+            attr = nextelement(attr->next))
+    {
+        if (!strcmp(getattr(attr, NAME_name), name))
+            break;
+    }
+    return attr;
+}
+
+/***********************************************************************
+ * inheritextattrs : give a member the extended attributes of the
+ *                   partial definition it was in
+ *
+ * Enter:   member = member element
+ *          eal = ExtendedAttributeList element of the partial definition
+ *
+ * An extended attribute such as [Exposed] on a partial definition
+ * applies to each of its members, so once they are moved out of it
+ * they each get a copy, before their own. A member's own extended
+ * attribute of the same name takes precedence, so is kept instead.
+ */
+static void
+inheritextattrs(struct node *member, struct node *eal)
+{
+    struct node *list = nextelement(member->children);
+    struct node *attr, *first = 0, *last = 0;
+    if (!list || ((struct element *)list)->name != NAME_ExtendedAttributeList)
+    {
+        /* Make an empty list as the member's first child. */
+        list = newelement(NAME_ExtendedAttributeList);
+        list->parent = member;
+        list->next = member->children;
+        member->children = list;
+        if (!list->next)
+            member->lastchild = list;
+    }
+    for (attr = nextelement(eal->children); attr;
+            attr = nextelement(attr->next))
+    {
+        struct node *copy;
+        if (findextattr(list, getattr(attr, NAME_name)))
+            continue;
+        copy = copynode(attr);
+        copy->parent = list;
+        indexextattr(list, copy);
+        if (last)
+            last->next = copy;
+        else
+            first = copy;
+        last = copy;
+    }
+    if (first) {
+        last->next = list->children;
+        if (!list->children)
+            list->lastchild = last;
+        list->children = first;
+    }
+}
+
+/***********************************************************************
+ * mergepartial : move the members of a partial definition into the
+ *                definition it extends
+ *
+ * Enter:   node = definition to merge into
+ *          partial = partial definition
+ *
+ * The members are appended in order, keeping their Web IDL spans and
+ * comments. The partial definition's own comments are appended to those
+ * of the definition. What is left of the partial definition (its name
+ * and extended attributes) is for the caller to free.
+ */
+static void
+mergepartial(struct node *node, struct node *partial)
+{
+    struct node **pchild = &partial->children, *child, *last = 0, *eal = 0;
+    while ((child = *pchild)) {
+        if (child->type == NODE_ELEMENT) {
+            int name = ((struct element *)child)->name;
+            if (name == NAME_ExtendedAttributeList)
+                eal = child;
+            else if (name != NAME_InterfaceInheritance
+                    && name != NAME_DictionaryInheritance)
+            {
+                /* A member: move it. */
+                *pchild = child->next;
+                if (eal)
+                    inheritextattrs(child, eal);
+                addnode(node, child);
+                continue;
+            }
+        }
+        last = child;
+        pchild = &child->next;
+    }
+    partial->lastchild = last;
+    movecomments(partial, node);
+}
+
+/***********************************************************************
+ * checkmembers : check a merged definition for duplicate members
+ *
+ * Enter:   node = interface or dictionary element
+ */
+static void
+checkmembers(struct node *node)
+{
+    struct hashtable members = { 0, 0, 0 };
+    struct node *member;
+    for (member = nextelement(node->children); member;
+            member = nextelement(member->next))
+    {
+        checkduplicate(&members, member, node);
+    }
+    hashfree(&members);
+}
+
+/***********************************************************************
+ * mergepartials : merge each partial interface and dictionary into the
+ *                 definition it extends
+ *
+ * Enter:   root = root of parse tree, after processcomments
+ *
+ * The definitions are indexed by name, then each partial definition's
+ * members are moved into the definition of that name and the partial
+ * definition removed, so the whole merge is one pass over the
+ * definitions. A partial definition with nothing to extend, and a
+ * member that clashes with another once merged, are errors.
+ */
+void
+mergepartials(struct node *root)
+{
+    struct hashtable definitions = { 0, 0, 0 }, merged = { 0, 0, 0 };
+    struct node **pnode, *node, *last = 0, **nodes = 0;
+    unsigned int count = 0, max = 0, i;
+    /* Index the definitions that can be extended. */
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *name = getattr(node, NAME_name);
+        void **pvalue;
+        if (!ismergeable(node) || getattr(node, NAME_partial))
+            continue;
+        pvalue = hashput(&definitions, name, strlen(name));
+        if (!*pvalue)
+            *pvalue = node;
+    }
+    /* Merge and remove each partial definition. */
+    pnode = &root->children;
+    while ((node = *pnode)) {
+        const char *name;
+        struct node *target;
+        void **pvalue;
+        if (node->type != NODE_ELEMENT || !ismergeable(node)
+                || !getattr(node, NAME_partial))
+        {
+            last = node;
+            pnode = &node->next;
+            continue;
+        }
+        name = getattr(node, NAME_name);
+        target = hashget(&definitions, name, strlen(name));
+        if (!target || ((struct element *)target)->name
+                != ((struct element *)node)->name)
+        {
+            nodeerrorexit(node, "no %s %s for partial %s to extend",
+                    kindname(node), name, kindname(node));
+        }
+        mergepartial(target, node);
+        setnodesmoved();
+        /* Remember each merged definition once, in order. The key is
+         * its own name, as the partial definition's is about to be
+         * freed. */
+        name = getattr(target, NAME_name);
+        pvalue = hashput(&merged, name, strlen(name));
+        if (!*pvalue) {
+            *pvalue = target;
+            if (count == max) {
+                max = max ? 2 * max : 16;
+                nodes = memrealloc(nodes, max * sizeof(struct node *));
+            }
+            nodes[count++] = target;
+        }
+        *pnode = node->next;
+        freenode(node);
+    }
+    root->lastchild = last;
+    for (i = 0; i != count; i++)
+        checkmembers(nodes[i]);
+    if (nodes)
+        memfree(nodes);
+    hashfree(&merged);
+    hashfree(&definitions);
+}
@@ -20,6 +20,12 @@
 
 extern const char *progname;
 
+/* If set, where errors jump to after printing the message, and the
+ * message and line number of the last error that jumped. */
+static jmp_buf *errorjmp;
+static char *errormessage;
+static size_t errorlinenum;
+
 /***********************************************************************
  * memory allocation wrappers
  */
@@ -46,7 +52,7 @@ memrealloc(void *ptr, size_t size)
 void
 memfree(void *ptr)
 {
-    *(int *)ptr = 0xfefefefe;
+    *(char *)ptr = (char)0xfe;
     free(ptr);
 }
 
@@ -84,22 +90,63 @@ vmemprintf(const char *format, va_list ap)
     return buf;
 }
 
+/***********************************************************************
+ * seterrorjmp : make errors jump instead of exiting
+ *
+ * Enter:   jmp = where errorexit and friends longjmp to (with value 1)
+ *                after printing the message, 0 to make them exit again
+ *
+ * Whatever was being built when the error happened is abandoned, so
+ * this is only for a caller that can carry on without it.
+ */
+void
+seterrorjmp(jmp_buf *jmp)
+{
+    errorjmp = jmp;
+}
+
+/***********************************************************************
+ * lasterror : get the last error that jumped
+ *
+ * Enter:   plinenum = where to store its line number, 0 if none
+ *
+ * Return:  its message, without filename and line number, valid until
+ *          the next error
+ */
+const char *
+lasterror(size_t *plinenum)
+{
+    *plinenum = errorlinenum;
+    return errormessage ? errormessage : "";
+}
+
 /***********************************************************************
  * errorexit : print error message then exit
  */
 void
-vlocerrorexit(const char *filename, unsigned int linenum,
+vlocerrorexit(const char *filename, size_t linenum,
         const char *format, va_list ap)
 {
+    if (errorjmp) {
+        va_list ap2;
+        if (errormessage)
+            memfree(errormessage);
+        va_copy(ap2, ap);
+        errormessage = vmemprintf(format, ap2);
+        va_end(ap2);
+        errorlinenum = linenum;
+    }
     if (filename)
-        linenum ? fprintf(stderr, "%s: %i: ", filename, linenum) : fprintf(stderr, "%s: ", filename);
+        linenum ? fprintf(stderr, "%s: %llu: ", filename, (unsigned long long)linenum) : fprintf(stderr, "%s: ", filename);
     vfprintf(stderr, format, ap);
     fputc('\n', stderr);
+    if (errorjmp)
+        longjmp(*errorjmp, 1);
     exit(1);
 }
 
 void
-locerrorexit(const char *filename, unsigned int linenum,
+locerrorexit(const char *filename, size_t linenum,
         const char *format, ...)
 {
     va_list ap;
@@ -13,6 +13,7 @@
  ***********************************************************************/
 #ifndef misc_h
 #define misc_h
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdlib.h>
 
@@ -23,9 +24,11 @@ void memfree(void *ptr);
 char *vmemprintf(const char *format, va_list ap);
 char *memprintf(const char *format, ...);
 
-void vlocerrorexit(const char *filename, unsigned int linenum, const char *format, va_list ap);
-void locerrorexit(const char *filename, unsigned int linenum, const char *format, ...);
+void vlocerrorexit(const char *filename, size_t linenum, const char *format, va_list ap);
+void locerrorexit(const char *filename, size_t linenum, const char *format, ...);
 void errorexit(const char *format, ...);
+void seterrorjmp(jmp_buf *jmp);
+const char *lasterror(size_t *plinenum);
 
 #endif /* ndef misc_h */
 
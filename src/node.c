@@ -17,27 +17,210 @@
 #include <stdio.h>
 #include <string.h>
 #include "comment.h"
+#include "hash.h"
 #include "lex.h"
 #include "misc.h"
 #include "node.h"
 #include "process.h"
 
+static const char names[] = NAMES;
+static const char extattrnames[] = EXTATTRS;
+static struct hashtable atomtable, symbols;
+static const char **atomnames;
+static int atomcount, atommax;
+
+/* While lognodes is set, each node made is recorded in loggednodes, so
+ * freenodelog can free the nodes that a parse abandoned by an error
+ * left without a parent. */
+static int lognodes;
+static struct node **loggednodes;
+static unsigned int nloggednodes, maxloggednodes;
+
+/***********************************************************************
+ * addatom : add a name to the atom table
+ *
+ * Enter:   name = 0-terminated name, which must stay valid
+ *          len = length of name
+ *
+ * Return:  new atom
+ */
+static int
+addatom(const char *name, size_t len)
+{
+    if (atomcount == atommax) {
+        atommax = atommax ? 2 * atommax : 64;
+        atomnames = memrealloc(atomnames, atommax * sizeof(char *));
+    }
+    atomnames[atomcount] = name;
+    /* Atoms are stored plus one so a 0 value means not found. */
+    *hashput(&atomtable, name, len) = (void *)(size_t)(atomcount + 1);
+    return atomcount++;
+}
+
+/***********************************************************************
+ * initatoms : put the fixed names from NAMES into the atom table, so
+ *             they get the atoms NAME_*, then those from EXTATTRS, so
+ *             they get the atoms NAME_COUNT + EXTATTR_*
+ */
+static void
+initatoms(void)
+{
+    const char *p = names;
+    while (*p) {
+        unsigned int len = strlen(p);
+        addatom(p, len);
+        p += len + 1;
+    }
+    assert(atomcount == NAME_COUNT);
+    for (p = extattrnames; *p; p += strlen(p) + 1)
+        addatom(p, strlen(p));
+    assert(atomcount == NAME_COUNT + EXTATTR_COUNT);
+}
+
+/***********************************************************************
+ * intern : get the atom for an element or attribute name
+ *
+ * Enter:   name = name, which need not be 0-terminated
+ *          len = length of name
+ *
+ * Return:  atom
+ *
+ * A name not seen before is copied and given a new atom.
+ */
+int
+intern(const char *name, size_t len)
+{
+    void *value;
+    if (!atomcount)
+        initatoms();
+    value = hashget(&atomtable, name, len);
+    if (!value)
+        return addatom(memprintf("%.*s", (int)len, name), len);
+    return (int)(size_t)value - 1;
+}
+
+/***********************************************************************
+ * findatom : get the atom for a name without adding it
+ *
+ * Enter:   name = name, which need not be 0-terminated
+ *          len = length of name
+ *
+ * Return:  atom, -1 if the name has no atom
+ */
+int
+findatom(const char *name, size_t len)
+{
+    if (!atomcount)
+        initatoms();
+    return (int)(size_t)hashget(&atomtable, name, len) - 1;
+}
+
+/***********************************************************************
+ * atomname : get the name for an atom
+ *
+ * Enter:   atom
+ *
+ * Return:  0-terminated name
+ */
+const char *
+atomname(int atom)
+{
+    if (!atomcount)
+        initatoms();
+    assert(atom >= 0 && atom < atomcount);
+    return atomnames[atom];
+}
+
+/***********************************************************************
+ * lognode : record a new node if the node log is on
+ *
+ * Enter:   node = new node
+ */
+static void
+lognode(struct node *node)
+{
+    if (!lognodes)
+        return;
+    if (nloggednodes == maxloggednodes) {
+        maxloggednodes = maxloggednodes ? 2 * maxloggednodes : 256;
+        loggednodes = memrealloc(loggednodes,
+                maxloggednodes * sizeof(struct node *));
+    }
+    loggednodes[nloggednodes++] = node;
+}
+
+/***********************************************************************
+ * startnodelog : start recording the nodes made
+ *
+ * This is for around a parse whose errors do not exit, so that the
+ * nodes it made can be freed with freenodelog if it fails. While the
+ * log is on, addnode keeps the attrlists it empties rather than freeing
+ * them, so every logged node stays valid until the log ends.
+ */
+void
+startnodelog(void)
+{
+    lognodes = 1;
+    nloggednodes = 0;
+}
+
+/***********************************************************************
+ * endnodelog : stop recording nodes, keeping them
+ *
+ * The attrlists that addnode emptied are freed.
+ */
+void
+endnodelog(void)
+{
+    unsigned int i;
+    for (i = 0; i != nloggednodes; i++) {
+        struct node *node = loggednodes[i];
+        if (node->type == NODE_ATTRLIST && !node->children)
+            memfree(node);
+    }
+    lognodes = 0;
+    nloggednodes = 0;
+}
+
+/***********************************************************************
+ * freenodelog : stop recording nodes, freeing each one that has no
+ *               parent along with its descendants
+ *
+ * Every logged node is checked for a parent before any is freed, as
+ * freeing a tree frees logged nodes further on in the log.
+ */
+void
+freenodelog(void)
+{
+    unsigned int i, norphans = 0;
+    for (i = 0; i != nloggednodes; i++) {
+        if (!loggednodes[i]->parent)
+            loggednodes[norphans++] = loggednodes[i];
+    }
+    for (i = 0; i != norphans; i++)
+        freenode(loggednodes[i]);
+    lognodes = 0;
+    nloggednodes = 0;
+}
+
 struct node *
-newelement(const char *name)
+newelement(int name)
 {
     struct element *element = memalloc(sizeof(struct element));
     element->n.type = NODE_ELEMENT;
     element->name = name;
+    lognode(&element->n);
     return &element->n;
 }
 
 struct node *
-newattr(const char *name, const char *val)
+newattr(int name, const char *val)
 {
     struct attr *attr = memalloc(sizeof(struct attr));
     attr->n.type = NODE_ATTR;
     attr->name = name;
     attr->value = val;
+    lognode(&attr->n);
     return &attr->n;
 }
 
@@ -46,20 +229,34 @@ newattrlist(void)
 {
     struct attrlist *attrlist = memalloc(sizeof(struct attrlist));
     attrlist->n.type = NODE_ATTRLIST;
+    lognode(&attrlist->n);
     return &attrlist->n;
 }
 
+/***********************************************************************
+ * newallocattr : create an attr whose value is allocated
+ *
+ * Enter:   name = atom of name of attribute
+ *          val = allocated 0-terminated value, freed by freenode
+ */
+struct node *
+newallocattr(int name, char *val)
+{
+    struct node *node = newattr(name, val);
+    ((struct attr *)node)->ownsvalue = 1;
+    return node;
+}
+
 /***********************************************************************
  * addnode : add node as child of another node
  *
  * Enter:   parent node
  *          child node
  *
- * The children list is constructed backwards. This is fixed later with
- * a call to reversechildren.
+ * The child is appended to the end of the children list.
  *
  * If child is an attrlist, its children are added to parent and the
- * attrlist is freed.
+ * attrlist is freed, or just emptied if the node log is on.
  */
 void
 addnode(struct node *parent, struct node *child)
@@ -68,41 +265,168 @@ addnode(struct node *parent, struct node *child)
         return;
     if (child->type == NODE_ATTRLIST) {
         /* Add the attrs in the attrlist to parent. */
-        struct node *child2;
-        reversechildren(child);
-        child2 = child->children;
-        memfree(child);
+        struct node *child2 = child->children;
+        if (lognodes)
+            child->children = child->lastchild = 0;
+        else
+            memfree(child);
         while (child2) {
             struct node *next = child2->next;
             addnode(parent, child2);
             child2 = next;
         }
     } else {
-        child->next = parent->children;
-        parent->children = child;
+        child->next = 0;
+        if (parent->lastchild)
+            parent->lastchild->next = child;
+        else
+            parent->children = child;
+        parent->lastchild = child;
         child->parent = parent;
     }
 }
 
 /***********************************************************************
- * reversechildren : recursively reverse child lists
+ * copynode : copy a node and its descendants
+ *
+ * Enter:   node = root of tree to copy
  *
- * Also sets parent field on each node.
+ * Return:  copy, not attached to any parent
+ *
+ * The copy points at the same Web IDL text, and has its own copy of any
+ * allocated attribute value. Ids, comments and argument indexes are not
+ * copied; an extended attribute index is built afresh for the copy.
+ * This recurses, so it is for small trees such as an extended
+ * attribute.
+ */
+struct node *
+copynode(struct node *node)
+{
+    struct node *copy, *child;
+    if (node->type == NODE_ELEMENT) {
+        struct element *element = (void *)node, *elementcopy;
+        copy = newelement(element->name);
+        elementcopy = (void *)copy;
+        elementcopy->typeform = element->typeform;
+        if (element->constvalue) {
+            elementcopy->constvalue = memalloc(sizeof(struct constvalue));
+            *elementcopy->constvalue = *element->constvalue;
+        }
+        elementcopy->hash = element->hash;
+    } else {
+        struct attr *attr = (void *)node;
+        if (attr->ownsvalue)
+            copy = newallocattr(attr->name, memprintf("%s", attr->value));
+        else
+            copy = newattr(attr->name, attr->value);
+    }
+    copy->wsstart = node->wsstart;
+    copy->start = node->start;
+    copy->end = node->end;
+    for (child = node->children; child; child = child->next) {
+        struct node *childcopy = copynode(child);
+        addnode(copy, childcopy);
+        if (childcopy->type == NODE_ELEMENT
+                && ((struct element *)copy)->name == NAME_ExtendedAttributeList)
+        {
+            indexextattr(copy, childcopy);
+        }
+    }
+    return copy;
+}
+
+/***********************************************************************
+ * indexargument : add an argument to an element's argument index
+ *
+ * Enter:   node = element that owns the ArgumentList
+ *          arg = Argument element
+ *
+ * If more than one argument has the same name, the first one added is
+ * the one found by findparamidentifier.
  */
 void
-reversechildren(struct node *node)
+indexargument(struct node *node, struct node *arg)
 {
-    struct node *newlist = 0;
-    struct node *child = node->children;
-    while (child) {
-        struct node *next = child->next;
-        child->parent = node;
-        child->next = newlist;
-        newlist = child;
-        reversechildren(child);
-        child = next;
+    struct element *element = (void *)node;
+    const char *name = getattr(arg, NAME_name);
+    void **pvalue;
+    if (!name)
+        return;
+    if (!element->args)
+        element->args = memalloc(sizeof(struct hashtable));
+    pvalue = hashput(element->args, name, strlen(name));
+    if (!*pvalue)
+        *pvalue = arg;
+}
+
+/***********************************************************************
+ * extattrbit : get the bit for an extended attribute name
+ *
+ * Enter:   name = 0-terminated name of extended attribute
+ *
+ * Return:  EXTATTR_* bit, -1 if it is not one of those in EXTATTRS
+ *
+ * This is a hash lookup and a subtraction rather than a comparison
+ * with each known name. An unknown name is not added to the atom
+ * table, so looking one up does not grow it.
+ */
+int
+extattrbit(const char *name)
+{
+    int bit = findatom(name, strlen(name)) - NAME_COUNT;
+    return bit >= 0 && bit < EXTATTR_COUNT ? bit : -1;
+}
+
+/***********************************************************************
+ * indexextattr : add an extended attribute to a list's index
+ *
+ * Enter:   list = ExtendedAttributeList element
+ *          attr = ExtendedAttribute element in it
+ *
+ * An extended attribute not in EXTATTRS is not indexed. If more than
+ * one has the same name, the first one added is the one found by
+ * getextattr.
+ */
+void
+indexextattr(struct node *list, struct node *attr)
+{
+    struct element *element = (void *)list;
+    int bit = extattrbit(getattr(attr, NAME_name));
+    if (bit < 0 || element->extattrs & 1U << bit)
+        return;
+    if (!element->extattrnodes)
+        element->extattrnodes = memalloc(EXTATTR_COUNT * sizeof(struct node *));
+    element->extattrs |= 1U << bit;
+    element->extattrnodes[bit] = attr;
+}
+
+/***********************************************************************
+ * getextattr : get an indexed extended attribute of an element
+ *
+ * Enter:   node = element that can have an ExtendedAttributeList, such
+ *                 as a definition, member, argument or type
+ *          extattr = EXTATTR_* bit
+ *
+ * Return:  ExtendedAttribute element, whose children give its
+ *          arguments, 0 if none
+ *
+ * The ExtendedAttributeList is the first child element of all but a
+ * type, so finding it and then the extended attribute is O(1).
+ */
+struct node *
+getextattr(struct node *node, int extattr)
+{
+    struct node *list;
+    for (list = nextelement(node->children); list;
+            list = nextelement(list->next))
+    {
+        struct element *element = (void *)list;
+        if (element->name == NAME_ExtendedAttributeList) {
+            return element->extattrs & 1U << extattr
+                    ? element->extattrnodes[extattr] : 0;
+        }
     }
-    node->children = newlist;
+    return 0;
 }
 
 /***********************************************************************
@@ -134,22 +458,175 @@ nodewalk(struct node *node)
     return node->next;
 }
 
+/***********************************************************************
+ * nextelement : find an element in a child list
+ *
+ * Enter:   node = first node in list to look at, or 0
+ *
+ * Return:  first element at or after node in the list, 0 if none
+ */
+struct node *
+nextelement(struct node *node)
+{
+    while (node && node->type != NODE_ELEMENT)
+        node = node->next;
+    return node;
+}
+
+/***********************************************************************
+ * removesymbol : remove a node from the symbol table
+ *
+ * Enter:   node = node with fqid set
+ *
+ * If the node heads the list for its fqid, the table is keyed by its
+ * fqid, so the entry is rekeyed to the next node in the list.
+ */
+static void
+removesymbol(struct node *node)
+{
+    size_t len = strlen(node->fqid);
+    struct node *prev = hashget(&symbols, node->fqid, len);
+    if (prev != node) {
+        while (prev->nextsymbol != node)
+            prev = prev->nextsymbol;
+        prev->nextsymbol = node->nextsymbol;
+    } else {
+        hashremove(&symbols, node->fqid, len);
+        if (node->nextsymbol) {
+            *hashput(&symbols, node->nextsymbol->fqid, len)
+                    = node->nextsymbol;
+        }
+    }
+}
+
+/***********************************************************************
+ * freenode : free a node and all its descendants
+ *
+ * Enter:   node = root of tree to free, which must not be in the
+ *                 children list of a node that is still in use
+ *
+ * Each node's children are spliced onto the front of a list of nodes
+ * still to free, so the walk is iterative and needs no stack however
+ * deep the tree is.
+ */
+void
+freenode(struct node *node)
+{
+    struct node *list;
+    if (!node)
+        return;
+    node->next = 0;
+    list = node;
+    while (list) {
+        node = list;
+        list = node->next;
+        if (node->children) {
+            node->lastchild->next = list;
+            list = node->children;
+        }
+        freecomments(node->comments);
+        if (node->fqid) {
+            removesymbol(node);
+            memfree((void *)node->fqid);
+        }
+        switch (node->type) {
+        case NODE_ELEMENT:
+            {
+                struct element *element = (void *)node;
+                if (element->args) {
+                    hashfree(element->args);
+                    memfree(element->args);
+                }
+                if (element->extattrnodes)
+                    memfree(element->extattrnodes);
+                if (element->constvalue)
+                    memfree(element->constvalue);
+            }
+            break;
+        case NODE_ATTR:
+            {
+                struct attr *attr = (void *)node;
+                if (attr->ownsvalue)
+                    memfree((void *)attr->value);
+            }
+            break;
+        }
+        memfree(node);
+    }
+}
+
+/***********************************************************************
+ * setfqids : set the fully qualified id of each node that has an id
+ *
+ * Enter:   root = root of parse tree
+ *
+ * The fully qualified id of a node is the fully qualified id of its
+ * nearest ancestor with an id if any, then "::", then its own id, with
+ * xml escapes so it can be output directly. Each node is also entered
+ * in the symbol table under its fully qualified id. Where more than one
+ * node has the same fully qualified id, as with a partial interface or
+ * with the trees of more than one lsp unit, they are kept in a list in
+ * the order they were entered, which for one tree is document order.
+ */
+void
+setfqids(struct node *root)
+{
+    struct node *node;
+    for (node = root; node; node = nodewalk(node)) {
+        struct node *parent;
+        char *id;
+        void **pvalue;
+        if (!node->id)
+            continue;
+        /* Ancestors come first in the walk, so any ancestor with an id
+         * already has its fqid set. */
+        parent = node->parent;
+        while (parent && !parent->id)
+            parent = parent->parent;
+        id = memprinttext(node->id, strlen(node->id), 1);
+        node->fqid = memprintf("%s::%s", parent ? parent->fqid : "", id);
+        memfree(id);
+        pvalue = hashput(&symbols, node->fqid, strlen(node->fqid));
+        if (*pvalue) {
+            struct node *last = *pvalue;
+            while (last->nextsymbol)
+                last = last->nextsymbol;
+            last->nextsymbol = node;
+        } else
+            *pvalue = node;
+    }
+}
+
+/***********************************************************************
+ * findsymbol : find node by fully qualified id
+ *
+ * Enter:   fqid = fully qualified id, with xml escapes
+ *
+ * Return:  0 if not found, else the first node with that fqid, whose
+ *          nextsymbol field points to the next
+ */
+struct node *
+findsymbol(const char *fqid)
+{
+    return hashget(&symbols, fqid, strlen(fqid));
+}
+
 /***********************************************************************
  * findchildelement : find child element of a particular name
  *
  * Enter:   node = element
- *          name = name to find
+ *          name = atom of name to find
  *
  * Return:  0 else child element of that name
  */
 static struct node *
-findchildelement(struct node *node, const char *name)
+findchildelement(struct node *node, int name)
 {
     node = node->children;
     while (node) {
         if (node->type == NODE_ELEMENT) {
             struct element *element = (void *)node;
-            if (!strcmp(element->name, name))
+            if (element->name == name)
                 break;
         }
         node = node->next;
@@ -161,18 +638,18 @@ findchildelement(struct node *node, const char *name)
  * getattr : get value of attribute
  *
  * Enter:   node = element to find attribute in
- *          name = name of attribute
+ *          name = atom of name of attribute
  *
  * Return:  0 if not found, else 0-terminated string value
  */
 const char *
-getattr(struct node *node, const char *name)
+getattr(struct node *node, int name)
 {
     node = node->children;
     while (node) {
         if (node->type == NODE_ATTR) {
             struct attr *attr = (void *)node;
-            if (!strcmp(attr->name, name))
+            if (attr->name == name)
                 return attr->value;
         }
         node = node->next;
@@ -195,7 +672,7 @@ findchildelementwithnameattr(struct node *node, const char *name)
     node = node->children;
     while (node) {
         if (node->type == NODE_ELEMENT) {
-            const char *s = getattr(node, "name");
+            const char *s = getattr(node, NAME_name);
             if (s && !strcmp(s, name))
                 break;
         }
@@ -214,7 +691,7 @@ findchildelementwithnameattr(struct node *node, const char *name)
 struct node *
 findreturntype(struct node *node)
 {
-    return findchildelement(node, "Type");
+    return findchildelement(node, NAME_Type);
 }
 
 /***********************************************************************
@@ -224,14 +701,17 @@ findreturntype(struct node *node)
  *          name = parameter name to find
  *
  * Return:  0 if not found, else node struct for parameter identifier
+ *
+ * This uses the argument index built by indexargument while the
+ * ArgumentList was parsed, rather than searching the tree.
  */
 struct node *
 findparamidentifier(struct node *node, const char *name)
 {
-    node = findchildelement(node, "ArgumentList");
-    if (node)
-        node = findchildelementwithnameattr(node, name);
-    return node;
+    struct element *element = (void *)node;
+    if (!element->args)
+        return 0;
+    return hashget(element->args, name, strlen(name));
 }
 
 /***********************************************************************
@@ -246,11 +726,11 @@ findparamidentifier(struct node *node, const char *name)
 struct node *
 findthrowidentifier(struct node *node, const char *name)
 {
-    struct node *node2 = findchildelement(node, "Raises");
+    struct node *node2 = findchildelement(node, NAME_Raises);
     if (node2)
         node2 = findchildelementwithnameattr(node2, name);
     if (!node2) {
-        node2 = findchildelement(node, "SetRaises");
+        node2 = findchildelement(node, NAME_SetRaises);
         if (node2)
             node2 = findchildelementwithnameattr(node2, name);
     }
@@ -258,32 +738,170 @@ findthrowidentifier(struct node *node, const char *name)
 }
 
 /***********************************************************************
- * outputid : output the id of a node
+ * nodeerrorexit : error and exit with the location of a node
+ *
+ * Enter:   node = node with wsstart set, whose Web IDL the error is in
  */
-static void
-outputid(struct node *node)
+void
+nodeerrorexit(struct node *node, const char *format, ...)
+{
+    const char *filename;
+    size_t linenum;
+    va_list ap;
+    srclocation(node->wsstart, &filename, &linenum);
+    va_start(ap, format);
+    vlocerrorexit(filename, linenum, format, ap);
+    va_end(ap);
+}
+
+/***********************************************************************
+ * memberkey : get the key that a member is checked for duplicates by
+ *
+ * Enter:   member = member element
+ *
+ * Return:  its name, a key for a declaration that an interface can have
+ *          only one of, or 0 if it cannot be a duplicate
+ *
+ * The keys for declarations have a space in, so cannot clash with a
+ * member name.
+ */
+static const char *
+memberkey(struct node *member)
 {
-    if (node->parent)
-        outputid(node->parent);
-    if (node->id) {
-        fputs("::", stdout);
-        printtext(node->id, strlen(node->id), 1);
+    const char *name = getattr(member, NAME_name);
+    if (name)
+        return name;
+    switch (((struct element *)member)->name) {
+    case NAME_Iterable:
+        return "iterable declaration";
+    case NAME_MapLike:
+        return "maplike declaration";
+    case NAME_Serializer:
+        return "serializer declaration";
+    case NAME_Stringifier:
+        return "stringifier declaration";
     }
+    return 0;
 }
 
 /***********************************************************************
- * outputnode : output node and its children
+ * checkduplicate : check that a member or enum value is not the same as
+ *                  an earlier one in its definition or its partials
  *
- * Enter:   node = node to output, assumed to be an element
- *          indent
+ * Enter:   seen = hashtable of the earlier members or enum values of the
+ *                 definition and its partials, to which this one is added
+ *          node = member or EnumValue element, with wsstart set
+ *          definition = interface, dictionary or enum it is in
+ *
+ * Two members with the same name are allowed only if both are
+ * operations, and either both or neither are static, making them
+ * overloads. The error gives the location of both.
  */
 void
-outputnode(struct node *node, unsigned int indent)
+checkduplicate(struct hashtable *seen, struct node *node,
+               struct node *definition)
+{
+    int kind = ((struct element *)node)->name;
+    const char *key, *filename;
+    struct node *other;
+    size_t linenum;
+    void **pvalue;
+    if (kind == NAME_ExtendedAttributeList
+            || kind == NAME_InterfaceInheritance
+            || kind == NAME_DictionaryInheritance)
+    {
+        return;
+    }
+    key = kind == NAME_EnumValue ? getattr(node, NAME_stringvalue)
+            : memberkey(node);
+    if (!key)
+        return;
+    pvalue = hashput(seen, key, strlen(key));
+    other = *pvalue;
+    if (!other) {
+        *pvalue = node;
+        return;
+    }
+    if (kind == NAME_Operation
+            && ((struct element *)other)->name == NAME_Operation
+            && !getattr(node, NAME_static) == !getattr(other, NAME_static))
+    {
+        return;
+    }
+    srclocation(other->wsstart, &filename, &linenum);
+    if (kind == NAME_EnumValue) {
+        nodeerrorexit(node,
+                "duplicate value \"%s\" in enum %s, first at %s: %llu",
+                key, getattr(definition, NAME_name), filename,
+                (unsigned long long)linenum);
+    }
+    nodeerrorexit(node, strchr(key, ' ')
+            ? "duplicate %s in %s %s, first at %s: %llu"
+            : "duplicate member '%s' in %s %s, first at %s: %llu",
+            key, ((struct element *)definition)->name == NAME_Dictionary
+            ? "dictionary" : "interface", getattr(definition, NAME_name),
+            filename, (unsigned long long)linenum);
+}
+
+/***********************************************************************
+ * addextattrindex : add a known attribute to each ExtendedAttributeList
+ *
+ * Enter:   root = root of parse tree
+ *
+ * The attribute lists the names of the indexed extended attributes in
+ * the list, in EXTATTRS order, separated by spaces, so the extended
+ * attributes of anything can be told from one attribute. A list with
+ * none of them gets none.
+ */
+void
+addextattrindex(struct node *root)
+{
+    struct node *node;
+    for (node = root; node; node = nodewalk(node)) {
+        struct element *element = (void *)node;
+        const char *p;
+        char *s, *q;
+        size_t len = 0;
+        int bit;
+        if (node->type != NODE_ELEMENT
+                || element->name != NAME_ExtendedAttributeList
+                || !element->extattrs)
+        {
+            continue;
+        }
+        for (p = extattrnames, bit = 0; *p; p += strlen(p) + 1, bit++) {
+            if (element->extattrs & 1U << bit)
+                len += strlen(p) + 1;
+        }
+        q = s = memalloc(len);
+        for (p = extattrnames, bit = 0; *p; p += strlen(p) + 1, bit++) {
+            if (element->extattrs & 1U << bit) {
+                if (q != s)
+                    *q++ = ' ';
+                strcpy(q, p);
+                q += strlen(q);
+            }
+        }
+        addnode(node, newallocattr(NAME_known, s));
+    }
+}
+
+/***********************************************************************
+ * outputstarttag : output start of element
+ *
+ * Enter:   node = element to output
+ *          indent
+ *
+ * Return:  non-zero if the element has content, so its child elements
+ *          and end tag need to follow
+ */
+static int
+outputstarttag(struct node *node, unsigned int indent)
 {
     struct element *element = (void *)node;
     struct node *child;
     int empty = 1;
-    printf("%*s<%s", indent, "", element->name);
+    printf("%*s<%s", indent, "", atomname(element->name));
     child = element->n.children;
     while (child) {
         switch(child->type) {
@@ -293,7 +911,7 @@ outputnode(struct node *node, unsigned int indent)
         case NODE_ATTR:
             {
                 struct attr *attr = (void *)child;
-                printf(" %s=\"", attr->name);
+                printf(" %s=\"", atomname(attr->name));
                 printtext(attr->value, strlen(attr->value), 1);
                 printf("\"");
             }
@@ -301,31 +919,123 @@ outputnode(struct node *node, unsigned int indent)
         }
         child = child->next;
     }
-    if (node->id) {
-        printf(" id=\"");
-        outputid(node);
-        printf("\"");
-    }
+    if (node->fqid)
+        printf(" id=\"%s\"", node->fqid);
     if (!empty || node->comments || node->wsstart) {
+        size_t start, end;
         printf(">\n");
         if (node->wsstart) {
-            printf("%*s  <webidl>", indent, "");
-            outputwidl(node);
-            printf("</webidl>\n");
+            if (webidloffsets(node, &start, &end)) {
+                printf("%*s  <webidl start=\"%llu\" end=\"%llu\"/>\n", indent, "",
+                        (unsigned long long)start, (unsigned long long)end);
+            } else {
+                printf("%*s  <webidl>", indent, "");
+                outputwidl(node);
+                printf("</webidl>\n");
+            }
         }
         outputdescriptive(node, indent + 2);
-        child = element->n.children;
-        while (child) {
-            switch(child->type) {
-            case NODE_ELEMENT:
-                outputnode(child, indent + 2);
-                break;
+        if (!node->parent)
+            outputsource(indent + 2);
+        return 1;
+    }
+    printf("/>\n");
+    return 0;
+}
+
+/***********************************************************************
+ * outputnode : output node and its children
+ *
+ * Enter:   node = node to output, assumed to be an element
+ *          indent
+ *
+ * The walk is iterative, so a deep tree cannot overflow the stack.
+ */
+void
+outputnode(struct node *node, unsigned int indent)
+{
+    struct node *root = node, *next;
+    for (;;) {
+        /* Output the start of node and descend to its first child
+         * element. */
+        if (outputstarttag(node, indent)) {
+            next = nextelement(node->children);
+            if (next) {
+                node = next;
+                indent += 2;
+                continue;
             }
-            child = child->next;
+            printf("%*s</%s>\n", indent, "",
+                    atomname(((struct element *)node)->name));
         }
-        printf("%*s</%s>\n", indent, "", element->name);
-    } else
-        printf("/>\n");
+        /* Go to the next sibling element, closing ancestors as we
+         * climb. */
+        for (;;) {
+            if (node == root)
+                return;
+            next = nextelement(node->next);
+            if (next)
+                break;
+            node = node->parent;
+            indent -= 2;
+            printf("%*s</%s>\n", indent, "",
+                    atomname(((struct element *)node)->name));
+        }
+        node = next;
+    }
 }
 
+/***********************************************************************
+ * sendstartevents : send events for start of element and its attributes
+ *
+ * Enter:   node = element
+ *          events = callbacks
+ */
+static void
+sendstartevents(struct node *node, const struct nodeevents *events)
+{
+    struct node *child;
+    (*events->startelement)(events->context, ((struct element *)node)->name,
+            node->fqid);
+    for (child = node->children; child; child = child->next) {
+        if (child->type == NODE_ATTR) {
+            struct attr *attr = (void *)child;
+            (*events->attribute)(events->context, attr->name, attr->value);
+        }
+    }
+}
+
+/***********************************************************************
+ * sendevents : send events for element and its descendants
+ *
+ * Enter:   node = element
+ *          events = callbacks
+ *
+ * The walk is iterative, as outputnode.
+ */
+void
+sendevents(struct node *node, const struct nodeevents *events)
+{
+    struct node *root = node, *next;
+    for (;;) {
+        sendstartevents(node, events);
+        next = nextelement(node->children);
+        if (next) {
+            node = next;
+            continue;
+        }
+        (*events->endelement)(events->context, ((struct element *)node)->name);
+        for (;;) {
+            if (node == root)
+                return;
+            next = nextelement(node->next);
+            if (next)
+                break;
+            node = node->parent;
+            (*events->endelement)(events->context,
+                    ((struct element *)node)->name);
+        }
+        node = next;
+    }
+}
 
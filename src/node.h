@@ -13,6 +13,242 @@
  ***********************************************************************/
 #ifndef node_h
 #define node_h
+#include <stddef.h>
+
+/* Names of elements and attributes in the parse tree. Each one is
+ * identified by an atom; the NAME_ atoms must be in the same order as
+ * this list. Any other name, apart from those in EXTATTRS below, is
+ * given an atom from NAME_COUNT + EXTATTR_COUNT upwards when it is first
+ * interned. */
+#define NAMES \
+    "Argument\0" \
+    "ArgumentList\0" \
+    "Attribute\0" \
+    "Callback\0" \
+    "Const\0" \
+    "Definitions\0" \
+    "Dictionary\0" \
+    "DictionaryInheritance\0" \
+    "DictionaryMember\0" \
+    "EffectiveOverloads\0" \
+    "Enum\0" \
+    "EnumValue\0" \
+    "ExtendedAttribute\0" \
+    "ExtendedAttributeList\0" \
+    "FlattenedMembers\0" \
+    "FlattenedUnion\0" \
+    "Implements\0" \
+    "Interface\0" \
+    "InterfaceInheritance\0" \
+    "Iterable\0" \
+    "Key\0" \
+    "List\0" \
+    "Map\0" \
+    "MapLike\0" \
+    "Member\0" \
+    "Name\0" \
+    "Operation\0" \
+    "OverloadSet\0" \
+    "PatternAttribute\0" \
+    "Raises\0" \
+    "Serializer\0" \
+    "SetRaises\0" \
+    "Signature\0" \
+    "SignatureType\0" \
+    "Stringifier\0" \
+    "Type\0" \
+    "TypeList\0" \
+    "Typedef\0" \
+    "UnionMember\0" \
+    "Value\0" \
+    "attribute\0" \
+    "callback\0" \
+    "definition\0" \
+    "deleter\0" \
+    "distinguishing\0" \
+    "ellipsis\0" \
+    "exposure\0" \
+    "getter\0" \
+    "inherit\0" \
+    "kind\0" \
+    "known\0" \
+    "legacycaller\0" \
+    "length\0" \
+    "name\0" \
+    "name1\0" \
+    "name2\0" \
+    "normalized\0" \
+    "nullable\0" \
+    "optional\0" \
+    "optionality\0" \
+    "overload\0" \
+    "partial\0" \
+    "pattern\0" \
+    "readonly\0" \
+    "required\0" \
+    "resolved\0" \
+    "serializer\0" \
+    "setter\0" \
+    "static\0" \
+    "stringifier\0" \
+    "stringvalue\0" \
+    "type\0" \
+    "value\0"
+
+enum {
+    /* Elements */
+    NAME_Argument,
+    NAME_ArgumentList,
+    NAME_Attribute,
+    NAME_Callback,
+    NAME_Const,
+    NAME_Definitions,
+    NAME_Dictionary,
+    NAME_DictionaryInheritance,
+    NAME_DictionaryMember,
+    NAME_EffectiveOverloads,
+    NAME_Enum,
+    NAME_EnumValue,
+    NAME_ExtendedAttribute,
+    NAME_ExtendedAttributeList,
+    NAME_FlattenedMembers,
+    NAME_FlattenedUnion,
+    NAME_Implements,
+    NAME_Interface,
+    NAME_InterfaceInheritance,
+    NAME_Iterable,
+    NAME_Key,
+    NAME_List,
+    NAME_Map,
+    NAME_MapLike,
+    NAME_Member,
+    NAME_Name,
+    NAME_Operation,
+    NAME_OverloadSet,
+    NAME_PatternAttribute,
+    NAME_Raises,
+    NAME_Serializer,
+    NAME_SetRaises,
+    NAME_Signature,
+    NAME_SignatureType,
+    NAME_Stringifier,
+    NAME_Type,
+    NAME_TypeList,
+    NAME_Typedef,
+    NAME_UnionMember,
+    NAME_Value,
+    /* Attributes */
+    NAME_attribute,
+    NAME_callback,
+    NAME_definition,
+    NAME_deleter,
+    NAME_distinguishing,
+    NAME_ellipsis,
+    NAME_exposure,
+    NAME_getter,
+    NAME_inherit,
+    NAME_kind,
+    NAME_known,
+    NAME_legacycaller,
+    NAME_length,
+    NAME_name,
+    NAME_name1,
+    NAME_name2,
+    NAME_normalized,
+    NAME_nullable,
+    NAME_optional,
+    NAME_optionality,
+    NAME_overload,
+    NAME_partial,
+    NAME_pattern,
+    NAME_readonly,
+    NAME_required,
+    NAME_resolved,
+    NAME_serializer,
+    NAME_setter,
+    NAME_static,
+    NAME_stringifier,
+    NAME_stringvalue,
+    NAME_type,
+    NAME_value,
+    NAME_COUNT
+};
+
+/* Names of the extended attributes that are indexed in an
+ * ExtendedAttributeList. Each one has a bit; the EXTATTR_ bits must be in
+ * the same order as this list. Their names are interned straight after
+ * NAMES, so EXTATTR_x is the atom of x less NAME_COUNT. */
+#define EXTATTRS \
+    "AllowShared\0" \
+    "CEReactions\0" \
+    "Clamp\0" \
+    "Constructor\0" \
+    "Default\0" \
+    "EnforceRange\0" \
+    "Exposed\0" \
+    "Global\0" \
+    "LegacyArrayClass\0" \
+    "LegacyUnenumerableNamedProperties\0" \
+    "LenientSetter\0" \
+    "LenientThis\0" \
+    "NamedConstructor\0" \
+    "NewObject\0" \
+    "NoInterfaceObject\0" \
+    "OverrideBuiltins\0" \
+    "PrimaryGlobal\0" \
+    "PutForwards\0" \
+    "Replaceable\0" \
+    "SameObject\0" \
+    "SecureContext\0" \
+    "TreatNonObjectAsNull\0" \
+    "TreatNullAs\0" \
+    "Unforgeable\0" \
+    "Unscopable\0"
+
+enum {
+    EXTATTR_AllowShared,
+    EXTATTR_CEReactions,
+    EXTATTR_Clamp,
+    EXTATTR_Constructor,
+    EXTATTR_Default,
+    EXTATTR_EnforceRange,
+    EXTATTR_Exposed,
+    EXTATTR_Global,
+    EXTATTR_LegacyArrayClass,
+    EXTATTR_LegacyUnenumerableNamedProperties,
+    EXTATTR_LenientSetter,
+    EXTATTR_LenientThis,
+    EXTATTR_NamedConstructor,
+    EXTATTR_NewObject,
+    EXTATTR_NoInterfaceObject,
+    EXTATTR_OverrideBuiltins,
+    EXTATTR_PrimaryGlobal,
+    EXTATTR_PutForwards,
+    EXTATTR_Replaceable,
+    EXTATTR_SameObject,
+    EXTATTR_SecureContext,
+    EXTATTR_TreatNonObjectAsNull,
+    EXTATTR_TreatNullAs,
+    EXTATTR_Unforgeable,
+    EXTATTR_Unscopable,
+    EXTATTR_COUNT
+};
+
+/* struct constvalue : a const or default value, evaluated as it is
+ * parsed so that it need not be parsed again from its text; -diff
+ * compares numbers by it */
+enum {
+    VALUE_BOOLEAN, VALUE_NULL, VALUE_INTEGER, VALUE_UNSIGNED, VALUE_FLOAT,
+    VALUE_STRING, VALUE_SEQUENCE
+};
+struct constvalue {
+    int kind; /* VALUE_* */
+    union {
+        long long integer; /* VALUE_INTEGER, or VALUE_BOOLEAN as 0 or 1 */
+        unsigned long long uinteger; /* VALUE_UNSIGNED, above LLONG_MAX */
+        double number; /* VALUE_FLOAT, which can be infinite or NaN */
+    } u;
+};
 
 /* struct node : a node in the parse tree (excluding comments) */
 enum { NODE_ELEMENT, NODE_ATTR, NODE_ATTRLIST };
@@ -21,6 +257,7 @@ struct node {
     struct node *next;
     struct node *parent;
     struct node *children;
+    struct node *lastchild; /* so addnode can append in O(1) */
     struct comment *comments; /* list of comments attached to this node */
     /* If wsstart and end are set, they give the literal Web IDL that can
      * be output in a <webidl> element. */
@@ -31,35 +268,93 @@ struct node {
     const char *start;
     const char *end;
     const char *id;
+    /* If id is set, fqid is the fully qualified id with xml escapes,
+     * as output in the id attribute, set by setfqids. */
+    const char *fqid;
+    /* The next node with the same fqid, in the list findsymbol gives. */
+    struct node *nextsymbol;
 };
 
 struct element {
     struct node n;
-    const char *name;
+    int name; /* atom */
+    /* Index of the Argument children of this element's ArgumentList,
+     * keyed by argument name, built as the ArgumentList is parsed. */
+    struct hashtable *args;
+    /* For a Const, or an Argument or DictionaryMember with a default
+     * value, its value, set as it is parsed. */
+    struct constvalue *constvalue;
+    /* For a Type element, its interned structure, set by settypeforms. */
+    const struct typeform *typeform;
+    /* For an interface or member, the bitset of the globals it is
+     * exposed in, set by computeexposure. */
+    unsigned long long exposure;
+    /* For an ExtendedAttributeList element, the bitset of the indexed
+     * extended attributes in it (bit EXTATTR_x for x), and the first
+     * ExtendedAttribute element for each, indexed by EXTATTR_x, both
+     * built by indexextattr as the list is built. */
+    unsigned int extattrs;
+    struct node **extattrnodes;
+    /* Hash of the element's name and attributes and the hashes of its
+     * child elements, set by sethashes. */
+    unsigned long long hash;
 };
 
 struct attr {
     struct node n;
-    const char *name;
+    int name; /* atom */
     const char *value;
+    int ownsvalue; /* non-zero if value is allocated and freed with attr */
 };
 
 struct attrlist {
     struct node n;
 };
 
-struct node *newelement(const char *name);
-struct node *newattr(const char *name, const char *val);
+/* struct nodeevents : callbacks for sendevents and parsewithevents
+ *
+ * For each element, startelement is called with its atom and its fully
+ * qualified id (0 if none), then attribute for each of its attributes,
+ * then the events for its child elements, then endelement. */
+struct nodeevents {
+    void *context;
+    void (*startelement)(void *context, int name, const char *id);
+    void (*attribute)(void *context, int name, const char *value);
+    void (*endelement)(void *context, int name);
+};
+
+int intern(const char *name, size_t len);
+int findatom(const char *name, size_t len);
+const char *atomname(int atom);
+void startnodelog(void);
+void endnodelog(void);
+void freenodelog(void);
+struct node *newelement(int name);
+struct node *newattr(int name, const char *val);
+struct node *newallocattr(int name, char *val);
 struct node *newattrlist(void);
 void addnode(struct node *parent, struct node *child);
-void reversechildren(struct node *node);
+struct node *copynode(struct node *node);
+void indexargument(struct node *node, struct node *arg);
+int extattrbit(const char *name);
+void indexextattr(struct node *list, struct node *attr);
+struct node *getextattr(struct node *node, int extattr);
 int nodeisempty(struct node *node);
-const char *getattr(struct node *node, const char *name);
+const char *getattr(struct node *node, int name);
 struct node *nodewalk(struct node *node);
+struct node *nextelement(struct node *node);
+void freenode(struct node *node);
+void setfqids(struct node *root);
+struct node *findsymbol(const char *fqid);
 struct node *findreturntype(struct node *node);
 struct node *findparamidentifier(struct node *node, const char *name);
 struct node *findthrowidentifier(struct node *node, const char *name);
+void nodeerrorexit(struct node *node, const char *format, ...);
+void checkduplicate(struct hashtable *seen, struct node *node,
+        struct node *definition);
+void addextattrindex(struct node *root);
 void outputnode(struct node *node, unsigned int indent);
+void sendevents(struct node *node, const struct nodeevents *events);
 
 #endif /* ndef node_h */
 
@@ -0,0 +1,678 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Overload sets and distinguishability of operations
+ ***********************************************************************/
+#include <string.h>
+#include "hash.h"
+#include "misc.h"
+#include "node.h"
+#include "overload.h"
+#include "type.h"
+
+/* Categories of types for distinguishability. The categories of a type
+ * are a bitset with the bit of each category that it, or any of its
+ * flattened member types if it is a union, is in. */
+#define CAT_BOOLEAN 0x1
+#define CAT_NUMERIC 0x2
+#define CAT_STRING 0x4 /* string types and enumerations */
+#define CAT_SYMBOL 0x8
+#define CAT_OBJECT 0x10
+#define CAT_INTERFACE 0x20 /* interface-like */
+#define CAT_CALLBACK 0x40 /* callback function */
+#define CAT_DICTIONARY 0x80 /* dictionary-like */
+#define CAT_SEQUENCE 0x100 /* sequence-like */
+#define CAT_NULLABLE 0x200 /* includes a nullable type */
+#define CAT_ALL 0x3ff
+#define NCATS 10
+
+/* For each category, the categories it cannot be told apart from. Two
+ * interface-like types can be told apart if they are different
+ * interfaces and neither inherits from the other, which the bitsets
+ * cannot show, so interfacesdistinct checks that separately. */
+static const unsigned int conflicts[NCATS] = {
+    CAT_BOOLEAN,
+    CAT_NUMERIC,
+    CAT_STRING,
+    CAT_SYMBOL,
+    CAT_OBJECT | CAT_INTERFACE | CAT_CALLBACK | CAT_DICTIONARY | CAT_SEQUENCE,
+    CAT_OBJECT | CAT_INTERFACE,
+    CAT_OBJECT | CAT_CALLBACK | CAT_DICTIONARY,
+    CAT_OBJECT | CAT_CALLBACK | CAT_DICTIONARY | CAT_NULLABLE,
+    CAT_OBJECT | CAT_SEQUENCE,
+    CAT_DICTIONARY | CAT_NULLABLE,
+};
+
+/* The numeric types. */
+static const char *const numerictypes[] = {
+    "byte", "octet", "short", "unsigned short", "long", "unsigned long",
+    "long long", "unsigned long long", "float", "unrestricted float",
+    "double", "unrestricted double", 0
+};
+
+/* struct argtypes : the argument types of an operation
+ *
+ * The types are resolved, and unions in canonical form, so two types are
+ * the same exactly when they are the same pointer. */
+struct argtypes {
+    struct node *node; /* Operation element */
+    unsigned int nargs;
+    const struct typeform **types;
+    unsigned int *cats; /* categories of each type */
+    int *optional; /* whether each argument is optional */
+    int variadic; /* whether the last argument is variadic */
+};
+
+/* struct entry : an entry in an effective overload set, being the first
+ * length types of an operation's argument list, with a variadic last
+ * argument repeated as needed. */
+struct entry {
+    unsigned int overload; /* index of operation in its overload set */
+    unsigned int length;
+};
+
+/* struct opset : the operations with one name in one interface */
+struct opset {
+    const char *name;
+    int isstatic;
+    struct argtypes *ops;
+    unsigned int nops, maxops;
+};
+
+/* The definitions, keyed by name, and the categories of each type worked
+ * out so far, keyed by the canonical text of the type, for one
+ * computeoverloads call. */
+static struct hashtable definitions, categories;
+
+/***********************************************************************
+ * normalform : get the form of a type that overloads are compared by
+ *
+ * Enter:   typeform = typeform of a Type element
+ *
+ * Return:  typeform with typedefs resolved and, if a union, in canonical
+ *          form
+ */
+static const struct typeform *
+normalform(const struct typeform *typeform)
+{
+    typeform = resolveform(typeform);
+    if (typeform->type && !strcmp(typeform->type, "union"))
+        typeform = canonicalunion(typeform);
+    return typeform;
+}
+
+/***********************************************************************
+ * namedcategory : get the category of a definition used as a type
+ *
+ * Enter:   name = name of definition
+ *
+ * Return:  category; an interface that is not in the input, such as
+ *          one from another specification, is interface-like
+ */
+static unsigned int
+namedcategory(const char *name)
+{
+    struct node *node = hashget(&definitions, name, strlen(name));
+    if (node) {
+        switch (((struct element *)node)->name) {
+        case NAME_Interface:
+            /* A callback interface is dictionary-like. */
+            return getattr(node, NAME_callback) ? CAT_DICTIONARY
+                    : CAT_INTERFACE;
+        case NAME_Dictionary:
+            return CAT_DICTIONARY;
+        case NAME_Enum:
+            return CAT_STRING;
+        case NAME_Callback:
+            return CAT_CALLBACK;
+        }
+    }
+    return CAT_INTERFACE;
+}
+
+/***********************************************************************
+ * typecategories : get the categories of a type
+ *
+ * Enter:   typeform = typeform in normal form
+ *
+ * Return:  categories bitset, never 0
+ *
+ * The result for each type is remembered, so it is worked out once
+ * however many arguments have the type.
+ */
+static unsigned int
+typecategories(const struct typeform *typeform)
+{
+    unsigned int cats, i;
+    const char *type = typeform->type;
+    cats = (unsigned int)(size_t)hashget(&categories, typeform->key,
+            strlen(typeform->key));
+    if (cats)
+        return cats;
+    if (!type)
+        cats = namedcategory(typeform->name);
+    else if (!strcmp(type, "union")) {
+        for (i = 0; i != typeform->nparams; i++)
+            cats |= typecategories(typeform->params[i]);
+    } else if (!strcmp(type, "boolean"))
+        cats = CAT_BOOLEAN;
+    else if (!strcmp(type, "DOMString") || !strcmp(type, "ByteString")
+            || !strcmp(type, "USVString"))
+    {
+        cats = CAT_STRING;
+    } else if (!strcmp(type, "symbol"))
+        cats = CAT_SYMBOL;
+    else if (!strcmp(type, "object"))
+        cats = CAT_OBJECT;
+    else if (!strcmp(type, "sequence") || !strcmp(type, "FrozenArray")
+            || !strcmp(type, "array"))
+    {
+        cats = CAT_SEQUENCE;
+    } else if (!strcmp(type, "record"))
+        cats = CAT_DICTIONARY;
+    else if (!strcmp(type, "any") || !strcmp(type, "Promise")) {
+        /* Nothing can be told apart from any, and overloads are not
+         * chosen by Promise arguments. */
+        cats = CAT_ALL;
+    } else {
+        const char *const *p;
+        for (p = numerictypes; *p && strcmp(*p, type); p++)
+            ;
+        /* Anything else, such as ArrayBuffer, is interface-like. */
+        cats = *p ? CAT_NUMERIC : CAT_INTERFACE;
+    }
+    if (typeform->nullable)
+        cats |= CAT_NULLABLE;
+    /* The hashtable treats a 0 value as absent, which is why cats must
+     * never be 0. It is added only now, as the recursion for a union
+     * can grow the table. */
+    *hashput(&categories, typeform->key, strlen(typeform->key))
+            = (void *)(size_t)cats;
+    return cats;
+}
+
+/***********************************************************************
+ * conflictmask : get the categories that a type cannot be told apart
+ *                from
+ *
+ * Enter:   cats = categories of the type
+ *
+ * Return:  union of the conflicts of each of its categories
+ */
+static unsigned int
+conflictmask(unsigned int cats)
+{
+    unsigned int mask = 0, i;
+    for (i = 0; i != NCATS; i++) {
+        if (cats & 1 << i)
+            mask |= conflicts[i];
+    }
+    return mask;
+}
+
+/***********************************************************************
+ * inherits : test whether an interface inherits from another
+ *
+ * Enter:   name = name of interface
+ *          base = name of possible ancestor
+ *
+ * Return:  non-zero if base is an ancestor of name in the input
+ *
+ * The walk gives up after as many steps as there are definitions, in
+ * case the inheritance has a cycle.
+ */
+static int
+inherits(const char *name, const char *base)
+{
+    unsigned int steps = definitions.count;
+    while (steps--) {
+        struct node *node = hashget(&definitions, name, strlen(name));
+        struct node *child;
+        if (!node || ((struct element *)node)->name != NAME_Interface)
+            return 0;
+        for (child = nextelement(node->children); child
+                && ((struct element *)child)->name != NAME_InterfaceInheritance;
+                child = nextelement(child->next))
+        {
+            ;
+        }
+        if (!child || !(child = nextelement(child->children)))
+            return 0;
+        name = getattr(child, NAME_name);
+        if (!strcmp(name, base))
+            return 1;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * interfacesdistinct : test whether the interface-like types in two
+ *                      types can be told apart
+ *
+ * Enter:   form1, form2 = typeforms in normal form
+ *
+ * Return:  non-zero if no interface-like type in one is the same as or
+ *          inherits from one in the other
+ */
+static int
+interfacesdistinct(const struct typeform *form1, const struct typeform *form2)
+{
+    unsigned int n1 = 1, n2 = 1, i, j;
+    const struct typeform *const *list1 = &form1, *const *list2 = &form2;
+    if (form1->type && !strcmp(form1->type, "union")) {
+        n1 = form1->nparams;
+        list1 = form1->params;
+    }
+    if (form2->type && !strcmp(form2->type, "union")) {
+        n2 = form2->nparams;
+        list2 = form2->params;
+    }
+    for (i = 0; i != n1; i++) {
+        const char *name1;
+        if (!(typecategories(list1[i]) & CAT_INTERFACE))
+            continue;
+        name1 = list1[i]->name ? list1[i]->name : list1[i]->type;
+        for (j = 0; j != n2; j++) {
+            const char *name2;
+            if (!(typecategories(list2[j]) & CAT_INTERFACE))
+                continue;
+            name2 = list2[j]->name ? list2[j]->name : list2[j]->type;
+            if (!strcmp(name1, name2) || inherits(name1, name2)
+                    || inherits(name2, name1))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/***********************************************************************
+ * argindex : get where the type at an index of an entry is
+ *
+ * Enter:   op = operation of entry
+ *          index = index, less than the entry's length
+ *
+ * Return:  index into op's argument arrays
+ */
+static unsigned int
+argindex(const struct argtypes *op, unsigned int index)
+{
+    return index < op->nargs ? index : op->nargs - 1;
+}
+
+/***********************************************************************
+ * distinguishingindex : find the distinguishing argument index of the
+ *                       entries of one length
+ *
+ * Enter:   set = overload set
+ *          entries = its entries of one length
+ *          count = number of entries, at least 2
+ *          interfacename = name of interface, for error messages
+ *
+ * Return:  distinguishing argument index
+ *
+ * The only possible index is the first at which the entries' types are
+ * not all the same. Each entry's type there must be distinguishable from
+ * those of all earlier entries. Rather than comparing each pair, the
+ * conflicts of the earlier entries are accumulated in a bitset; only if
+ * the sole clash is with interface-like types are the earlier entries
+ * looked at one by one, as the clash may come from an earlier entry that
+ * is not itself interface-like, such as object.
+ */
+static unsigned int
+distinguishingindex(const struct opset *set, const struct entry *entries,
+                    unsigned int count, const char *interfacename)
+{
+    unsigned int length = entries[0].length, index, i, j;
+    unsigned int seenconflicts;
+    for (index = 0; index != length; index++) {
+        const struct argtypes *op = &set->ops[entries[0].overload];
+        const struct typeform *first = op->types[argindex(op, index)];
+        for (i = 1; i != count; i++) {
+            op = &set->ops[entries[i].overload];
+            if (op->types[argindex(op, index)] != first)
+                break;
+        }
+        if (i != count)
+            break;
+    }
+    if (index == length)
+        goto error;
+    seenconflicts = 0;
+    for (i = 0; i != count; i++) {
+        const struct argtypes *op = &set->ops[entries[i].overload];
+        unsigned int cats = op->cats[argindex(op, index)];
+        unsigned int clash = cats & seenconflicts;
+        if (clash & ~CAT_INTERFACE)
+            goto error;
+        if (clash) {
+            for (j = 0; j != i; j++) {
+                const struct argtypes *other = &set->ops[entries[j].overload];
+                unsigned int othercats = other->cats[argindex(other, index)];
+                if (!(conflictmask(othercats) & cats))
+                    continue;
+                /* Only a clash between interface-like types on both
+                 * sides can be settled by the interfaces themselves. */
+                if (conflictmask(othercats & ~CAT_INTERFACE) & cats
+                        || !interfacesdistinct(op->types[argindex(op, index)],
+                        other->types[argindex(other, index)]))
+                {
+                    goto error;
+                }
+            }
+        }
+        seenconflicts |= conflictmask(cats);
+    }
+    return index;
+error:
+    nodeerrorexit(set->ops[entries[count - 1].overload].node,
+            "overloads of %s%s in interface %s cannot be told apart "
+            "when called with %u argument%s",
+            set->isstatic ? "static operation " : "operation ",
+            set->name, interfacename, length, length == 1 ? "" : "s");
+    return 0;
+}
+
+/***********************************************************************
+ * overloadset : work out and check the effective overload set of the
+ *               operations with one name
+ *
+ * Enter:   set = overload set
+ *          interfacename = name of interface
+ *
+ * Return:  new OverloadSet element
+ *
+ * The entries are bucketed by length; for each length, each operation
+ * gives its whole argument list, its argument list cut short before each
+ * trailing optional argument, and, if its last argument is variadic, that
+ * argument repeated out to the longest argument list of the set.
+ */
+static struct node *
+overloadset(const struct opset *set, const char *interfacename)
+{
+    struct node *setnode = newelement(NAME_OverloadSet);
+    struct entry *entries;
+    unsigned int *starts, maxargs = 0, nentries = 0, i, length;
+    for (i = 0; i != set->nops; i++) {
+        if (set->ops[i].nargs > maxargs)
+            maxargs = set->ops[i].nargs;
+    }
+    entries = memalloc(set->nops * (maxargs + 1) * sizeof(struct entry));
+    /* starts[length] is where the entries of that length go, and then
+     * after them. */
+    starts = memalloc((maxargs + 2) * sizeof(unsigned int));
+    for (i = 0; i != set->nops; i++) {
+        const struct argtypes *op = &set->ops[i];
+        unsigned int low = op->nargs, high = op->variadic ? maxargs
+                : op->nargs;
+        while (low && (op->optional[low - 1]
+                || (op->variadic && low == op->nargs)))
+        {
+            low--;
+        }
+        for (length = low; length <= high; length++)
+            starts[length + 1]++;
+    }
+    for (length = 0; length <= maxargs; length++)
+        starts[length + 1] += starts[length];
+    for (i = 0; i != set->nops; i++) {
+        const struct argtypes *op = &set->ops[i];
+        unsigned int low = op->nargs, high = op->variadic ? maxargs
+                : op->nargs;
+        while (low && (op->optional[low - 1]
+                || (op->variadic && low == op->nargs)))
+        {
+            low--;
+        }
+        for (length = low; length <= high; length++) {
+            struct entry *entry = &entries[starts[length]++];
+            entry->overload = i;
+            entry->length = length;
+            nentries++;
+        }
+    }
+    /* Now starts[length] is the end of the entries of that length. */
+    addnode(setnode, newattr(NAME_name, set->name));
+    if (set->isstatic)
+        addnode(setnode, newattr(NAME_static, "static"));
+    for (length = 0; length <= maxargs; length++) {
+        unsigned int start = length ? starts[length - 1] : 0;
+        unsigned int end = starts[length];
+        struct node *lengthnode;
+        if (start == end)
+            continue;
+        lengthnode = newelement(NAME_EffectiveOverloads);
+        addnode(lengthnode, newallocattr(NAME_length,
+                memprintf("%u", length)));
+        if (end - start > 1) {
+            addnode(lengthnode, newallocattr(NAME_distinguishing,
+                    memprintf("%u", distinguishingindex(set, entries + start,
+                    end - start, interfacename))));
+        }
+        for (i = start; i != end; i++) {
+            const struct argtypes *op = &set->ops[entries[i].overload];
+            struct node *signature = newelement(NAME_Signature);
+            unsigned int index;
+            addnode(signature, newallocattr(NAME_overload,
+                    memprintf("%u", entries[i].overload)));
+            for (index = 0; index != length; index++) {
+                struct node *typenode = newelement(NAME_SignatureType);
+                unsigned int argi = argindex(op, index);
+                addnode(typenode, newattr(NAME_type, op->types[argi]->key));
+                addnode(typenode, newattr(NAME_optionality,
+                        op->variadic && argi == op->nargs - 1 ? "variadic"
+                        : op->optional[argi] ? "optional" : "required"));
+                addnode(signature, typenode);
+            }
+            addnode(lengthnode, signature);
+        }
+        addnode(setnode, lengthnode);
+    }
+    memfree(starts);
+    memfree(entries);
+    return setnode;
+}
+
+/***********************************************************************
+ * addoperation : add an operation to its overload set
+ *
+ * Enter:   set = overload set
+ *          node = Operation element
+ */
+static void
+addoperation(struct opset *set, struct node *node)
+{
+    struct argtypes *op;
+    struct node *list, *arg;
+    unsigned int max = 0;
+    if (set->nops == set->maxops) {
+        set->maxops = set->maxops ? 2 * set->maxops : 4;
+        set->ops = memrealloc(set->ops,
+                set->maxops * sizeof(struct argtypes));
+    }
+    op = &set->ops[set->nops++];
+    memset(op, 0, sizeof(struct argtypes));
+    op->node = node;
+    for (list = nextelement(node->children); list
+            && ((struct element *)list)->name != NAME_ArgumentList;
+            list = nextelement(list->next))
+    {
+        ;
+    }
+    if (!list)
+        return;
+    for (arg = nextelement(list->children); arg;
+            arg = nextelement(arg->next))
+    {
+        struct node *type;
+        if (((struct element *)arg)->name != NAME_Argument)
+            continue;
+        for (type = nextelement(arg->children); type
+                && ((struct element *)type)->name != NAME_Type;
+                type = nextelement(type->next))
+        {
+            ;
+        }
+        if (!type)
+            continue;
+        if (op->nargs == max) {
+            max = max ? 2 * max : 4;
+            op->types = memrealloc(op->types,
+                    max * sizeof(struct typeform *));
+            op->cats = memrealloc(op->cats, max * sizeof(unsigned int));
+            op->optional = memrealloc(op->optional, max * sizeof(int));
+        }
+        op->types[op->nargs] = normalform(((struct element *)type)->typeform);
+        op->cats[op->nargs] = typecategories(op->types[op->nargs]);
+        op->optional[op->nargs] = getattr(arg, NAME_optional) != 0;
+        op->variadic = getattr(arg, NAME_ellipsis) != 0;
+        op->nargs++;
+    }
+}
+
+/***********************************************************************
+ * interfaceoverloads : work out the overload sets of an interface
+ *
+ * Enter:   nodes = the interface and its partial interfaces, in document
+ *                  order
+ *          count = number of them
+ *
+ * The OverloadSet elements are added to the interface that is not
+ * partial, if there is one; the overloads are checked either way.
+ */
+static void
+interfaceoverloads(struct node **nodes, unsigned int count)
+{
+    struct hashtable regular = { 0, 0, 0 }, statics = { 0, 0, 0 };
+    struct opset **sets = 0;
+    struct node *primary = 0, *node;
+    const char *interfacename = getattr(nodes[0], NAME_name);
+    unsigned int nsets = 0, max = 0, i;
+    for (i = 0; i != count; i++) {
+        if (!primary && !getattr(nodes[i], NAME_partial))
+            primary = nodes[i];
+        for (node = nextelement(nodes[i]->children); node;
+                node = nextelement(node->next))
+        {
+            const char *name;
+            int isstatic;
+            struct opset **pset;
+            if (((struct element *)node)->name != NAME_Operation)
+                continue;
+            name = getattr(node, NAME_name);
+            if (!name)
+                continue;
+            isstatic = getattr(node, NAME_static) != 0;
+            pset = (struct opset **)hashput(isstatic ? &statics : &regular,
+                    name, strlen(name));
+            if (!*pset) {
+                *pset = memalloc(sizeof(struct opset));
+                (*pset)->name = name;
+                (*pset)->isstatic = isstatic;
+                if (nsets == max) {
+                    max = max ? 2 * max : 16;
+                    sets = memrealloc(sets, max * sizeof(struct opset *));
+                }
+                sets[nsets++] = *pset;
+            }
+            addoperation(*pset, node);
+        }
+    }
+    for (i = 0; i != nsets; i++) {
+        struct opset *set = sets[i];
+        unsigned int j;
+        node = overloadset(set, interfacename);
+        if (primary)
+            addnode(primary, node);
+        else
+            freenode(node);
+        for (j = 0; j != set->nops; j++) {
+            if (set->ops[j].nargs) {
+                memfree(set->ops[j].types);
+                memfree(set->ops[j].cats);
+                memfree(set->ops[j].optional);
+            }
+        }
+        memfree(set->ops);
+        memfree(set);
+    }
+    if (sets)
+        memfree(sets);
+    hashfree(&statics);
+    hashfree(&regular);
+}
+
+/***********************************************************************
+ * computeoverloads : add the overload sets of each interface
+ *
+ * Enter:   root = root of parse tree, after settypeforms
+ *
+ * The operations of each interface and its partial interfaces are
+ * grouped by name, with static operations apart from the others, using
+ * a hashtable per interface. Each group gets an OverloadSet element
+ * giving its effective overload set for each argument count and the
+ * distinguishing argument index, and operations that cannot be told
+ * apart are an error.
+ */
+void
+computeoverloads(struct node *root)
+{
+    struct hashtable interfaces = { 0, 0, 0 };
+    struct node ***lists = 0, *node;
+    unsigned int *counts = 0, nlists = 0, max = 0, i;
+    starttypedefs(root);
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *name = getattr(node, NAME_name);
+        void **pvalue;
+        if (!name)
+            continue;
+        pvalue = hashput(&definitions, name, strlen(name));
+        /* Prefer a definition to a partial one of the same name. */
+        if (!*pvalue || getattr(*pvalue, NAME_partial))
+            *pvalue = node;
+        if (((struct element *)node)->name != NAME_Interface)
+            continue;
+        /* Collect each interface with its partial interfaces. The value
+         * stored is the index of the list plus 1, as 0 means absent. */
+        pvalue = hashput(&interfaces, name, strlen(name));
+        if (!*pvalue) {
+            if (nlists == max) {
+                max = max ? 2 * max : 64;
+                lists = memrealloc(lists, max * sizeof(struct node **));
+                counts = memrealloc(counts, max * sizeof(unsigned int));
+            }
+            lists[nlists] = 0;
+            counts[nlists] = 0;
+            *pvalue = (void *)(size_t)++nlists;
+        }
+        i = (unsigned int)(size_t)*pvalue - 1;
+        lists[i] = memrealloc(lists[i],
+                (counts[i] + 1) * sizeof(struct node *));
+        lists[i][counts[i]++] = node;
+    }
+    for (i = 0; i != nlists; i++) {
+        interfaceoverloads(lists[i], counts[i]);
+        memfree(lists[i]);
+    }
+    if (lists) {
+        memfree(lists);
+        memfree(counts);
+    }
+    hashfree(&interfaces);
+    hashfree(&categories);
+    hashfree(&definitions);
+    endtypedefs(root);
+}
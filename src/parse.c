@@ -14,15 +14,21 @@
  * Hand-crafted recursive descent parser for Web IDL grammar.
  ***********************************************************************/
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "comment.h"
+#include "hash.h"
 #include "lex.h"
 #include "misc.h"
 #include "node.h"
 #include "parse.h"
+#include "type.h"
 
 /***********************************************************************
  * tokerrorexit : error and exit with line number from token
@@ -37,7 +43,7 @@ tokerrorexit(struct tok *tok, const char *format, ...)
     if (tok->type == TOK_EOF)
         locerrorexit(tok->filename, tok->linenum, "at end of input: %s", m);
     else
-        locerrorexit(tok->filename, tok->linenum, "at '%.*s': %s", tok->len, tok->start, m);
+        locerrorexit(tok->filename, tok->linenum, "at '%.*s': %s", (int)tok->len, tok->start, m);
     va_end(ap);
 }
 
@@ -52,7 +58,11 @@ tokerrorexit(struct tok *tok, const char *format, ...)
  * An inline comment starting with /// or //! is a doxygen comment.
  * If it starts with ///< or //!< then it refers to the previous
  * identifier, not the next one.
+ *
+ * If nocomments is set (by parsewithevents), all comments are discarded.
  */
+static int nocomments;
+
 static struct tok *
 lexnocomment(void)
 {
@@ -61,7 +71,8 @@ lexnocomment(void)
         tok = lex();
         if (tok->type != TOK_BLOCKCOMMENT && tok->type != TOK_INLINECOMMENT)
             break;
-        addcomment(tok);
+        if (!nocomments)
+            addcomment(tok);
     }
     return tok;
 }
@@ -91,19 +102,46 @@ eat(struct tok *tok, int type)
     lexnocomment();
 }
 
+/***********************************************************************
+ * enternesting, leavenesting : track nesting of types and extended
+ *                               attributes
+ *
+ * Enter:   tok = next token (enternesting only)
+ *
+ * The parse functions for union types, non-any types and extended
+ * attribute lists bracket themselves with these, so that pathologically
+ * nested input gives an error rather than overflowing the stack.
+ */
+#define MAXNESTING 256
+
+static unsigned int nesting;
+
+static void
+enternesting(struct tok *tok)
+{
+    if (++nesting > MAXNESTING)
+        tokerrorexit(tok, "types or extended attributes nested too deeply");
+}
+
+static void
+leavenesting(void)
+{
+    nesting--;
+}
+
 /***********************************************************************
  * setid : flag that an id attribute is required on node
  *
  * Enter:   node
  *
  * node->id is set to the value of the name attribute. This makes
- * outputnode give it an id attribute whose value is the id attribute
- * of the parent if any, then "::", then node->id.
+ * setfqids give it a fully qualified id, which outputnode outputs as
+ * its id attribute.
  */
 static void
 setid(struct node *node)
 {
-    node->id = getattr(node, "name");
+    node->id = getattr(node, NAME_name);
 }
 
 /***********************************************************************
@@ -121,9 +159,9 @@ setidentifier(struct tok *tok)
         tokerrorexit(tok, "expected identifier");
     // Remove leading underscore
     if (tok->start[0] == '_') 
-      s = memprintf("%.*s", tok->len -1, tok->start + 1);
+      s = memprintf("%.*s", (int)tok->len - 1, tok->start + 1);
     else
-      s = memprintf("%.*s", tok->len, tok->start);
+      s = memprintf("%.*s", (int)tok->len, tok->start);
     
     return s;
 }
@@ -141,7 +179,7 @@ setargumentname(struct tok *tok)
     char *s;
     if (tok->type != TOK_IDENTIFIER && tok->type < TOK_attribute)
         tokerrorexit(tok, "expected argument name");
-    s = memprintf("%.*s", tok->len, tok->start);
+    s = memprintf("%.*s", (int)tok->len, tok->start);
     return s;
 }
 
@@ -152,7 +190,7 @@ static struct node *parsetypewithextendedattributes(struct tok *tok);
 static struct node *parseextendedattributelist(struct tok *tok);
 static struct node *parsedefaultvalue(struct tok *tok, struct node *parent);
 static struct node *parseuniontype(struct tok *tok);
-static struct node *parseargumentlist(struct tok *tok);
+static struct node *parseargumentlist(struct tok *tok, struct node *owner);
 static struct node *parseoneormanyidentifier(struct tok *tok);
 static void parsedefinitions(struct tok *tok, struct node *parent);
 static struct node *parsetypesuffixstartingwitharray(struct tok *tok, struct node *node);
@@ -161,7 +199,7 @@ static struct node *parsetypesuffixstartingwitharray(struct tok *tok, struct nod
  * parsescopedname : parse [53] ScopedName
  *
  * Enter:   tok = next token
- *          name = name of attribute to put scoped name in
+ *          name = atom of name of attribute to put scoped name in
  *          ref = whether to enable enclosing of the name in <ref> in
  *                outputwidl
  *
@@ -169,11 +207,11 @@ static struct node *parsetypesuffixstartingwitharray(struct tok *tok, struct nod
  *          tok updated
  */
 static struct node *
-parsescopedname(struct tok *tok, const char *name, int ref)
+parsescopedname(struct tok *tok, int name, int ref)
 {
     const char *start = tok->start, *end;
     struct node *node;
-    unsigned int len = 0;
+    size_t len = 0;
     char *s = memalloc(3);
     if (tok->type != TOK_IDENTIFIER)
         tokerrorexit(tok, "expected identifier");
@@ -183,7 +221,7 @@ parsescopedname(struct tok *tok, const char *name, int ref)
     end = tok->start + tok->len;
     lexnocomment();
     s[len] = 0;
-    node = newattr(name, s);
+    node = newallocattr(name, s);
     if (ref) {
         node->start = start;
         node->end = end;
@@ -195,20 +233,20 @@ parsescopedname(struct tok *tok, const char *name, int ref)
  * parsescopednamelist : parse [51] ScopedNameList
  *
  * Enter:   tok = next token
- *          name = name of element for scoped name list
- *          name2 = name of element for entry in list
+ *          name = atom of name of element for scoped name list
+ *          name2 = atom of name of element for entry in list
  *          comment = whether to attach documentation to each name
  *
  * Return:  node for list of scoped names
  *          tok updated
  */
 static struct node *
-parsescopednamelist(struct tok *tok, const char *name, const char *name2,
+parsescopednamelist(struct tok *tok, int name, int name2,
         int comment)
 {
     struct node *node = newelement(name);
     for (;;) {
-        struct node *attr = parsescopedname(tok, "name", 1);
+        struct node *attr = parsescopedname(tok, NAME_name, 1);
         struct node *n = newelement(name2);
         if (comment)
             setcommentnode(n);
@@ -233,8 +271,8 @@ static struct node *
 parsereturntype(struct tok *tok)
 {
     if (tok->type == TOK_void) {
-        struct node *node = newelement("Type");
-        addnode(node, newattr("type", "void"));
+        struct node *node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "void"));
         lexnocomment();
         return node;
     }
@@ -284,22 +322,28 @@ parseunsignedintegertype(struct tok *tok)
  *
  * Return:  node for type
  *          tok updated
+ *
+ * The right recursion in the grammar is parsed as a loop.
  */
 static struct node *
 parsetypesuffix(struct tok *tok, struct node *node)
 {
-    if (tok->type == '[') {
-        struct node *typenode = node;
-        eat(tok, '[');
-        eat(tok, ']');
-	node = newelement("Type");
-        addnode(node, newattr("type", "array"));
-        addnode(node, typenode);
-        node = parsetypesuffix(tok, node);
-    } else if (tok->type == '?') {
-        addnode(node, newattr("nullable", "nullable"));
-        lexnocomment();
-	node = parsetypesuffixstartingwitharray(tok, node);
+    for (;;) {
+        if (tok->type == '[') {
+            struct node *typenode = node;
+            eat(tok, '[');
+            eat(tok, ']');
+            node = newelement(NAME_Type);
+            addnode(node, newattr(NAME_type, "array"));
+            addnode(node, typenode);
+        } else if (tok->type == '?') {
+            addnode(node, newattr(NAME_nullable, "nullable"));
+            lexnocomment();
+            /* TypeSuffixStartingWithArray */
+            if (tok->type != '[')
+                break;
+        } else
+            break;
     }
     return node;
 }
@@ -315,15 +359,8 @@ parsetypesuffix(struct tok *tok, struct node *node)
 static struct node *
 parsetypesuffixstartingwitharray(struct tok *tok,  struct node *node)
 {
-    if (tok->type == '[') {
-        struct node *typenode = node;
-        eat(tok, '[');
-        eat(tok, ']');
-	node = newelement("Type");
-        addnode(node, newattr("type", "array"));
-        addnode(node, typenode);
+    if (tok->type == '[')
 	node = parsetypesuffix(tok, node);
-    }
     return node;
 }
 
@@ -343,11 +380,11 @@ parseprimitiveorstringtype(struct tok *tok)
     case TOK_unsigned:
     case TOK_short:
     case TOK_long:
-        node = newelement("Type");
-        addnode(node, newattr("type", parseunsignedintegertype(tok)));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, parseunsignedintegertype(tok)));
         break;
     default:
-        node = newelement("Type");
+        node = newelement(NAME_Type);
         switch (tok->type) {
         default:
             tokerrorexit(tok, "expected type");
@@ -355,78 +392,78 @@ parseprimitiveorstringtype(struct tok *tok)
 	case TOK_unrestricted:
 	  lexnocomment();
 	  if (tok->type == TOK_float) {
-            addnode(node, newattr("type", "unrestricted float"));
+            addnode(node, newattr(NAME_type, "unrestricted float"));
 	  } else if (tok->type == TOK_double) {
-            addnode(node, newattr("type", "unrestricted double"));
+            addnode(node, newattr(NAME_type, "unrestricted double"));
 	  } else {
             tokerrorexit(tok, "expected float or double after unrestricted");
 	  }
 	  break;
         case TOK_boolean:
-            addnode(node, newattr("type", "boolean"));
+            addnode(node, newattr(NAME_type, "boolean"));
             break;
         case TOK_byte:
-            addnode(node, newattr("type", "byte"));
+            addnode(node, newattr(NAME_type, "byte"));
             break;
         case TOK_octet:
-            addnode(node, newattr("type", "octet"));
+            addnode(node, newattr(NAME_type, "octet"));
             break;
         case TOK_float:
-            addnode(node, newattr("type", "float"));
+            addnode(node, newattr(NAME_type, "float"));
             break;
         case TOK_double:
-            addnode(node, newattr("type", "double"));
+            addnode(node, newattr(NAME_type, "double"));
             break;
         case TOK_DOMString:
-            addnode(node, newattr("type", "DOMString"));
+            addnode(node, newattr(NAME_type, "DOMString"));
             break;
         case TOK_USVString:
-            addnode(node, newattr("type", "USVString"));
+            addnode(node, newattr(NAME_type, "USVString"));
             break;
         case TOK_ByteString:
-            addnode(node, newattr("type", "ByteString"));
+            addnode(node, newattr(NAME_type, "ByteString"));
             break;
         case TOK_RegExp:
-            addnode(node, newattr("type", "RegExp"));
+            addnode(node, newattr(NAME_type, "RegExp"));
             break;
         case TOK_DOMException:
-            addnode(node, newattr("type", "DOMException"));
+            addnode(node, newattr(NAME_type, "DOMException"));
             break;
         case TOK_Error:
-            addnode(node, newattr("type", "Error"));
+            addnode(node, newattr(NAME_type, "Error"));
             break;
         case TOK_ArrayBuffer:
-            addnode(node, newattr("type", "ArrayBuffer"));
+            addnode(node, newattr(NAME_type, "ArrayBuffer"));
             break;
         case TOK_DataView:
-            addnode(node, newattr("type", "DataView"));
+            addnode(node, newattr(NAME_type, "DataView"));
             break;
         case TOK_Int8Array:
-            addnode(node, newattr("type", "Int8Array"));
+            addnode(node, newattr(NAME_type, "Int8Array"));
             break;
         case TOK_Int16Array:
-            addnode(node, newattr("type", "Int16Array"));
+            addnode(node, newattr(NAME_type, "Int16Array"));
             break;
         case TOK_Int32Array:
-            addnode(node, newattr("type", "Int32Array"));
+            addnode(node, newattr(NAME_type, "Int32Array"));
             break;
         case TOK_Uint8Array:
-            addnode(node, newattr("type", "Uint8Array"));
+            addnode(node, newattr(NAME_type, "Uint8Array"));
             break;
         case TOK_Uint16Array:
-            addnode(node, newattr("type", "Uint16Array"));
+            addnode(node, newattr(NAME_type, "Uint16Array"));
             break;
         case TOK_Uint32Array:
-            addnode(node, newattr("type", "Uint32Array"));
+            addnode(node, newattr(NAME_type, "Uint32Array"));
             break;
         case TOK_Uint8ClampedArray:
-            addnode(node, newattr("type", "Uint8ClampedArray"));
+            addnode(node, newattr(NAME_type, "Uint8ClampedArray"));
             break;
         case TOK_Float32Array:
-            addnode(node, newattr("type", "Float32Array"));
+            addnode(node, newattr(NAME_type, "Float32Array"));
             break;
         case TOK_Float64Array:
-            addnode(node, newattr("type", "Float64Array"));
+            addnode(node, newattr(NAME_type, "Float64Array"));
             break;
         }
         lexnocomment();
@@ -437,16 +474,16 @@ parseprimitiveorstringtype(struct tok *tok)
 static struct node *
 parsestringtype(struct tok *tok)
 {
-  struct node *node = newelement("Type");
+  struct node *node = newelement(NAME_Type);
   switch (tok->type) {
   case TOK_DOMString:
-    addnode(node, newattr("type", "DOMString"));
+    addnode(node, newattr(NAME_type, "DOMString"));
     break;
   case TOK_USVString:
-    addnode(node, newattr("type", "USVString"));
+    addnode(node, newattr(NAME_type, "USVString"));
     break;
   case TOK_ByteString:
-    addnode(node, newattr("type", "ByteString"));
+    addnode(node, newattr(NAME_type, "ByteString"));
     break;
   default:
     tokerrorexit(tok, "expected string type");
@@ -468,51 +505,52 @@ static struct node *
 parsenonanytype(struct tok *tok)
 {
     struct node *node;
+    enternesting(tok);
     switch (tok->type) {
     case TOK_IDENTIFIER:
-        node = newelement("Type");
-        addnode(node, parsescopedname(tok, "name", 1));
+        node = newelement(NAME_Type);
+        addnode(node, parsescopedname(tok, NAME_name, 1));
 	node = parsetypesuffix(tok, node);
         break;
     case TOK_sequence:
-        node = newelement("Type");
-        addnode(node, newattr("type", "sequence"));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "sequence"));
         lexnocomment();
         eat(tok, '<');
         addnode(node, parsetypewithextendedattributes(tok));
         eat(tok, '>');
 	if (tok->type == '?') {
-	  addnode(node, newattr("nullable", "nullable"));
+	  addnode(node, newattr(NAME_nullable, "nullable"));
 	  lexnocomment();
 	}
         break;
     case TOK_frozenarray:
-        node = newelement("Type");
-        addnode(node, newattr("type", "FrozenArray"));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "FrozenArray"));
         lexnocomment();
         eat(tok, '<');
         addnode(node, parsetypewithextendedattributes(tok));
         eat(tok, '>');
 	if (tok->type == '?') {
-	  addnode(node, newattr("nullable", "nullable"));
+	  addnode(node, newattr(NAME_nullable, "nullable"));
 	  lexnocomment();
 	}
         break;
     case TOK_Promise:
-        node = newelement("Type");
-        addnode(node, newattr("type", "Promise"));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "Promise"));
         lexnocomment();
         eat(tok, '<');
         addnode(node, parsereturntype(tok));
         eat(tok, '>');
 	if (tok->type == '?') {
-	  addnode(node, newattr("nullable", "nullable"));
+	  addnode(node, newattr(NAME_nullable, "nullable"));
 	  lexnocomment();
 	}
         break;
     case TOK_record:
-        node = newelement("Type");
-        addnode(node, newattr("type", "record"));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "record"));
         lexnocomment();
         eat(tok, '<');
         addnode(node, parsestringtype(tok));
@@ -520,13 +558,13 @@ parsenonanytype(struct tok *tok)
         addnode(node, parsetypewithextendedattributes(tok));
         eat(tok, '>');
 	if (tok->type == '?') {
-	  addnode(node, newattr("nullable", "nullable"));
+	  addnode(node, newattr(NAME_nullable, "nullable"));
 	  lexnocomment();
 	}
         break;
     case TOK_object:
-        node = newelement("Type");
-        addnode(node, newattr("type", "object"));
+        node = newelement(NAME_Type);
+        addnode(node, newattr(NAME_type, "object"));
         lexnocomment();
 	node = parsetypesuffix(tok, node);
         break;
@@ -535,6 +573,7 @@ parsenonanytype(struct tok *tok)
         node = parsetypesuffix(tok, node);
         break;
     }       
+    leavenesting();
     return node;
 }
 
@@ -551,13 +590,13 @@ parseunionmembertype(struct tok *tok)
 {
   struct node *node;
   if (tok->type == TOK_any) {
-    struct node *typenode = newelement("Type");
-    addnode(typenode, newattr("type", "any"));
+    struct node *typenode = newelement(NAME_Type);
+    addnode(typenode, newattr(NAME_type, "any"));
     lexnocomment();
     eat(tok, '[');
     eat(tok, ']');
-    node = newelement("Type");
-    addnode(node, newattr("type", "array"));
+    node = newelement(NAME_Type);
+    addnode(node, newattr(NAME_type, "array"));
     addnode(node, typenode);
     node = parsetypesuffix(tok, node);
   } else if (tok->type == '(') {
@@ -583,9 +622,10 @@ static struct node *
 parseuniontype(struct tok *tok)
 {
   struct node *node;
+  enternesting(tok);
   eat(tok, '(');
-  node = newelement("Type");
-  addnode(node, newattr("type", "union"));
+  node = newelement(NAME_Type);
+  addnode(node, newattr(NAME_type, "union"));
   if (tok->type != ')') {
     for (;;) {
       addnode(node, parseunionmembertype(tok));
@@ -596,6 +636,7 @@ parseuniontype(struct tok *tok)
   }
   eat(tok, ')');
   node = parsetypesuffix(tok, node);      
+  leavenesting();
   return node;
 }
 
@@ -614,8 +655,8 @@ parsetype(struct tok *tok)
     if (tok->type == '(') {
       node = parseuniontype(tok);
     } else if (tok->type == TOK_any) {
-      node = newelement("Type");
-      addnode(node, newattr("type", "any"));
+      node = newelement(NAME_Type);
+      addnode(node, newattr(NAME_type, "any"));
       lexnocomment();
       node = parsetypesuffixstartingwitharray(tok, node);
     } else {
@@ -640,8 +681,8 @@ parsetypewithextendedattributes(struct tok *tok)
     if (tok->type == '(') {
       node = parseuniontype(tok);
     } else if (tok->type == TOK_any) {
-      node = newelement("Type");
-      addnode(node, newattr("type", "any"));
+      node = newelement(NAME_Type);
+      addnode(node, newattr(NAME_type, "any"));
       lexnocomment();
       node = parsetypesuffixstartingwitharray(tok, node);
     } else {
@@ -663,45 +704,52 @@ parsetypewithextendedattributes(struct tok *tok)
  * rules [57] [58] [59] [60] [61].
  *
  * This does not spot the error that you cannot have a ScopedName
- * and an ArgumentList.
+ * and an ArgumentList. The name is looked up by its interned atom, so
+ * the special cases are a switch rather than a string compare each.
  */
 static struct node *
 parseextendedattribute(struct tok *tok)
 {
 	const char *start ;
-    struct node *node = newelement("ExtendedAttribute");
+    struct node *node = newelement(NAME_ExtendedAttribute);
     char *attrname = setidentifier(tok);
-    addnode(node, newattr("name", attrname));
+    int bit = extattrbit(attrname);
+    addnode(node, newallocattr(NAME_name, attrname));
     start = tok->prestart;
     node->wsstart = start;
     node->end = tok->start + tok->len;
-    if (!strcmp(attrname, "Constructor") || !strcmp(attrname, "NamedConstructor")) {
+    if (bit == EXTATTR_Constructor || bit == EXTATTR_NamedConstructor) {
 	    setcommentnode(node);
     }
     lexnocomment();
-    if (!strcmp(attrname, "Exposed")) {
+    switch (bit) {
+    case EXTATTR_Exposed:
       // Special casing Exposed since it too has a unique structure
       eat(tok, '=');
       addnode(node, parseoneormanyidentifier(tok));
       node->end = tok->start + tok->len;
-    } else if (!strcmp(attrname, "Global") || !strcmp(attrname, "PrimaryGlobal")) {
+      break;
+    case EXTATTR_Global:
+    case EXTATTR_PrimaryGlobal:
       // Special casing Global / PrimaryGlobal since they too have a unique structure
       if (tok->type == '=') {
         eat(tok, '=');
         addnode(node, parseoneormanyidentifier(tok));
         node->end = tok->start + tok->len;
       }
-    } else {
+      break;
+    default:
       if (tok->type == '=') {
         lexnocomment();
-        addnode(node, parsescopedname(tok, "value", 0));
+        addnode(node, parsescopedname(tok, NAME_value, 0));
       }
       if (tok->type == '(') {
         lexnocomment();
-        addnode(node, parseargumentlist(tok));
+        addnode(node, parseargumentlist(tok, node));
 	node->end = tok->start + tok->len;
         eat(tok, ')');
       }
+      break;
     }
     return node;
 }
@@ -720,16 +768,20 @@ parseextendedattributelist(struct tok *tok)
     struct node *node;
     if (tok->type != '[')
         return 0;
-    node = newelement("ExtendedAttributeList");
+    enternesting(tok);
+    node = newelement(NAME_ExtendedAttributeList);
     for (;;) {
+        struct node *attr;
         lexnocomment();
-        addnode(node, parseextendedattribute(tok));
+        addnode(node, attr = parseextendedattribute(tok));
+        indexextattr(node, attr);
         if (tok->type != ',')
             break;
     }
     if (tok->type != ']')
         tokerrorexit(tok, "expected ',' or ']'");
     lexnocomment();
+    leavenesting();
     return node;
 }
 
@@ -745,22 +797,22 @@ parseextendedattributelist(struct tok *tok)
 static struct node *
 parseargument(struct tok *tok)
 {
-    struct node *node = newelement("Argument");
+    struct node *node = newelement(NAME_Argument);
     struct node *eal = parseextendedattributelist(tok);
     setcommentnode(node);
     if (eal) addnode(node, eal);
     if (tok->type == TOK_optional) {
-        addnode(node, newattr("optional", "optional"));
+        addnode(node, newattr(NAME_optional, "optional"));
         lexnocomment();
         addnode(node, parsetypewithextendedattributes(tok));
     } else {
         addnode(node, parsetype(tok));
     }
     if (tok->type == TOK_ELLIPSIS) {
-        addnode(node, newattr("ellipsis", "ellipsis"));
+        addnode(node, newattr(NAME_ellipsis, "ellipsis"));
         lexnocomment();
     }
-    addnode(node, newattr("name", setargumentname(tok)));
+    addnode(node, newallocattr(NAME_name, setargumentname(tok)));
     lexnocomment();
     // Optional default value
     if (tok->type == '=') {
@@ -774,18 +826,22 @@ parseargument(struct tok *tok)
  * parseargumentlist : parse [29] ArgumentList
  *
  * Enter:   tok = next token
+ *          owner = element that the arglist will be added to, whose
+ *                  argument index is filled in
  *
  * Return:  new node for the arglist
  *          tok updated
  */
 static struct node *
-parseargumentlist(struct tok *tok)
+parseargumentlist(struct tok *tok, struct node *owner)
 {
-    struct node *node = newelement("ArgumentList");
+    struct node *node = newelement(NAME_ArgumentList);
     /* We rely on the fact that ArgumentList is always followed by ')'. */
     if (tok->type != ')') {
         for (;;) {
-            addnode(node, parseargument(tok));
+            struct node *arg = parseargument(tok);
+            addnode(node, arg);
+            indexargument(owner, arg);
             if (tok->type != ',')
                 break;
             lexnocomment();
@@ -805,22 +861,22 @@ parseargumentlist(struct tok *tok)
 static struct node *
 parseoneormanyidentifier(struct tok *tok)
 {
-    struct node *node = newelement("TypeList");
+    struct node *node = newelement(NAME_TypeList);
     if (tok->type == '(') {
       eat(tok, '(');
-      struct node *identifierNode = newelement("Type");
-      addnode(identifierNode, parsescopedname(tok, "name", 1));
+      struct node *identifierNode = newelement(NAME_Type);
+      addnode(identifierNode, parsescopedname(tok, NAME_name, 1));
       addnode(node, identifierNode);
       while(tok->type == ',') {
         eat(tok, ',');
-        struct node *identifierNode = newelement("Type");
-        addnode(identifierNode, parsescopedname(tok, "name", 1));
+        struct node *identifierNode = newelement(NAME_Type);
+        addnode(identifierNode, parsescopedname(tok, NAME_name, 1));
         addnode(node, identifierNode);
       }
       eat(tok, ')');
     } else {
-      struct node *identifierNode = newelement("Type");
-      addnode(identifierNode, parsescopedname(tok, "name", 1));
+      struct node *identifierNode = newelement(NAME_Type);
+      addnode(identifierNode, parsescopedname(tok, NAME_name, 1));
       addnode(node, identifierNode);
     }
     return node;
@@ -841,17 +897,17 @@ parseoperationrest(struct tok *tok, struct node *eal, struct node *attrs)
 {
   struct node *node;
   struct node *nodeType = parsereturntype(tok);
-  node = newelement("Operation");
+  node = newelement(NAME_Operation);
   if (eal) addnode(node, eal);
   setcommentnode(node);
   addnode(node, attrs);
   addnode(node, nodeType);
   if (tok->type == TOK_IDENTIFIER) {
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     lexnocomment();
   }
   eat(tok, '(');
-  addnode(node, parseargumentlist(tok));
+  addnode(node, parseargumentlist(tok, node));
   eat(tok, ')');
   return node;
 }
@@ -870,21 +926,21 @@ parseoperationrest(struct tok *tok, struct node *eal, struct node *attrs)
 static struct node *
 parseattribute(struct tok *tok, struct node *eal, struct node *attrs)
 {
-    struct node *node = newelement("Attribute");
+    struct node *node = newelement(NAME_Attribute);
     if (eal) addnode(node, eal);
     setcommentnode(node);
     addnode(node, attrs);
     if (tok->type == TOK_inherit) {
         lexnocomment();
-	addnode(node, newattr("inherit", "inherit"));
+	addnode(node, newattr(NAME_inherit, "inherit"));
     }
     if (tok->type == TOK_readonly) {
         lexnocomment();
-        addnode(node, newattr("readonly", "readonly"));
+        addnode(node, newattr(NAME_readonly, "readonly"));
     }
     eat(tok, TOK_attribute);
     addnode(node, parsetypewithextendedattributes(tok));
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     lexnocomment();
     return node;
 }
@@ -901,30 +957,30 @@ parseattribute(struct tok *tok, struct node *eal, struct node *attrs)
 static struct node *
 parseserializer (struct tok *tok, struct node *eal) {
 	struct node *nodeAttribute;
-	struct node *node = newelement("Serializer");
+	struct node *node = newelement(NAME_Serializer);
   if (tok->type == '=') {
     if (eal) addnode(node, eal);
     lexnocomment();
     if (tok->type == TOK_IDENTIFIER) {
-      addnode(node, newattr("attribute", setidentifier(tok)));
+      addnode(node, newallocattr(NAME_attribute, setidentifier(tok)));
       lexnocomment();
     } else if (tok->type == '{') {
       unsigned int done = 0;
-      struct node *nodeMap = newelement("Map");
+      struct node *nodeMap = newelement(NAME_Map);
       lexnocomment();
       if (tok->type == TOK_getter) {
-	addnode(nodeMap, newattr("pattern", "getter"));
+	addnode(nodeMap, newattr(NAME_pattern, "getter"));
 	done = 1;
       } else if (tok->type == TOK_attribute) {
-	addnode(nodeMap, newattr("pattern", "all"));
+	addnode(nodeMap, newattr(NAME_pattern, "all"));
 	done = 1;
       } else if (tok->type == TOK_inherit) {
-	addnode(nodeMap, newattr("inherit", "inherit"));
+	addnode(nodeMap, newattr(NAME_inherit, "inherit"));
 	lexnocomment();
 	if (tok->type == ',') {
 	  eat(tok, ',');
 	  if (tok->type == TOK_attribute) {
-	    addnode(nodeMap, newattr("pattern", "all"));
+	    addnode(nodeMap, newattr(NAME_pattern, "all"));
 	    done = 1;
 	  }
 	}
@@ -936,12 +992,12 @@ parseserializer (struct tok *tok, struct node *eal) {
 	lexnocomment();
 	eat(tok, '}');
       } else {
-	addnode(nodeMap, newattr("pattern", "selection"));
+	addnode(nodeMap, newattr(NAME_pattern, "selection"));
 	while (tok->type != '}') {
 	  if (tok->type != TOK_IDENTIFIER)
 	    tokerrorexit(tok, "expected attribute identifiers in serializer map %s", tok->prestart);
-	  nodeAttribute = newelement("PatternAttribute");
-	  addnode(nodeAttribute, newattr("name", setidentifier(tok)));
+	  nodeAttribute = newelement(NAME_PatternAttribute);
+	  addnode(nodeAttribute, newallocattr(NAME_name, setidentifier(tok)));
 	  addnode(nodeMap, nodeAttribute);
 	  lexnocomment();
 	  if (tok->type == ',')
@@ -951,19 +1007,19 @@ parseserializer (struct tok *tok, struct node *eal) {
       }
       addnode(node, nodeMap);
     } else if (tok->type == '[') {
-      struct node *nodeList = newelement("List");
+      struct node *nodeList = newelement(NAME_List);
       lexnocomment();
       if (tok->type == TOK_getter) {
-	addnode(nodeList, newattr("pattern", "getter"));
+	addnode(nodeList, newattr(NAME_pattern, "getter"));
 	lexnocomment();
 	eat(tok, ']');
       } else {
-	addnode(nodeList, newattr("pattern", "selection"));
+	addnode(nodeList, newattr(NAME_pattern, "selection"));
 	while (tok->type != ']') {
 	  if (tok->type != TOK_IDENTIFIER)
 	    tokerrorexit(tok, "expected attribute identifiers in serializer list");
-	  nodeAttribute = newelement("PatternAttribute");
-	  addnode(nodeAttribute, newattr("name", setidentifier(tok)));
+	  nodeAttribute = newelement(NAME_PatternAttribute);
+	  addnode(nodeAttribute, newallocattr(NAME_name, setidentifier(tok)));
 	  addnode(nodeList, nodeAttribute);
 	  lexnocomment();
 	  if (tok->type == ',')
@@ -985,9 +1041,9 @@ parseserializer (struct tok *tok, struct node *eal) {
 static struct node *
 parsemaplike(struct tok *tok) {
   struct node *node, *key, *value;
-  node = newelement("MapLike");
-  key = newelement("Key");
-  value = newelement("Value");
+  node = newelement(NAME_MapLike);
+  key = newelement(NAME_Key);
+  value = newelement(NAME_Value);
   lexnocomment();
   eat(tok, '<');
   addnode(key, parsetypewithextendedattributes(tok));
@@ -1002,9 +1058,9 @@ parsemaplike(struct tok *tok) {
 static struct node *
 parseiterable(struct tok *tok) {
   struct node *node, *key, *value, *type1;
-  node = newelement("Iterable");
-  key = newelement("Key");
-  value = newelement("Value");
+  node = newelement(NAME_Iterable);
+  key = newelement(NAME_Key);
+  value = newelement(NAME_Value);
   lexnocomment();
   eat(tok, '<');
   type1 = parsetypewithextendedattributes(tok);
@@ -1041,7 +1097,7 @@ parseattributeoroperationoriterable(struct tok *tok, struct node *eal)
       if (tok->type == '=' || tok->type ==';') {
 	return parseserializer(tok, eal);
       } else {
-	addnode(attrs, newattr("serializer", "serializer"));
+	addnode(attrs, newattr(NAME_serializer, "serializer"));
 	return parseoperationrest(tok, eal, attrs);
       }
     }
@@ -1052,17 +1108,17 @@ parseattributeoroperationoriterable(struct tok *tok, struct node *eal)
       return parsemaplike(tok);
     }
     if (tok->type == TOK_stringifier) {
-        addnode(attrs, newattr("stringifier", "stringifier"));
+        addnode(attrs, newattr(NAME_stringifier, "stringifier"));
         lexnocomment();
         if (tok->type == ';') {
-            struct node *node = newelement("Stringifier");
+            struct node *node = newelement(NAME_Stringifier);
             if (eal) addnode(node, eal);
             return node;
         }
     }
     if (tok->type == TOK_static) {
         lexnocomment();
-        addnode(attrs, newattr("static", "static"));
+        addnode(attrs, newattr(NAME_static, "static"));
     }
     if (tok->type == TOK_readonly) {
       lexnocomment();
@@ -1072,7 +1128,7 @@ parseattributeoroperationoriterable(struct tok *tok, struct node *eal)
        } else {
          node = parseattribute(tok, eal, attrs);
        }
-        addnode(node, newattr("readonly", "readonly"));
+        addnode(node, newattr(NAME_readonly, "readonly"));
         return node;
     }
     if (tok->type == TOK_inherit || tok->type == TOK_attribute)
@@ -1090,38 +1146,233 @@ parseattributeoroperationoriterable(struct tok *tok, struct node *eal)
 	tt++;
       if (!*tt)
 	break;
-      s = memprintf("%.*s", tok->len, tok->start);
+      s = memprintf("%.*s", (int)tok->len, tok->start);
       if (alreadyseen & (1 << (tt - t)))
 	tokerrorexit(tok, "'%s' qualifier cannot be repeated", s);
       alreadyseen |= 1 << (tt - t);
-      addnode(attrs, newattr(s, s));
+      addnode(attrs, newallocattr(intern(s, strlen(s)), s));
       lexnocomment();
     }
     return parseoperationrest(tok, eal, attrs);
 }
 
 
+/* The range of each integer type, for checking const and default
+ * values. */
+static const struct {
+    const char *type;
+    long long min;
+    unsigned long long max;
+} integerranges[] = {
+    { "byte", -128, 127 },
+    { "octet", 0, 255 },
+    { "short", -32768, 32767 },
+    { "unsigned short", 0, 65535 },
+    { "long", -2147483647 - 1, 2147483647 },
+    { "unsigned long", 0, 4294967295U },
+    { "long long", LLONG_MIN, LLONG_MAX },
+    { "unsigned long long", 0, ULLONG_MAX },
+};
+
+/***********************************************************************
+ * valuetype : get the declared type of what a value is for
+ *
+ * Enter:   node = Const, Argument or DictionaryMember element, with its
+ *                 Type element already added
+ *
+ * Return:  type attribute of the Type element, 0 if it has none, as for
+ *          a typedef name
+ */
+static const char *
+valuetype(struct node *node)
+{
+    struct node *child;
+    for (child = nextelement(node->children); child;
+            child = nextelement(child->next))
+    {
+        if (((struct element *)child)->name == NAME_Type)
+            return getattr(child, NAME_type);
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * isintegertype : test whether a type is an integer type
+ */
+static int
+isintegertype(const char *type)
+{
+    unsigned int i;
+    for (i = 0; i != sizeof(integerranges) / sizeof(integerranges[0]); i++) {
+        if (!strcmp(type, integerranges[i].type))
+            return 1;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ * checkinteger : check an integer value against an integer type
+ *
+ * Enter:   tok = token of the value
+ *          type = declared type
+ *          value = VALUE_INTEGER or VALUE_UNSIGNED value
+ *
+ * A type that is not an integer type is not checked.
+ */
+static void
+checkinteger(struct tok *tok, const char *type,
+             const struct constvalue *value)
+{
+    unsigned int i;
+    for (i = 0; i != sizeof(integerranges) / sizeof(integerranges[0]); i++) {
+        if (strcmp(type, integerranges[i].type))
+            continue;
+        if (value->kind == VALUE_UNSIGNED
+                ? value->u.uinteger > integerranges[i].max
+                : value->u.integer < integerranges[i].min
+                    || (value->u.integer > 0 && (unsigned long long)
+                        value->u.integer > integerranges[i].max))
+        {
+            tokerrorexit(tok, "value out of range for %s", type);
+        }
+        return;
+    }
+}
+
+/***********************************************************************
+ * evalnumber : evaluate a numeric const or default value
+ *
+ * Enter:   tok = TOK_INTEGER, TOK_FLOAT, TOK_infinity, TOK_minusinfinity
+ *                or TOK_NaN token
+ *          type = declared type, 0 if not known
+ *          value = where to put the value
+ *          text = the token's text
+ *
+ * Return:  allocated normalized text of the value
+ *
+ * An integer is kept as a 64-bit integer, except that one for a float or
+ * double is converted, and any other value as a double, rounded to
+ * float precision for a float. A value too big for 64 bits or a double,
+ * outside the range of its declared type, or not an integer for an
+ * integer type, is an error. The
+ * normalized text is decimal for a whole number that is not huge, or
+ * else the shortest text that gives back the same float or double.
+ */
+static char *
+evalnumber(struct tok *tok, const char *type, struct constvalue *value,
+           const char *text)
+{
+    const char *base = type;
+    int unrestricted = 0, isfloat, issingle, precision;
+    char *s;
+    if (base && !strncmp(base, "unrestricted ", 13)) {
+        base += 13;
+        unrestricted = 1;
+    }
+    isfloat = base && (!strcmp(base, "float") || !strcmp(base, "double"));
+    if (tok->type == TOK_INTEGER) {
+        int neg = *text == '-';
+        unsigned long long u;
+        errno = 0;
+        u = strtoull(text + neg, 0, 0);
+        if (errno == ERANGE || (neg && u > (unsigned long long)LLONG_MAX + 1))
+            tokerrorexit(tok, "integer too big for 64 bits");
+        if (neg) {
+            value->kind = VALUE_INTEGER;
+            value->u.integer = u > LLONG_MAX ? LLONG_MIN : -(long long)u;
+        } else if (u > LLONG_MAX) {
+            value->kind = VALUE_UNSIGNED;
+            value->u.uinteger = u;
+        } else {
+            value->kind = VALUE_INTEGER;
+            value->u.integer = u;
+        }
+        if (!isfloat) {
+            if (type)
+                checkinteger(tok, type, value);
+            return value->kind == VALUE_UNSIGNED
+                    ? memprintf("%llu", value->u.uinteger)
+                    : memprintf("%lld", value->u.integer);
+        }
+        value->u.number = value->kind == VALUE_UNSIGNED
+                ? (double)value->u.uinteger : (double)value->u.integer;
+    } else if (type && isintegertype(type))
+        tokerrorexit(tok, "value for %s must be an integer", type);
+    else if (tok->type == TOK_FLOAT) {
+        errno = 0;
+        value->u.number = strtod(text, 0);
+        if (errno == ERANGE && (value->u.number > 1 || value->u.number < -1))
+            tokerrorexit(tok, "value out of range for double");
+    } else if (tok->type == TOK_NaN)
+        value->u.number = NAN;
+    else
+        value->u.number = tok->type == TOK_infinity ? HUGE_VAL : -HUGE_VAL;
+    value->kind = VALUE_FLOAT;
+    if (isfloat && !unrestricted && !isfinite(value->u.number))
+        tokerrorexit(tok, "value out of range for %s", type);
+    if (isnan(value->u.number))
+        return memprintf("NaN");
+    if (isinf(value->u.number))
+        return memprintf(value->u.number < 0 ? "-Infinity" : "Infinity");
+    issingle = isfloat && !strcmp(base, "float");
+    if (issingle) {
+        /* Round first, as a literal a little over FLT_MAX, such as
+         * FLT_MAX itself written to 8 digits, rounds down to it. */
+        float f = (float)value->u.number;
+        if (isinf(f))
+            tokerrorexit(tok, "value out of range for %s", type);
+        value->u.number = f;
+    }
+    if (value->u.number < 1e15 && value->u.number > -1e15
+            && value->u.number == (long long)value->u.number)
+    {
+        return memprintf("%.0f", value->u.number);
+    }
+    for (precision = 1; ; precision++) {
+        s = memprintf("%.*g", precision, value->u.number);
+        if (issingle ? precision == 9
+                    || (float)strtod(s, 0) == value->u.number
+                : precision == 17 || strtod(s, 0) == value->u.number)
+        {
+            return s;
+        }
+        memfree(s);
+    }
+}
+
 /***********************************************************************
  * parseconstexpr : parse ConstValue
  *
  * Enter:   tok = next token
- *          node
+ *          node = Const, Argument or DictionaryMember element
  *
  * Return:  node updated with value
  *          tok updated
+ *
+ * The value is evaluated into the element's constvalue. A number also
+ * gets a normalized attribute if its normalized text is not the same as
+ * its text, such as for hex or octal.
  */
 static struct node *
 parseconstexpr (struct tok *tok, struct node *node) {
-  char *s;
+  struct constvalue *value = memalloc(sizeof(struct constvalue));
+  char *s, *normalized = 0;
+  int isnumber = 0;
   switch(tok->type) {
   case TOK_true:
   case TOK_false:
+    value->kind = VALUE_BOOLEAN;
+    value->u.integer = tok->type == TOK_true;
+    break;
+  case TOK_null:
+    value->kind = VALUE_NULL;
+    break;
   case TOK_minusinfinity:
   case TOK_INTEGER:
   case TOK_FLOAT:
-  case TOK_null:
   case TOK_infinity:
   case TOK_NaN:
+    isnumber = 1;
     break;
   default:
     tokerrorexit(tok, "expected constant value");
@@ -1130,7 +1381,17 @@ parseconstexpr (struct tok *tok, struct node *node) {
   s = memalloc(tok->len + 1);
   memcpy(s, tok->start, tok->len);
   s[tok->len] = 0;
-  addnode(node, newattr("value", s));
+  if (isnumber) {
+    normalized = evalnumber(tok, valuetype(node), value, s);
+    if (!strcmp(normalized, s)) {
+      memfree(normalized);
+      normalized = 0;
+    }
+  }
+  addnode(node, newallocattr(NAME_value, s));
+  if (normalized)
+    addnode(node, newallocattr(NAME_normalized, normalized));
+  ((struct element *)node)->constvalue = value;
   lexnocomment();
   return node;
 }
@@ -1151,13 +1412,17 @@ parsedefaultvalue (struct tok *tok, struct node *node) {
     s = memalloc(tok->len + 1);
     memcpy(s, tok->start, tok->len);
     s[tok->len] = 0;
-    addnode(node, newattr("stringvalue", s));
+    addnode(node, newallocattr(NAME_stringvalue, s));
+    ((struct element *)node)->constvalue = memalloc(sizeof(struct constvalue));
+    ((struct element *)node)->constvalue->kind = VALUE_STRING;
     lexnocomment();
     return node;
   } else if (tok->type == '[') {
     eat(tok, '[');
     eat(tok, ']');
-    addnode(node, newattr("value", "[]"));
+    addnode(node, newattr(NAME_value, "[]"));
+    ((struct element *)node)->constvalue = memalloc(sizeof(struct constvalue));
+    ((struct element *)node)->constvalue->kind = VALUE_SEQUENCE;
     return node;
   } else {
     return parseconstexpr(tok, node);
@@ -1178,17 +1443,17 @@ parsedefaultvalue (struct tok *tok, struct node *node) {
 static struct node *
 parsedictionarymember(struct tok *tok, struct node *eal)
 {
-    struct node *node = newelement("DictionaryMember");
+    struct node *node = newelement(NAME_DictionaryMember);
     if (eal) addnode(node, eal);
     setcommentnode(node);
     if (tok->type == TOK_required) {
       eat(tok, TOK_required);
-      addnode(node, newattr("required", "required"));
+      addnode(node, newattr(NAME_required, "required"));
       addnode(node, parsetypewithextendedattributes(tok));
     } else {
       addnode(node, parsetype(tok));
     }
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     tok = lexnocomment();
     // Optional value
     if (tok->type == '=') {
@@ -1210,7 +1475,7 @@ parsedictionarymember(struct tok *tok, struct node *eal)
 static struct node *
 parseconst(struct tok *tok, struct node *eal)
 {
-    struct node *node = newelement("Const");
+    struct node *node = newelement(NAME_Const);
     setcommentnode(node);
     if (eal) addnode(node, eal);
     tok = lexnocomment();
@@ -1231,7 +1496,7 @@ parseconst(struct tok *tok, struct node *eal)
         tokerrorexit(tok, "expected acceptable constant type");
         break;
     }
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     tok = lexnocomment();
     eat(tok, '=');
     node = parseconstexpr(tok, node);
@@ -1250,12 +1515,12 @@ parseconst(struct tok *tok, struct node *eal)
 static struct node *
 parseimplementsstatement(struct tok *tok, struct node *eal)
 {
-    struct node *node = newelement("Implements");
+    struct node *node = newelement(NAME_Implements);
     setcommentnode(node);
     if (eal) addnode(node, eal);
-    addnode(node, parsescopedname(tok, "name1", 1));
+    addnode(node, parsescopedname(tok, NAME_name1, 1));
     eat(tok, TOK_implements);
-    addnode(node, parsescopedname(tok, "name2", 1));
+    addnode(node, parsescopedname(tok, NAME_name2, 1));
     return node;
 }
 
@@ -1272,38 +1537,117 @@ static struct node *
 parsetypedef(struct tok *tok, struct node *eal)
 {
     struct node *typenode;
-    struct node *node = newelement("Typedef");
+    struct node *node = newelement(NAME_Typedef);
     setcommentnode(node);
     if (eal) addnode(node, eal);
     tok = lexnocomment();
     typenode = parsetypewithextendedattributes(tok);
     addnode(node, typenode);
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     tok = lexnocomment();
     return node;
 }
 
+/* Members or enum values seen so far in the definition being parsed,
+ * for checkduplicate, when it is not one whose members are kept in
+ * interfacemembers or dictionarymembers. It is static so that a
+ * definition abandoned by an error that -lsp or -watch recovers from
+ * does not leak it; the next definition frees whatever is left before
+ * starting. */
+static struct hashtable members;
+
+/* Members seen so far in an interface or dictionary and its partials. */
+struct seenmembers {
+    struct hashtable members;
+    int defined; /* the definition itself, not just partials, seen */
+};
+
+/* Members seen so far in each interface and dictionary of the input
+ * being parsed, keyed by name, each an allocated struct seenmembers,
+ * so that the members of a partial are checked against those of the
+ * definition it extends and its other partials without waiting for
+ * -merge-partials. They are kept only as long as the nodes they point
+ * to, so streamed input checks each definition on its own. */
+static struct hashtable interfacemembers, dictionarymembers;
+
+/***********************************************************************
+ * findmembers : find the members seen so far in a definition and its
+ *               partials
+ *
+ * Enter:   definitions = interfacemembers or dictionarymembers
+ *          name = name of the definition, which must live as long as
+ *                 the table
+ *          partial = whether the definition being parsed is partial
+ *
+ * Return:  hashtable of the members, created empty if none yet, else 0
+ *          if this is a second non-partial definition of the name
+ *
+ * As in mergepartials, partials extend the first non-partial
+ * definition of the name, so a later one is checked on its own.
+ */
+static struct hashtable *
+findmembers(struct hashtable *definitions, const char *name, int partial)
+{
+    void **pvalue = hashput(definitions, name, strlen(name));
+    struct seenmembers *seen = *pvalue;
+    if (!seen)
+        *pvalue = seen = memalloc(sizeof(struct seenmembers));
+    if (!partial) {
+        if (seen->defined)
+            return 0;
+        seen->defined = 1;
+    }
+    return &seen->members;
+}
+
+/***********************************************************************
+ * freemembers : free the members seen so far in each definition
+ *
+ * Enter:   definitions = interfacemembers or dictionarymembers
+ */
+static void
+freemembers(struct hashtable *definitions)
+{
+    unsigned int i;
+    for (i = 0; i != definitions->max; i++) {
+        struct seenmembers *seen = definitions->entries[i].value;
+        if (definitions->entries[i].key) {
+            hashfree(&seen->members);
+            memfree(seen);
+        }
+    }
+    hashfree(definitions);
+}
+
 /***********************************************************************
  * parseinterface : parse [4] Interface
  *
  * Enter:   tok = next token, known to be TOK_interface
  *          eal = 0 else extended attribute list node
+ *          partial = whether it is a partial interface
  *
  * Return:  new node for the interface
  *          tok updated to the terminating ';'
  */
 static struct node *
-parseinterface(struct tok *tok, struct node *eal)
+parseinterface(struct tok *tok, struct node *eal, int partial)
 {
-    struct node *node = newelement("Interface");
+    struct node *node = newelement(NAME_Interface);
+    struct hashtable *seen;
+    char *name;
     if (eal) addnode(node, eal);
     setcommentnode(node);
     tok = lexnocomment();
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, name = setidentifier(tok)));
+    seen = findmembers(&interfacemembers, name, partial);
+    if (!seen) {
+        hashfree(&members);
+        seen = &members;
+    }
     tok = lexnocomment();
     if (tok->type == ':') {
         lexnocomment();
-        addnode(node, parsescopednamelist(tok, "InterfaceInheritance", "Name", 1));
+        addnode(node, parsescopednamelist(tok, NAME_InterfaceInheritance, NAME_Name, 1));
     }
     eat(tok, '{');
     while (tok->type != '}') {
@@ -1317,9 +1661,11 @@ parseinterface(struct tok *tok, struct node *eal)
         node2->wsstart = start;
         node2->end = tok->start + tok->len;
         setid(node2);
+        checkduplicate(seen, node2, node);
         eat(tok, ';');
     }
     lexnocomment();
+    hashfree(&members);
     return node;
 }
 
@@ -1337,18 +1683,18 @@ parsecallback(struct tok *tok, struct node *eal)
 {
   struct node *node;
   if (tok->type == TOK_interface) {
-    node = parseinterface(tok, eal);
-    addnode(node, newattr("callback", "callback"));    
+    node = parseinterface(tok, eal, 0);
+    addnode(node, newattr(NAME_callback, "callback"));    
   } else {
-    node = newelement("Callback");
+    node = newelement(NAME_Callback);
     if (eal) addnode(node, eal);
     setcommentnode(node);
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     tok = lexnocomment();
     eat(tok, '=');
     addnode(node, parsereturntype(tok));
     eat(tok, '(');
-    addnode(node, parseargumentlist(tok));
+    addnode(node, parseargumentlist(tok, node));
     eat(tok, ')');
   }
   return node;
@@ -1359,22 +1705,30 @@ parsecallback(struct tok *tok, struct node *eal)
  *
  * Enter:   tok = next token, known to be TOK_dictionary
  *          eal = 0 else extended attribute list node
+ *          partial = whether it is a partial dictionary
  *
  * Return:  new node for the dictionary
  *          tok updated to the terminating ';'
  */
 static struct node *
-parsedictionary(struct tok *tok, struct node *eal)
+parsedictionary(struct tok *tok, struct node *eal, int partial)
 {
-    struct node *node = newelement("Dictionary");
+    struct node *node = newelement(NAME_Dictionary);
+    struct hashtable *seen;
+    char *name;
     if (eal) addnode(node, eal);
     setcommentnode(node);
     tok = lexnocomment();
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, name = setidentifier(tok)));
+    seen = findmembers(&dictionarymembers, name, partial);
+    if (!seen) {
+        hashfree(&members);
+        seen = &members;
+    }
     tok = lexnocomment();
     if (tok->type == ':') {
         lexnocomment();
-        addnode(node, parsescopednamelist(tok, "DictionaryInheritance", "Name", 1));
+        addnode(node, parsescopednamelist(tok, NAME_DictionaryInheritance, NAME_Name, 1));
     }
     eat(tok, '{');
     while (tok->type != '}') {
@@ -1388,9 +1742,11 @@ parsedictionary(struct tok *tok, struct node *eal)
         node2->wsstart = start;
         node2->end = tok->start + tok->len;
         setid(node2);
+        checkduplicate(seen, node2, node);
         eat(tok, ';');
     }
     lexnocomment();
+    hashfree(&members);
     return node;
 }
 
@@ -1407,27 +1763,29 @@ static struct node *
 parseenum(struct tok *tok, struct node *eal)
 {
 	char *s;
-    struct node *node = newelement("Enum");
+    struct node *node = newelement(NAME_Enum);
+    hashfree(&members);
     if (eal) addnode(node, eal);
     setcommentnode(node);
     tok = lexnocomment();
-    addnode(node, newattr("name", setidentifier(tok)));
+    addnode(node, newallocattr(NAME_name, setidentifier(tok)));
     tok = lexnocomment();
     eat(tok, '{');
     while (tok->type != '}') {
       if (tok->type == TOK_STRING) {
 	const char *start = tok->prestart;
-	struct node *node2 = newelement("EnumValue");
+	struct node *node2 = newelement(NAME_EnumValue);
 	setcommentnode(node2);
 	
 	s = memalloc(tok->len + 1);
 	memcpy(s, tok->start, tok->len);
 	s[tok->len] = 0;
-	addnode(node2, newattr("stringvalue", s));
+	addnode(node2, newallocattr(NAME_stringvalue, s));
         node2->wsstart = start;
         node2->end = tok->start + tok->len;
         setid(node2);
 	addnode(node, node2);
+	checkduplicate(&members, node2, node);
       } else {
 	tokerrorexit(tok, "expected string in enum");
       }
@@ -1437,87 +1795,179 @@ parseenum(struct tok *tok, struct node *eal)
       }
     }
     eat(tok, '}');
+    hashfree(&members);
     return node;
 }
 
 /***********************************************************************
- * parsedefinitions : parse [1] Definitions
+ * parsedefinition : parse [2] Definition
  *
  * Enter:   tok = next token
- *          parent = parent node to add definitions to
+ *          parent = parent node to add definition to, or 0 to leave
+ *                   it unattached
  *
- * On return, tok has been updated.
+ * Return:  0 if no definition (not an error), else new node
+ *          tok updated
  */
-static void
-parsedefinitions(struct tok *tok, struct node *parent)
+static struct node *
+parsedefinition(struct tok *tok, struct node *parent)
 {
-    parent->wsstart = tok->prestart;
-    for (;;) {
-        const char *wsstart = tok->prestart;
-        struct node *eal = parseextendedattributelist(tok);
-        struct node *node;
-        switch (tok->type) {
-        case TOK_partial:
+    const char *wsstart = tok->prestart;
+    struct node *eal = parseextendedattributelist(tok);
+    struct node *node;
+    switch (tok->type) {
+    case TOK_partial:
 	    eat(tok, TOK_partial);
 	    if (tok->type == TOK_dictionary) {
-	      node = parsedictionary(tok, eal);
+	      node = parsedictionary(tok, eal, 1);
 	    } else {
-	      node = parseinterface(tok, eal);
+	      node = parseinterface(tok, eal, 1);
 	    }
-	    addnode(node, newattr("partial", "partial"));
-            break;
-        case TOK_interface:
-  	    node = parseinterface(tok, eal);
-            break;
+	    addnode(node, newattr(NAME_partial, "partial"));
+        break;
+    case TOK_interface:
+  	    node = parseinterface(tok, eal, 0);
+        break;
 	case TOK_callback:
 	    eat(tok, TOK_callback);
 	    node = parsecallback(tok, eal);
-            break;
+        break;
 	case TOK_dictionary:
-            node = parsedictionary(tok, eal);
-            break;	  
+        node = parsedictionary(tok, eal, 0);
+        break;	  
 	case TOK_enum:
-            node = parseenum(tok, eal);
-            break;	  
-        case TOK_typedef:
-            node = parsetypedef(tok, eal);
-            break;
-        case TOK_IDENTIFIER:
-            node = parseimplementsstatement(tok, eal);
-            break;
-        default:
-            if (eal)
-                tokerrorexit(tok, "expected definition after extended attribute list");
-            node = 0;
-            break;
-        }
-        if (!node)
-            break;
-        node->wsstart = wsstart;
-        node->end = tok->start + tok->len;
-        eat(tok, ';');
+        node = parseenum(tok, eal);
+        break;	  
+    case TOK_typedef:
+        node = parsetypedef(tok, eal);
+        break;
+    case TOK_IDENTIFIER:
+        node = parseimplementsstatement(tok, eal);
+        break;
+    default:
+        if (eal)
+            tokerrorexit(tok, "expected definition after extended attribute list");
+        node = 0;
+        break;
+    }
+    if (!node)
+        return 0;
+    node->wsstart = wsstart;
+    node->end = tok->start + tok->len;
+    eat(tok, ';');
+    setid(node);
+    if (parent) {
         addnode(parent, node);
-        setid(node);
         parent->end = node->end;
     }
+    return node;
+}
+
+/***********************************************************************
+ * parsedefinitions : parse [1] Definitions
+ *
+ * Enter:   tok = next token
+ *          parent = parent node to add definitions to
+ *
+ * On return, tok has been updated.
+ */
+static void
+parsedefinitions(struct tok *tok, struct node *parent)
+{
+    /* end is set here too in case there are no definitions. */
+    parent->wsstart = parent->end = tok->prestart;
+    while (parsedefinition(tok, parent))
+        ;
 }
 
 /***********************************************************************
  * parse
  *
  * Return:  root element containing (possibly empty) list of definitions
+ *
+ * Typeforms are not set, as they are never freed, so setting them on
+ * each parse would grow memory in -lsp and -watch; the callers whose
+ * passes use them call settypeforms.
  */
 struct node *
 parse(void)
 {
 	struct tok *tok; 
-    struct node *root = newelement("Definitions");
+    struct node *root = newelement(NAME_Definitions);
+    nesting = 0;
+    nocomments = 0;
+    freemembers(&interfacemembers);
+    freemembers(&dictionarymembers);
     setcommentnode(root);
     tok = lexnocomment();
     parsedefinitions(tok, root);
     if (tok->type != TOK_EOF)
         tokerrorexit(tok, "expected end of input");
-    reversechildren(root);
+    freemembers(&interfacemembers);
+    freemembers(&dictionarymembers);
+    setfqids(root);
     return root;
 }
 
+/***********************************************************************
+ * parsenextdefinition : parse the next definition of streamed input
+ *
+ * Return:  0 if no more input, else the definition, not attached to any
+ *          parent, with fully qualified ids set
+ *
+ * Input must have been opened with openstream. Each call reads the next
+ * unit of input, releasing the previous one, so the caller must have
+ * finished with the previous definition. Comments are recorded for
+ * processcomments, except that those in a unit with no definition are
+ * discarded. As with parse, typeforms are not set.
+ */
+struct node *
+parsenextdefinition(void)
+{
+    while (nextunit()) {
+        struct tok *tok;
+        struct node *node;
+        nesting = 0;
+        freemembers(&interfacemembers);
+        freemembers(&dictionarymembers);
+        tok = lexnocomment();
+        node = parsedefinition(tok, 0);
+        if (tok->type != TOK_EOF)
+            tokerrorexit(tok, "expected end of input");
+        if (node) {
+            setfqids(node);
+            return node;
+        }
+        discardcomments();
+    }
+    freemembers(&interfacemembers);
+    freemembers(&dictionarymembers);
+    return 0;
+}
+
+/***********************************************************************
+ * parsewithevents : parse, sending events instead of building a tree
+ *
+ * Enter:   events = callbacks
+ *
+ * The input must have been opened with openstream. It is read, parsed
+ * and sent a definition at a time, as by parsenextdefinition: the events
+ * for each definition and its members are sent as soon as it has been
+ * parsed, and then its nodes and text are freed, so memory use does not
+ * grow with the size of the input. The events for the Definitions root
+ * element enclose all of them. Comments are discarded.
+ */
+void
+parsewithevents(const struct nodeevents *events)
+{
+    struct node *node;
+    nocomments = 1;
+    (*events->startelement)(events->context, NAME_Definitions, 0);
+    while ((node = parsenextdefinition())) {
+        sendevents(node, events);
+        freenode(node);
+    }
+    (*events->endelement)(events->context, NAME_Definitions);
+    nocomments = 0;
+}
+
@@ -14,6 +14,10 @@
 #ifndef parse_h
 #define parse_h
 
+struct nodeevents;
+
 struct node *parse(void);
+struct node *parsenextdefinition(void);
+void parsewithevents(const struct nodeevents *events);
 
 #endif /* ndef parse_h */
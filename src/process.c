@@ -14,34 +14,80 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef _MSC_VER
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "ast.h"
 #include "comment.h"
+#include "deps.h"
+#include "exposure.h"
+#include "inherit.h"
 #include "lex.h"
+#include "merge.h"
 #include "misc.h"
 #include "node.h"
 #include "os.h"
+#include "overload.h"
 #include "parse.h"
 #include "process.h"
+#include "type.h"
 
 #if 0
 static const char ntnames[] = { NTNAMES };
 #endif /*0*/
 
 /***********************************************************************
- * printtext : print text with xml entity escapes
+ * struct textbuf : growable buffer that escapetext can write into
+ */
+struct textbuf {
+    char *buf;
+    size_t len;
+    size_t max;
+};
+
+/***********************************************************************
+ * writetext : write bytes to a textbuf or to stdout
  *
- * Enter:   s = text
+ * Enter:   textbuf = 0 to write to stdout, else buffer to append to
+ *          s = bytes to write
+ *          len = number of bytes
+ */
+static void
+writetext(struct textbuf *textbuf, const char *s, size_t len)
+{
+    if (!textbuf) {
+        if (len != fwrite(s, 1, len, stdout))
+            errorexit("write error");
+        return;
+    }
+    if (textbuf->len + len + 1 > textbuf->max) {
+        while (textbuf->len + len + 1 > textbuf->max)
+            textbuf->max = textbuf->max ? 2 * textbuf->max : 64;
+        textbuf->buf = memrealloc(textbuf->buf, textbuf->max);
+    }
+    memcpy(textbuf->buf + textbuf->len, s, len);
+    textbuf->len += len;
+}
+
+/***********************************************************************
+ * escapetext : write text with xml entity escapes
+ *
+ * Enter:   textbuf = 0 to write to stdout, else buffer to append to
+ *          s = text
  *          len = number of bytes
  *          escamp = whether to escape &
  *
  * This also escapes double quote mark so it can be used for an
  * attribute value. It also turns a tab into spaces.
  */
-void
-printtext(const char *s, unsigned int len, int escamp)
+static void
+escapetext(struct textbuf *textbuf, const char *s, size_t len,
+           int escamp)
 {
     const int tabLen = 8; // must be 8 or less 
     const char *p = s, *end = s + len;
-    unsigned int count = 0;
+    size_t count = 0;
     while (p != end) {
         int ch = *p;
         char buf[9];
@@ -76,13 +122,48 @@ printtext(const char *s, unsigned int len, int escamp)
             seq = buf;
             break;
         }
-        if (p - s != fwrite(s, 1, p - s, stdout))
-            errorexit("write error");
-        fputs(seq, stdout);
+        writetext(textbuf, s, p - s);
+        writetext(textbuf, seq, strlen(seq));
         s = ++p;
     }
-    if (p - s != fwrite(s, 1, p - s, stdout))
-        errorexit("write error");
+    writetext(textbuf, s, p - s);
+}
+
+/***********************************************************************
+ * printtext : print text with xml entity escapes
+ *
+ * Enter:   s = text
+ *          len = number of bytes
+ *          escamp = whether to escape &
+ *
+ * This also escapes double quote mark so it can be used for an
+ * attribute value. It also turns a tab into spaces.
+ */
+void
+printtext(const char *s, size_t len, int escamp)
+{
+    escapetext(0, s, len, escamp);
+}
+
+/***********************************************************************
+ * memprinttext : allocate buffer and print text into it with xml
+ *                entity escapes
+ *
+ * Enter:   s = text
+ *          len = number of bytes
+ *          escamp = whether to escape &
+ *
+ * Return:  allocated 0-terminated string
+ */
+char *
+memprinttext(const char *s, size_t len, int escamp)
+{
+    struct textbuf textbuf = { 0, 0, 0 };
+    /* Make sure the buffer is allocated even if the text is empty. */
+    writetext(&textbuf, "", 0);
+    escapetext(&textbuf, s, len, escamp);
+    textbuf.buf[textbuf.len] = 0;
+    return textbuf.buf;
 }
 
 #if 0
@@ -303,20 +384,191 @@ outputchildren(struct node *node, struct node *identifier, unsigned int indent)
 #endif /*0*/
 
 /***********************************************************************
- * processfiles : process input files
+ * processstream : process input files a definition at a time
  *
- * Enter:   name = filename
+ * Enter:   names = 0-terminated array of filenames
+ *
+ * Each definition is output, and its memory and source text released,
+ * as soon as it and its comments have been parsed. The <webidl> of the
+ * root element is left empty, and comments not in any definition are
+ * discarded.
  */
-void
-processfiles(const char *const *names, int dtdref)
+static void
+processstream(const char *const *names)
+{
+    struct node *node;
+    openstream(names);
+    printf("<Definitions>\n  <webidl></webidl>\n");
+    while ((node = parsenextdefinition())) {
+        processcomments(node);
+        outputnode(node, 2);
+        freenode(node);
+        fflush(stdout);
+    }
+    printf("</Definitions>\n");
+}
+
+/* struct eventtrace : context for the -format=events callbacks */
+struct eventtrace {
+    unsigned int depth;
+};
+
+/***********************************************************************
+ * tracestart, traceattribute, traceend : output one line for an event
+ *
+ * Each line is indented by the depth of the element it is in.
+ */
+static void
+tracestart(void *context, int name, const char *id)
+{
+    struct eventtrace *trace = context;
+    printf("%*sstart %s", 2 * trace->depth++, "", atomname(name));
+    if (id)
+        printf(" %s", id);
+    putchar('\n');
+}
+
+static void
+traceattribute(void *context, int name, const char *value)
+{
+    struct eventtrace *trace = context;
+    printf("%*sattribute %s %s\n", 2 * trace->depth, "", atomname(name),
+            value);
+}
+
+static void
+traceend(void *context, int name)
+{
+    struct eventtrace *trace = context;
+    printf("%*send %s\n", 2 * --trace->depth, "", atomname(name));
+}
+
+/***********************************************************************
+ * processevents : output the events parsewithevents sends
+ *
+ * Enter:   names = 0-terminated array of filenames
+ *
+ * Like -stream, this reads and frees the input a definition at a time.
+ */
+static void
+processevents(const char *const *names)
+{
+    struct eventtrace trace;
+    struct nodeevents events;
+    trace.depth = 0;
+    events.context = &trace;
+    events.startelement = tracestart;
+    events.attribute = traceattribute;
+    events.endelement = traceend;
+    openstream(names);
+    parsewithevents(&events);
+}
+
+/***********************************************************************
+ * buildtree : read and parse the input files and run the passes
+ *
+ * Enter:   names = 0-terminated array of filenames
+ *          flags = PROCESS_* flags
+ *
+ * Return:  root of parse tree
+ */
+static struct node *
+buildtree(const char *const *names, unsigned int flags)
 {
     struct node *root;
     readinput(names);
     root = parse();
+    if (flags & PROCESS_TYPEFORMS)
+        settypeforms(root);
     processcomments(root);
+    /* The source is built before merging, while the tree is still in
+     * the order of the input. */
+    if (flags & PROCESS_WEBIDLOFFSETS)
+        buildsource(root);
+    if (flags & PROCESS_MERGEPARTIALS)
+        mergepartials(root);
+    /* Exposure goes before the passes that point into members, as
+     * -exposed= frees the members it removes. */
+    if (flags & PROCESS_EXPOSURE)
+        computeexposure(root);
+    if (flags & PROCESS_FLATTEN)
+        flattendefinitions(root);
+    if (flags & PROCESS_RESOLVETYPEDEFS)
+        resolvetypedefs(root);
+    if (flags & PROCESS_FLATTENUNIONS)
+        flattenunions(root);
+    if (flags & PROCESS_OVERLOADS)
+        computeoverloads(root);
+    if (flags & PROCESS_EXTATTRS)
+        addextattrindex(root);
+    return root;
+}
+
+/***********************************************************************
+ * processfiles : process input files
+ *
+ * Enter:   names = 0-terminated array of filenames
+ *          flags = PROCESS_* flags
+ */
+void
+processfiles(const char *const *names, unsigned int flags)
+{
+    struct node *root;
+    if (flags & PROCESS_EVENTS) {
+        processevents(names);
+        return;
+    }
+    if (flags & PROCESS_STREAM) {
+        printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        if (flags & PROCESS_DTDREF)
+            printf("<!DOCTYPE Definitions SYSTEM \"widlprocxml.dtd\">\n");
+        processstream(names);
+        return;
+    }
+    root = buildtree(names, flags);
+    if (flags & PROCESS_DEPS) {
+        /* The graph is found from the compact copy alone, so the parse
+         * tree is freed before it is built. */
+        struct ast *ast = buildast(root);
+        freenode(root);
+        outputdeps(ast, flags & PROCESS_DEPSDOT);
+        freeast(ast);
+        return;
+    }
+    if (flags & PROCESS_BINARY) {
+        struct ast *ast = buildast(root);
+#ifdef _MSC_VER
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        writeast(ast, stdout);
+        freeast(ast);
+        freenode(root);
+        return;
+    }
     printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-    if(dtdref)
+    if (flags & PROCESS_DTDREF)
         printf("<!DOCTYPE Definitions SYSTEM \"widlprocxml.dtd\">\n");
     outputnode(root, 0);
+    freenode(root);
 }
 
+/***********************************************************************
+ * checkbinary : check a binary file against the input files
+ *
+ * Enter:   names = 0-terminated array of filenames
+ *          filename = name of file written with -format=binary
+ *          flags = PROCESS_* flags it was written with
+ *
+ * This exits with an error if the file is corrupt or is not what
+ * -format=binary would write now, as when it is out of date.
+ */
+void
+checkbinary(const char *const *names, const char *filename,
+            unsigned int flags)
+{
+    struct node *root = buildtree(names, flags);
+    struct ast *ast = mapast(filename);
+    checkast(ast, root, filename);
+    freeast(ast);
+    freenode(root);
+}
@@ -13,15 +13,45 @@
  ***********************************************************************/
 #ifndef process_h
 #define process_h
+#include <stddef.h>
 
 #if 0
 #define NT_START 0x100
 #include "nonterminals.h"
 #endif/*0*/
 
-void printtext(const char *s, unsigned int len, int escamp);
+void printtext(const char *s, size_t len, int escamp);
+char *memprinttext(const char *s, size_t len, int escamp);
 
-void processfiles(const char *const *names, int dtdref);
+/* Flags for processfiles */
+#define PROCESS_DTDREF 1 /* output DOCTYPE referring to widlprocxml.dtd */
+#define PROCESS_WEBIDLOFFSETS 2 /* output source once, <webidl> as offsets */
+#define PROCESS_STREAM 4 /* read, parse and output a definition at a time */
+#define PROCESS_BINARY 8 /* output binary format written by writeast */
+#define PROCESS_MERGEPARTIALS 16 /* merge partial definitions */
+#define PROCESS_FLATTEN 32 /* add flattened member list of definitions */
+#define PROCESS_RESOLVETYPEDEFS 64 /* add resolved type of typedef uses */
+#define PROCESS_FLATTENUNIONS 128 /* add flattened member types of unions */
+#define PROCESS_OVERLOADS 256 /* add and check overload sets */
+#define PROCESS_EXPOSURE 512 /* add exposure of interfaces and members */
+#define PROCESS_EXTATTRS 1024 /* add known extended attributes of lists */
+#define PROCESS_DEPS 2048 /* output dependency graph instead of XML */
+#define PROCESS_DEPSDOT 4096 /* output it in Graphviz dot, not JSON */
+#define PROCESS_EVENTS 8192 /* output the events of parsewithevents */
+/* The passes that need every definition parsed together, so cannot be
+ * used with PROCESS_STREAM, PROCESS_EVENTS or watching. */
+#define PROCESS_WHOLETREE (PROCESS_MERGEPARTIALS | PROCESS_FLATTEN \
+        | PROCESS_RESOLVETYPEDEFS | PROCESS_FLATTENUNIONS \
+        | PROCESS_OVERLOADS | PROCESS_EXPOSURE | PROCESS_EXTATTRS \
+        | PROCESS_DEPS)
+
+/* The passes that read the typeform of each Type element. */
+#define PROCESS_TYPEFORMS (PROCESS_RESOLVETYPEDEFS | PROCESS_FLATTENUNIONS \
+        | PROCESS_OVERLOADS)
+
+void processfiles(const char *const *names, unsigned int flags);
+void checkbinary(const char *const *names, const char *filename,
+        unsigned int flags);
 
 #endif /* ndef process_h */
 
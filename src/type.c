@@ -0,0 +1,479 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Interning of the structure of Type elements
+ ***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "misc.h"
+#include "node.h"
+#include "type.h"
+
+/* The typeforms made so far, keyed by their canonical text. */
+static struct hashtable typeforms;
+
+/* Buffer that the canonical text of a type is built in. */
+static char *keybuf;
+static size_t keylen, keymax;
+
+/* Buffer that interntype collects the typeforms of child types in. */
+static const struct typeform **params;
+static unsigned int parammax;
+
+/* The Type elements found by settypeforms. */
+static struct node **typenodes;
+static size_t typenodemax;
+
+/***********************************************************************
+ * addkey : append text to keybuf
+ *
+ * Enter:   s = 0-terminated text
+ */
+static void
+addkey(const char *s)
+{
+    size_t len = strlen(s);
+    if (keylen + len > keymax) {
+        while (keylen + len > keymax)
+            keymax = keymax ? 2 * keymax : 64;
+        keybuf = memrealloc(keybuf, keymax);
+    }
+    memcpy(keybuf + keylen, s, len);
+    keylen += len;
+}
+
+/***********************************************************************
+ * nexttype : find a Type element in a child list
+ *
+ * Enter:   node = first node in list to look at, or 0
+ *
+ * Return:  first Type element at or after node in the list, 0 if none
+ */
+static struct node *
+nexttype(struct node *node)
+{
+    while ((node = nextelement(node))
+            && ((struct element *)node)->name != NAME_Type)
+    {
+        node = node->next;
+    }
+    return node;
+}
+
+/***********************************************************************
+ * makeform : get the typeform for a structure
+ *
+ * Enter:   type = type attribute, 0 for a named type
+ *          name = name attribute of a named type, else 0
+ *          nullable = whether nullable
+ *          nparams = number of child types
+ *          params = typeforms of the child types
+ *
+ * Return:  typeform
+ *
+ * The canonical text is the Web IDL for the type, with the member
+ * types of a union separated by " or " and generic parameters by ", ".
+ */
+static const struct typeform *
+makeform(const char *type, const char *name, int nullable,
+         unsigned int nparams, const struct typeform *const *params)
+{
+    struct typeform *typeform;
+    unsigned int i;
+    /* Build the canonical text. */
+    keylen = 0;
+    if (type && !strcmp(type, "union"))
+        addkey("(");
+    else if (!type || strcmp(type, "array")) {
+        addkey(type ? type : name ? name : "");
+        if (nparams)
+            addkey("<");
+    }
+    for (i = 0; i != nparams; i++) {
+        if (i)
+            addkey(type && !strcmp(type, "union") ? " or " : ", ");
+        addkey(params[i]->key);
+    }
+    if (type && !strcmp(type, "union"))
+        addkey(")");
+    else if (type && !strcmp(type, "array"))
+        addkey("[]");
+    else if (nparams)
+        addkey(">");
+    if (nullable)
+        addkey("?");
+    /* Find it, or make it. */
+    typeform = hashget(&typeforms, keybuf, keylen);
+    if (typeform)
+        return typeform;
+    typeform = memalloc(sizeof(struct typeform));
+    typeform->key = memprintf("%.*s", (int)keylen, keybuf);
+    typeform->hash = hashstring(keybuf, keylen);
+    if (type)
+        typeform->type = memprintf("%s", type);
+    if (name)
+        typeform->name = memprintf("%s", name);
+    typeform->nullable = nullable;
+    typeform->nparams = nparams;
+    typeform->params = memalloc((nparams ? nparams : 1)
+            * sizeof(struct typeform *));
+    for (i = 0; i != nparams; i++)
+        typeform->params[i] = params[i];
+    *hashput(&typeforms, typeform->key, keylen) = typeform;
+    return typeform;
+}
+
+/***********************************************************************
+ * interntype : get the typeform for a Type element
+ *
+ * Enter:   node = Type element, whose child Type elements already have
+ *                 their typeforms set
+ *
+ * Return:  typeform
+ */
+static const struct typeform *
+interntype(struct node *node)
+{
+    unsigned int nparams = 0;
+    struct node *child;
+    for (child = nexttype(node->children); child;
+            child = nexttype(child->next))
+    {
+        if (nparams == parammax) {
+            parammax = parammax ? 2 * parammax : 16;
+            params = memrealloc(params,
+                    parammax * sizeof(struct typeform *));
+        }
+        params[nparams++] = ((struct element *)child)->typeform;
+    }
+    return makeform(getattr(node, NAME_type), getattr(node, NAME_name),
+            getattr(node, NAME_nullable) != 0, nparams, params);
+}
+
+/***********************************************************************
+ * settypeforms : set the typeform of each Type element
+ *
+ * Enter:   root = root of parse tree
+ *
+ * The Type elements are found in document order and then interned in
+ * reverse order, so each is interned after the Type elements inside it.
+ */
+void
+settypeforms(struct node *root)
+{
+    struct node *node;
+    size_t count = 0;
+    for (node = root; node; node = nodewalk(node)) {
+        if (node->type != NODE_ELEMENT
+                || ((struct element *)node)->name != NAME_Type)
+        {
+            continue;
+        }
+        if (count == typenodemax) {
+            typenodemax = typenodemax ? 2 * typenodemax : 64;
+            typenodes = memrealloc(typenodes,
+                    typenodemax * sizeof(struct node *));
+        }
+        typenodes[count++] = node;
+    }
+    while (count) {
+        struct element *element = (void *)typenodes[--count];
+        element->typeform = interntype(&element->n);
+    }
+}
+
+/* struct typedefinfo : a typedef being resolved by resolvetypedefs */
+struct typedefinfo {
+    struct node *node; /* Typedef element */
+    const struct typeform *typeform; /* its type as declared */
+    const struct typeform *resolved; /* its type resolved, set once done */
+    int state; /* 0 not started, 1 being resolved, 2 done */
+};
+
+/* The typedefs, keyed by name, and the typeforms resolved so far, keyed
+ * by the canonical text of the declared type, from starttypedefs to
+ * endtypedefs. */
+static struct hashtable typedefs, resolvedforms;
+
+/* The canonical unions made so far by canonicalunion, keyed by the
+ * canonical text of the resolved union. */
+static struct hashtable canonicalforms;
+
+/***********************************************************************
+ * resolveform : resolve the typedefs in a typeform
+ *
+ * Enter:   typeform = typeform to resolve, between starttypedefs and
+ *                     endtypedefs
+ *
+ * Return:  typeform with each typedef name replaced by the type it
+ *          stands for, at every depth
+ *
+ * Each typeform is resolved once, however many Type elements share it,
+ * and each typedef once, however many types refer to it. Meeting a
+ * typedef that is still being resolved means that it refers to itself.
+ * A name that is not a typedef resolves to itself.
+ */
+const struct typeform *
+resolveform(const struct typeform *typeform)
+{
+    const struct typeform *resolved;
+    const struct typeform **resolvedparams;
+    unsigned int i;
+    int changed = 0;
+    resolved = hashget(&resolvedforms, typeform->key, strlen(typeform->key));
+    if (resolved)
+        return resolved;
+    if (typeform->name) {
+        struct typedefinfo *info = hashget(&typedefs, typeform->name,
+                strlen(typeform->name));
+        resolved = typeform;
+        if (info) {
+            if (info->state == 1) {
+                nodeerrorexit(info->node, "typedef %s refers to itself",
+                        typeform->name);
+            }
+            if (!info->state) {
+                info->state = 1;
+                info->resolved = resolveform(info->typeform);
+                info->state = 2;
+            }
+            resolved = info->resolved;
+            /* A nullable reference makes the type it stands for
+             * nullable. */
+            if (typeform->nullable && !resolved->nullable) {
+                resolved = makeform(resolved->type, resolved->name, 1,
+                        resolved->nparams, resolved->params);
+            }
+        }
+    } else {
+        /* Resolve the child types, and make a new typeform only if one
+         * of them changed. */
+        resolvedparams = memalloc((typeform->nparams ? typeform->nparams : 1)
+                * sizeof(struct typeform *));
+        for (i = 0; i != typeform->nparams; i++) {
+            resolvedparams[i] = resolveform(typeform->params[i]);
+            changed |= resolvedparams[i] != typeform->params[i];
+        }
+        resolved = !changed ? typeform : makeform(typeform->type, 0,
+                typeform->nullable, typeform->nparams, resolvedparams);
+        memfree(resolvedparams);
+    }
+    *hashput(&resolvedforms, typeform->key, strlen(typeform->key))
+            = (void *)resolved;
+    return resolved;
+}
+
+/***********************************************************************
+ * starttypedefs : index the typedefs for resolveform
+ *
+ * Enter:   root = root of parse tree, after settypeforms
+ */
+void
+starttypedefs(struct node *root)
+{
+    struct node *node;
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *name;
+        struct typedefinfo **pinfo;
+        if (((struct element *)node)->name != NAME_Typedef)
+            continue;
+        name = getattr(node, NAME_name);
+        pinfo = (struct typedefinfo **)hashput(&typedefs, name, strlen(name));
+        if (*pinfo)
+            continue;
+        *pinfo = memalloc(sizeof(struct typedefinfo));
+        (*pinfo)->node = node;
+        (*pinfo)->typeform = ((struct element *)nexttype(node->children))
+                ->typeform;
+    }
+}
+
+/***********************************************************************
+ * endtypedefs : free what starttypedefs, resolveform and canonicalunion
+ *               made
+ *
+ * Enter:   root = root of parse tree
+ */
+void
+endtypedefs(struct node *root)
+{
+    struct node *node;
+    hashfree(&canonicalforms);
+    hashfree(&resolvedforms);
+    for (node = nextelement(root->children); node;
+            node = nextelement(node->next))
+    {
+        const char *name;
+        struct typedefinfo *info;
+        if (((struct element *)node)->name != NAME_Typedef)
+            continue;
+        name = getattr(node, NAME_name);
+        info = hashget(&typedefs, name, strlen(name));
+        if (info && info->node == node)
+            memfree(info);
+    }
+    hashfree(&typedefs);
+}
+
+/***********************************************************************
+ * resolvetypedefs : add the resolved type to each Type element that
+ *                   refers to a typedef
+ *
+ * Enter:   root = root of parse tree, after settypeforms
+ *
+ * A Type element that refers to a typedef, directly or inside it, gets
+ * a resolved attribute with the canonical text of the type that results
+ * from replacing each typedef by the type it stands for. A typedef that
+ * refers to itself is an error.
+ */
+void
+resolvetypedefs(struct node *root)
+{
+    struct node *node;
+    starttypedefs(root);
+    for (node = root; node; node = nodewalk(node)) {
+        const struct typeform *typeform, *resolved;
+        if (node->type != NODE_ELEMENT
+                || ((struct element *)node)->name != NAME_Type)
+        {
+            continue;
+        }
+        typeform = ((struct element *)node)->typeform;
+        resolved = resolveform(typeform);
+        if (resolved != typeform)
+            addnode(node, newattr(NAME_resolved, resolved->key));
+    }
+    endtypedefs(root);
+}
+
+/***********************************************************************
+ * compareforms : compare two typeforms for sorting canonical unions
+ *
+ * Typeforms are ordered by hash, then by canonical text for the rare
+ * hashes that clash, so the order does not depend on the order the
+ * member types were written in.
+ */
+static int
+compareforms(const void *a, const void *b)
+{
+    const struct typeform *form1 = *(const struct typeform *const *)a;
+    const struct typeform *form2 = *(const struct typeform *const *)b;
+    if (form1->hash != form2->hash)
+        return form1->hash < form2->hash ? -1 : 1;
+    return strcmp(form1->key, form2->key);
+}
+
+/***********************************************************************
+ * canonicalunion : get the canonical form of a resolved union
+ *
+ * Enter:   typeform = union typeform, with typedefs resolved, between
+ *                     starttypedefs and endtypedefs
+ *
+ * Return:  union typeform whose member types are its flattened member
+ *          types: not unions, not nullable, sorted and each only once,
+ *          and which is nullable if it or any member type at any depth
+ *          was
+ *
+ * A member type that is itself a union contributes the member types of
+ * its own canonical form, which is worked out once and reused, so each
+ * union takes time in proportion to its member types plus the sort.
+ */
+const struct typeform *
+canonicalunion(const struct typeform *typeform)
+{
+    const struct typeform *canonical, **members;
+    unsigned int nmembers = 0, max = 0, i, j;
+    int nullable = typeform->nullable;
+    canonical = hashget(&canonicalforms, typeform->key,
+            strlen(typeform->key));
+    if (canonical)
+        return canonical;
+    for (i = 0; i != typeform->nparams; i++)
+        max += typeform->params[i]->nparams + 1;
+    members = memalloc(max * sizeof(struct typeform *));
+    for (i = 0; i != typeform->nparams; i++) {
+        const struct typeform *member = typeform->params[i];
+        if (member->nullable) {
+            nullable = 1;
+            member = makeform(member->type, member->name, 0,
+                    member->nparams, member->params);
+        }
+        if (!member->type || strcmp(member->type, "union")) {
+            members[nmembers++] = member;
+            continue;
+        }
+        member = canonicalunion(member);
+        nullable |= member->nullable;
+        if (nmembers + member->nparams > max) {
+            max = nmembers + member->nparams;
+            members = memrealloc(members, max * sizeof(struct typeform *));
+        }
+        for (j = 0; j != member->nparams; j++)
+            members[nmembers++] = member->params[j];
+    }
+    qsort(members, nmembers, sizeof(struct typeform *), compareforms);
+    /* Drop duplicates, which are now next to each other. */
+    for (i = j = 0; i != nmembers; i++) {
+        if (!j || members[i] != members[j - 1])
+            members[j++] = members[i];
+    }
+    canonical = makeform("union", 0, nullable, j, members);
+    memfree(members);
+    *hashput(&canonicalforms, typeform->key, strlen(typeform->key))
+            = (void *)canonical;
+    return canonical;
+}
+
+/***********************************************************************
+ * flattenunions : add the flattened member types of each union
+ *
+ * Enter:   root = root of parse tree, after settypeforms
+ *
+ * Each Type element that is a union, or refers to a typedef that stands
+ * for one, gets a FlattenedUnion element with a UnionMember element for
+ * each of its flattened member types, in canonical order. Typedefs are
+ * resolved first, so a union inside a typedef is flattened in too.
+ */
+void
+flattenunions(struct node *root)
+{
+    struct node *node;
+    starttypedefs(root);
+    for (node = root; node; node = nodewalk(node)) {
+        const struct typeform *typeform;
+        struct node *flattened;
+        unsigned int i;
+        if (node->type != NODE_ELEMENT
+                || ((struct element *)node)->name != NAME_Type)
+        {
+            continue;
+        }
+        typeform = resolveform(((struct element *)node)->typeform);
+        if (!typeform->type || strcmp(typeform->type, "union"))
+            continue;
+        typeform = canonicalunion(typeform);
+        flattened = newelement(NAME_FlattenedUnion);
+        if (typeform->nullable)
+            addnode(flattened, newattr(NAME_nullable, "nullable"));
+        for (i = 0; i != typeform->nparams; i++) {
+            struct node *member = newelement(NAME_UnionMember);
+            addnode(member, newattr(NAME_type, typeform->params[i]->key));
+            addnode(flattened, member);
+        }
+        addnode(node, flattened);
+    }
+    endtypedefs(root);
+}
@@ -0,0 +1,48 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***********************************************************************/
+#ifndef type_h
+#define type_h
+
+/* struct typeform : the structure of a Type element, interned
+ *
+ * Type elements with the same structure share one typeform, so two
+ * types are the same exactly when their typeforms are the same pointer.
+ * The structure is the type, name and nullable attributes and the
+ * typeforms of the child Type elements in order. Extended attributes
+ * on a type are not part of it. A typeform is never changed or freed
+ * once made. */
+struct typeform {
+    const char *key; /* canonical text, e.g. "sequence<DOMString>?" */
+    unsigned int hash; /* hashstring of key */
+    const char *type; /* type attribute, 0 for a named type */
+    const char *name; /* name attribute of a named type, else 0 */
+    int nullable;
+    unsigned int nparams;
+    /* Typeforms of the child Type elements: the element type of an
+     * array, sequence, FrozenArray or Promise, the key and value types
+     * of a record, or the member types of a union. */
+    const struct typeform **params;
+};
+
+struct node;
+
+void settypeforms(struct node *root);
+void starttypedefs(struct node *root);
+const struct typeform *resolveform(const struct typeform *typeform);
+const struct typeform *canonicalunion(const struct typeform *typeform);
+void endtypedefs(struct node *root);
+void resolvetypedefs(struct node *root);
+void flattenunions(struct node *root);
+
+#endif /* ndef type_h */
@@ -0,0 +1,343 @@
+/***********************************************************************
+ * $Id$
+ * Copyright 2009 Aplix Corporation. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Watch mode: reprocess input files as they change
+ ***********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "watch.h"
+
+#ifndef __linux__
+
+/***********************************************************************
+ * watchfiles : process input files, then again each time one changes
+ *
+ * Watch mode needs inotify, so it is only available on Linux.
+ */
+void
+watchfiles(const char *const *names, const char *output, unsigned int flags)
+{
+    errorexit("watch mode is only available on Linux");
+}
+
+#else /* def __linux__ */
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "comment.h"
+#include "lex.h"
+#include "node.h"
+#include "parse.h"
+#include "process.h"
+
+/* struct chunk : some output captured from stdout */
+struct chunk {
+    char *text;
+    size_t len;
+};
+
+/* struct input : an input file, its parse tree and its output
+ *
+ * The output of each input file is kept in three chunks, being its part
+ * of the text of the root <webidl> element, its part of the content of
+ * the root <descriptive> element, and the elements for its definitions.
+ * The output file is these chunks for each input in turn, put inside
+ * the root element. */
+struct input {
+    const char *name;
+    struct node *root; /* 0 if the file last failed to parse */
+    struct chunk webidl, descriptive, definitions;
+    int wd; /* inotify watch descriptor of the file's directory */
+    const char *base; /* name of the file within its directory */
+};
+
+static FILE *capturehandle;
+static int savedstdout;
+
+/***********************************************************************
+ * startcapture : start capturing what is written to stdout
+ */
+static void
+startcapture(void)
+{
+    fflush(stdout);
+    capturehandle = tmpfile();
+    if (!capturehandle)
+        errorexit("cannot create temporary file: %s", strerror(errno));
+    savedstdout = dup(1);
+    dup2(fileno(capturehandle), 1);
+}
+
+/***********************************************************************
+ * endcapture : stop capturing what is written to stdout
+ *
+ * Enter:   chunk = chunk to store the captured output in, replacing
+ *                  what was there
+ */
+static void
+endcapture(struct chunk *chunk)
+{
+    int fd = fileno(capturehandle);
+    off_t len;
+    fflush(stdout);
+    dup2(savedstdout, 1);
+    close(savedstdout);
+    len = lseek(fd, 0, SEEK_END);
+    if (chunk->text)
+        memfree(chunk->text);
+    chunk->text = memalloc(len ? len : 1);
+    chunk->len = len;
+    if (len && pread(fd, chunk->text, len, 0) != len)
+        errorexit("cannot read temporary file: %s", strerror(errno));
+    fclose(capturehandle);
+}
+
+/***********************************************************************
+ * processinput : parse an input file and capture its output
+ *
+ * Enter:   input = input struct
+ *          index = index of input file
+ *          reload = whether to read the file again first
+ *
+ * The file's previous tree is freed first, so its ids do not clash with
+ * those in the new tree. If there is an error, the message is output,
+ * and the chunks from before are kept so the output file still has the
+ * file's last good output.
+ */
+static void
+processinput(struct input *input, unsigned int index, int reload)
+{
+    jmp_buf jmp;
+    struct node *child;
+    if (input->root) {
+        freenode(input->root);
+        input->root = 0;
+    }
+    if (setjmp(jmp)) {
+        /* If the error was in the parse, free the nodes it made and the
+         * comments it saw; otherwise the comments may be attached to
+         * the tree, so they are freed with it. */
+        seterrorjmp(0);
+        if (input->root) {
+            abandoncomments();
+            freenode(input->root);
+            input->root = 0;
+        } else {
+            freenodelog();
+            discardcomments();
+        }
+        return;
+    }
+    seterrorjmp(&jmp);
+    if (reload)
+        reloadinput(index);
+    lexinput(index);
+    startnodelog();
+    input->root = parse();
+    endnodelog();
+    processcomments(input->root);
+    seterrorjmp(0);
+    /* Capture the output. */
+    startcapture();
+    outputwidl(input->root);
+    endcapture(&input->webidl);
+    startcapture();
+    outputcomments(input->root, 4);
+    endcapture(&input->descriptive);
+    startcapture();
+    for (child = nextelement(input->root->children); child;
+            child = nextelement(child->next))
+    {
+        outputnode(child, 2);
+    }
+    endcapture(&input->definitions);
+}
+
+/***********************************************************************
+ * writeoutput : write the output file from the chunks of each input
+ *
+ * Enter:   output = name of output file
+ *          inputs = array of input structs
+ *          ninputs = number of inputs
+ *          flags = PROCESS_* flags
+ *
+ * The output is written to a temporary file that is then renamed, so a
+ * reader never sees a partly written output file.
+ */
+static void
+writeoutput(const char *output, const struct input *inputs,
+            unsigned int ninputs, unsigned int flags)
+{
+    char *tmpname = memprintf("%s.tmp", output);
+    FILE *handle = fopen(tmpname, "w");
+    unsigned int i;
+    int descriptive = 0;
+    if (!handle)
+        errorexit("%s: %s", tmpname, strerror(errno));
+    fprintf(handle, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    if (flags & PROCESS_DTDREF)
+        fprintf(handle, "<!DOCTYPE Definitions SYSTEM \"widlprocxml.dtd\">\n");
+    fprintf(handle, "<Definitions>\n  <webidl>");
+    for (i = 0; i != ninputs; i++)
+        fwrite(inputs[i].webidl.text, 1, inputs[i].webidl.len, handle);
+    fprintf(handle, "</webidl>\n");
+    for (i = 0; i != ninputs; i++)
+        descriptive |= inputs[i].descriptive.len != 0;
+    if (descriptive) {
+        fprintf(handle, "  <descriptive>\n");
+        for (i = 0; i != ninputs; i++) {
+            fwrite(inputs[i].descriptive.text, 1, inputs[i].descriptive.len,
+                    handle);
+        }
+        fprintf(handle, "  </descriptive>\n");
+    }
+    for (i = 0; i != ninputs; i++) {
+        fwrite(inputs[i].definitions.text, 1, inputs[i].definitions.len,
+                handle);
+    }
+    fprintf(handle, "</Definitions>\n");
+    if (ferror(handle) || fclose(handle))
+        errorexit("%s: write error", tmpname);
+    if (rename(tmpname, output))
+        errorexit("%s: %s", output, strerror(errno));
+    memfree(tmpname);
+}
+
+/***********************************************************************
+ * addwatch : watch the directory of an input file
+ *
+ * Enter:   fd = inotify file descriptor
+ *          input = input struct, whose name is set
+ *
+ * The directory is watched rather than the file, so a file that an
+ * editor saves by writing a new file and renaming it over the old one
+ * is still seen to change.
+ */
+static void
+addwatch(int fd, struct input *input)
+{
+    const char *slash = strrchr(input->name, '/');
+    char *dir;
+    if (slash) {
+        dir = memprintf("%.*s", (int)(slash - input->name + 1), input->name);
+        input->base = slash + 1;
+    } else {
+        dir = memprintf(".");
+        input->base = input->name;
+    }
+    /* Watching the same directory again gives the same descriptor. */
+    input->wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (input->wd < 0)
+        errorexit("%s: %s", dir, strerror(errno));
+    memfree(dir);
+}
+
+/***********************************************************************
+ * readevents : wait for inotify events and mark the changed inputs
+ *
+ * Enter:   fd = inotify file descriptor
+ *          inputs = array of input structs
+ *          ninputs = number of inputs
+ *          changed = array of flags to set for changed inputs
+ *          timeout = milliseconds to wait, -1 for no limit
+ *
+ * Return:  0 if timed out, else non-zero
+ */
+static int
+readevents(int fd, const struct input *inputs, unsigned int ninputs,
+           char *changed, int timeout)
+{
+    char buf[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pollfd;
+    ssize_t len;
+    char *p;
+    pollfd.fd = fd;
+    pollfd.events = POLLIN;
+    if (poll(&pollfd, 1, timeout) <= 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf));
+    if (len <= 0)
+        errorexit("inotify: %s", strerror(errno));
+    for (p = buf; p < buf + len; ) {
+        const struct inotify_event *event = (const void *)p;
+        unsigned int i;
+        for (i = 0; i != ninputs; i++) {
+            if (event->len && inputs[i].wd == event->wd
+                    && !strcmp(inputs[i].base, event->name))
+            {
+                changed[i] = 1;
+            }
+        }
+        p += sizeof(struct inotify_event) + event->len;
+    }
+    return 1;
+}
+
+/***********************************************************************
+ * watchfiles : process input files, then again each time one changes
+ *
+ * Enter:   names = 0-terminated array of filenames
+ *          output = name of output file
+ *          flags = PROCESS_* flags
+ *
+ * Each input file is parsed on its own, and its tree and output kept.
+ * When one changes, only that file is parsed again, and the output file
+ * is rewritten from the kept output of the others and the new output of
+ * that one. This does not return.
+ */
+void
+watchfiles(const char *const *names, const char *output, unsigned int flags)
+{
+    struct input *inputs;
+    char *changed;
+    unsigned int ninputs = 0, i;
+    int fd;
+    while (names[ninputs]) {
+        if (!strcmp(names[ninputs], "-"))
+            errorexit("cannot watch stdin");
+        ninputs++;
+    }
+    inputs = memalloc(ninputs * sizeof(struct input));
+    changed = memalloc(ninputs);
+    fd = inotify_init();
+    if (fd < 0)
+        errorexit("inotify: %s", strerror(errno));
+    for (i = 0; i != ninputs; i++) {
+        inputs[i].name = names[i];
+        addwatch(fd, inputs + i);
+    }
+    readinput(names);
+    for (i = 0; i != ninputs; i++)
+        processinput(inputs + i, i, 0);
+    writeoutput(output, inputs, ninputs, flags);
+    for (;;) {
+        readevents(fd, inputs, ninputs, changed, -1);
+        /* An editor may write a file more than once for one save, so
+         * wait for things to go quiet. */
+        while (readevents(fd, inputs, ninputs, changed, 50))
+            ;
+        for (i = 0; i != ninputs; i++) {
+            if (changed[i]) {
+                changed[i] = 0;
+                processinput(inputs + i, i, 1);
+            }
+        }
+        writeoutput(output, inputs, ninputs, flags);
+    }
+}
+
+#endif /* def __linux__ */
@@ -711,10 +711,25 @@ XSLT stylesheet to convert widlprocxml into html documentation.
     </div>
 </xsl:template>
 
-<!--webidl : literal Web IDL from input-->
+<!--webidl : literal Web IDL from input, or with -webidl-offsets
+    the offsets of it in the source elements-->
 <xsl:template match="webidl">
     <h5>WebIDL</h5>
-    <pre class="webidl"><xsl:apply-templates/></pre>
+    <pre class="webidl">
+        <xsl:choose>
+            <xsl:when test="@start">
+                <xsl:variable name="source">
+                    <xsl:for-each select="/Definitions/source">
+                        <xsl:value-of select="."/>
+                    </xsl:for-each>
+                </xsl:variable>
+                <xsl:value-of select="substring($source, @start + 1, @end - @start)"/>
+            </xsl:when>
+            <xsl:otherwise>
+                <xsl:apply-templates/>
+            </xsl:otherwise>
+        </xsl:choose>
+    </pre>
 </xsl:template>
 
 <!--author-->
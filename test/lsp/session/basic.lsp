@@ -0,0 +1,31 @@
+Content-Length: 75
+
+{"jsonrpc":"2.0","id":1,"method":"initialize","params":{"capabilities":{}}}Content-Length: 52
+
+{"jsonrpc":"2.0","method":"initialized","params":{}}Content-Length: 263
+
+{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///basic.widl","languageId":"webidl","version":1,"text":"/** A doc */\ninterface A {\n  attribute B b;\n};\n\ninterface B : A { void f(A a); };\ndictionary D { long x; };\n"}}}Content-Length: 151
+
+{"jsonrpc":"2.0","id":2,"method":"textDocument/definition","params":{"textDocument":{"uri":"file:///basic.widl"},"position":{"line":2,"character":13}}}Content-Length: 189
+
+{"jsonrpc":"2.0","id":3,"method":"textDocument/references","params":{"textDocument":{"uri":"file:///basic.widl"},"position":{"line":1,"character":10},"context":{"includeDeclaration":true}}}Content-Length: 225
+
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///basic.widl","version":2},"contentChanges":[{"range":{"start":{"line":2,"character":14},"end":{"line":2,"character":15}},"text":""}]}}Content-Length: 226
+
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///basic.widl","version":3},"contentChanges":[{"range":{"start":{"line":2,"character":14},"end":{"line":2,"character":14}},"text":"c"}]}}Content-Length: 241
+
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///basic.widl","version":4},"contentChanges":[{"range":{"start":{"line":5,"character":0},"end":{"line":5,"character":0}},"text":"[Exposed=Window]\n"}]}}Content-Length: 233
+
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///basic.widl","version":5},"contentChanges":[{"range":{"start":{"line":6,"character":33},"end":{"line":6,"character":33}},"text":" /* open"}]}}Content-Length: 228
+
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///basic.widl","version":6},"contentChanges":[{"range":{"start":{"line":7,"character":25},"end":{"line":7,"character":25}},"text":" */"}]}}Content-Length: 151
+
+{"jsonrpc":"2.0","id":4,"method":"textDocument/definition","params":{"textDocument":{"uri":"file:///basic.widl"},"position":{"line":7,"character":12}}}Content-Length: 150
+
+{"jsonrpc":"2.0","id":"five","method":"textDocument/hover","params":{"textDocument":{"uri":"file:///basic.widl"},"position":{"line":0,"character":0}}}Content-Length: 105
+
+{"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file:///basic.widl"}}}Content-Length: 44
+
+{"jsonrpc":"2.0","id":6,"method":"shutdown"}Content-Length: 33
+
+{"jsonrpc":"2.0","method":"exit"}
\ No newline at end of file